@@ -69,6 +69,9 @@ Searching: The main finding function is:
 #  include <emmintrin.h> // SSE2
 #  include <realm/realm_nmmintrin.h> // SSE42
 #endif
+#ifdef REALM_COMPILER_AVX2
+#  include <immintrin.h> // AVX2, AVX-512
+#endif
 
 namespace realm {
 
@@ -705,6 +708,23 @@ public:
                                             QueryState<int64_t>* state, size_t baseindex,
                                             Callback callback) const;
 
+#endif
+
+    // AVX2 (256-bit) and AVX-512 (512-bit) find for the four functions Equal/NotEqual/Less/Greater. 'data' must be
+    // aligned to the vector size and 'items' is the number of vectors to search.
+#ifdef REALM_COMPILER_AVX2
+    template<class cond2, Action action, size_t width, class Callback>
+    REALM_TARGET_AVX2 bool FindAVX2(int64_t value, const char* data, size_t items, QueryState<int64_t>* state,
+                                    size_t baseindex, Callback callback) const;
+
+    template<class cond2, Action action, size_t width, class Callback>
+    REALM_TARGET_AVX512 bool FindAVX512(int64_t value, const char* data, size_t items, QueryState<int64_t>* state,
+                                        size_t baseindex, Callback callback) const;
+
+    // Reports the matches of one vector compare. 'mask' has one bit per element, or one bit per 'stride' bits
+    template<Action action, size_t width, class Callback>
+    REALM_FORCEINLINE bool FindVectorMatches(uint64_t mask, size_t stride, const char* chunk,
+                                             QueryState<int64_t>* state, size_t baseindex, Callback callback) const;
 #endif
 
     template<size_t width> inline bool TestZero(uint64_t value) const;         // Tests value for 0-elements
@@ -1018,6 +1038,13 @@ private:
                                                   std::size_t end, std::size_t* return_ndx) const;
     template<size_t w> std::size_t find_gte(const int64_t target, std::size_t start, Array const* indirection) const;
 
+    // Vectorized sum() and minmax() used by find_optimized() when all elements of a range match. Widths below 8 bits
+    // are summed a 64-bit word at a time by counting bit planes. 8, 16 and 32 bit elements are sign extended and
+    // accumulated in SSE2 registers.
+    template<size_t w> int64_t sum_vector(size_t start, size_t end) const;
+    template<bool max, std::size_t w> bool minmax_vector(int64_t& result, std::size_t start,
+                                                         std::size_t end, std::size_t* return_ndx) const;
+
 protected:
     /// The total size in bytes (including the header) of a new empty
     /// array. Must be a multiple of 8 (i.e., 64-bit aligned).
@@ -2413,14 +2440,14 @@ template<class cond2, Action action, size_t bitwidth, class Callback> bool Array
             end2 = end - start > process ? start + process : end;
         }
         if (action == act_Sum || action == act_Max || action == act_Min) {
-            int64_t res;
+            int64_t res = 0;
             size_t res_ndx = 0;
             if (action == act_Sum)
-                res = Array::sum(start, end2);
+                res = sum_vector<bitwidth>(start, end2);
             if (action == act_Max)
-                Array::maximum(res, start, end2, &res_ndx);
+                minmax_vector<true, bitwidth>(res, start, end2, &res_ndx);
             if (action == act_Min)
-                Array::minimum(res, start, end2, &res_ndx);
+                minmax_vector<false, bitwidth>(res, start, end2, &res_ndx);
 
             find_action<action, Callback>(res_ndx + baseindex, res, state, callback);
             state->m_match_count += end2 - start;
@@ -2440,6 +2467,35 @@ template<class cond2, Action action, size_t bitwidth, class Callback> bool Array
     // finder cannot handle this bitwidth
     REALM_ASSERT_3(m_width, !=, 0);
 
+#ifdef REALM_COMPILER_AVX2
+    // Use the widest vector unit the CPU supports. Unlike SSE, AVX2 and AVX-512 can do all four conditions at all
+    // byte sized widths, including Less on 64-bit values. Payload must be at least two vectors in size.
+    if (bitwidth >= 8 && sseavx<2>()) {
+        const size_t vector_size = sseavx<512>() ? 64 : 32;
+        if ((end - start) * bitwidth / 8 >= 2 * vector_size) {
+            // FindAVX*() must start at a vector boundary, so search area before that using Compare()
+            const char* const a = static_cast<char*>(round_up(m_data + start * bitwidth / 8, vector_size));
+            const char* const b = static_cast<char*>(round_down(m_data + end * bitwidth / 8, vector_size));
+
+            if (!Compare<cond2, action, bitwidth, Callback>(value, start, (a - m_data) * 8 / no0(bitwidth), baseindex, state, callback))
+                return false;
+
+            const size_t a_ndx = baseindex + (a - m_data) * 8 / no0(bitwidth);
+            if (vector_size == 64) {
+                if (!FindAVX512<cond2, action, bitwidth, Callback>(value, a, (b - a) / 64, state, a_ndx, callback))
+                    return false;
+            }
+            else {
+                if (!FindAVX2<cond2, action, bitwidth, Callback>(value, a, (b - a) / 32, state, a_ndx, callback))
+                    return false;
+            }
+
+            // Search remainder with Compare()
+            return Compare<cond2, action, bitwidth, Callback>(value, (b - m_data) * 8 / no0(bitwidth), end, baseindex, state, callback);
+        }
+    }
+#endif
+
 #if defined(REALM_COMPILER_SSE)
     // Only use SSE if payload is at least one SSE chunk (128 bits) in size. Also note taht SSE doesn't support 
     // Less-than comparison for 64-bit values. 
@@ -2480,6 +2536,152 @@ return Compare<cond2, action, bitwidth, Callback>(value, start, end, baseindex,
 #endif
 }
 
+template<size_t w> int64_t Array::sum_vector(size_t start, size_t end) const
+{
+    if (end == std::size_t(-1))
+        end = m_size;
+    REALM_ASSERT_DEBUG(start <= end && end <= m_size);
+
+    if (w == 0)
+        return 0;
+
+    int64_t s = 0;
+
+    if (w == 1 || w == 2 || w == 4) {
+        // Elements are unsigned, and the value of each is the weighted sum of its bits. So count each bit plane of a
+        // 64-bit word at once instead of unpacking the elements
+        const size_t per_word = 64 / no0(w);
+        for (; start < end && start % per_word != 0; ++start)
+            s += get<w>(start);
+
+        const uint64_t* p = reinterpret_cast<const uint64_t*>(m_data + start * w / 8);
+        for (; start + per_word <= end; start += per_word, ++p) {
+            const uint64_t chunk = *p;
+            if (w == 1) {
+                s += fast_popcount64(chunk);
+            }
+            else if (w == 2) {
+                s += fast_popcount64(chunk & 0x5555555555555555ULL);
+                s += 2 * int64_t(fast_popcount64(chunk & 0xAAAAAAAAAAAAAAAAULL));
+            }
+            else {
+                s += fast_popcount64(chunk & 0x1111111111111111ULL);
+                s += 2 * int64_t(fast_popcount64(chunk & 0x2222222222222222ULL));
+                s += 4 * int64_t(fast_popcount64(chunk & 0x4444444444444444ULL));
+                s += 8 * int64_t(fast_popcount64(chunk & 0x8888888888888888ULL));
+            }
+        }
+    }
+#ifdef REALM_COMPILER_SSE
+    else if (w == 8 || w == 16 || w == 32) {
+        const size_t per_chunk = 128 / no0(w);
+        const size_t chunks = (end - start) / per_chunk;
+        const __m128i* p = reinterpret_cast<const __m128i*>(m_data + start * w / 8);
+        __m128i acc = _mm_setzero_si128(); // Two 64-bit lanes
+
+        for (size_t i = 0; i < chunks; ++i) {
+            __m128i v = _mm_loadu_si128(p + i);
+            if (w == 8) {
+                // Bias the signed bytes to unsigned and let psadbw add each half into a 64-bit lane. The bias is
+                // subtracted once at the end
+                v = _mm_xor_si128(v, _mm_set1_epi8(static_cast<char>(0x80)));
+                acc = _mm_add_epi64(acc, _mm_sad_epu8(v, _mm_setzero_si128()));
+            }
+            else {
+                // Add 16-bit pairs into 32 bits, then sign extend the 32-bit values into the 64-bit lanes
+                if (w == 16)
+                    v = _mm_madd_epi16(v, _mm_set1_epi16(1));
+                __m128i sign = _mm_srai_epi32(v, 31);
+                acc = _mm_add_epi64(acc, _mm_unpacklo_epi32(v, sign));
+                acc = _mm_add_epi64(acc, _mm_unpackhi_epi32(v, sign));
+            }
+        }
+
+        int64_t lanes[2];
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), acc);
+        s += lanes[0] + lanes[1];
+        if (w == 8)
+            s -= int64_t(128 * chunks * per_chunk);
+        start += chunks * per_chunk;
+    }
+#endif
+
+    for (; start < end; ++start)
+        s += get<w>(start);
+
+    return s;
+}
+
+template<bool max, size_t w>
+bool Array::minmax_vector(int64_t& result, size_t start, size_t end, size_t* return_ndx) const
+{
+    if (end == std::size_t(-1))
+        end = m_size;
+    REALM_ASSERT_DEBUG(start <= end && end <= m_size);
+
+    if (start >= end)
+        return false;
+
+    // Nothing can beat the bound of the width, so stop as soon as it is seen
+    const int64_t bound = max ? m_ubound : m_lbound;
+    int64_t m = get<w>(start);
+    size_t i = start + 1;
+
+#ifdef REALM_COMPILER_SSE
+    if (w == 8 || w == 16 || w == 32) {
+        const size_t per_chunk = 128 / no0(w);
+        const size_t chunks = (end - i) / per_chunk;
+        const __m128i* p = reinterpret_cast<const __m128i*>(m_data + i * w / 8);
+
+        if (chunks > 0) {
+            // SSE2 only has signed 16-bit min/max, so select with compare masks for the other widths
+            __m128i best = _mm_loadu_si128(p);
+            for (size_t c = 1; c < chunks; ++c) {
+                __m128i v = _mm_loadu_si128(p + c);
+                if (w == 16) {
+                    best = max ? _mm_max_epi16(best, v) : _mm_min_epi16(best, v);
+                }
+                else {
+                    __m128i better;
+                    if (w == 8)
+                        better = max ? _mm_cmpgt_epi8(v, best) : _mm_cmplt_epi8(v, best);
+                    else
+                        better = max ? _mm_cmpgt_epi32(v, best) : _mm_cmplt_epi32(v, best);
+                    best = _mm_or_si128(_mm_and_si128(better, v), _mm_andnot_si128(better, best));
+                }
+            }
+
+            const char* lanes = reinterpret_cast<const char*>(&best);
+            for (size_t l = 0; l < per_chunk; ++l) {
+                int64_t v = get_universal<w>(lanes, l);
+                if (max ? v > m : v < m)
+                    m = v;
+            }
+            i += chunks * per_chunk;
+        }
+    }
+#endif
+
+    for (; i < end && m != bound; ++i) {
+        int64_t v = get<w>(i);
+        if (max ? v > m : v < m)
+            m = v;
+    }
+
+    result = m;
+
+    // The index of the first occurrence is found by a second, vectorized, equality search that stops at the first
+    // match
+    if (return_ndx) {
+        QueryState<int64_t> state;
+        state.init(act_ReturnFirst, nullptr, 1);
+        find_optimized<Equal, act_ReturnFirst, w, CallbackDummy>(m, start, end, 0, &state, CallbackDummy());
+        *return_ndx = static_cast<size_t>(state.m_state);
+    }
+
+    return true;
+}
+
 template<size_t width> inline int64_t Array::LowerBits() const
 {
     if (width == 1)
@@ -2791,7 +2993,7 @@ template<bool eq, Action action, size_t width, class Callback> inline bool Array
                 if (a >= 64 / no0(width))
                     break;
 
-                if (!find_action<action, Callback>(a + start + baseindex, get<width>(start + t), state, callback))
+                if (!find_action<action, Callback>(a + start + baseindex, get<width>(a + start), state, callback))
                     return false;
                 v2 >>= (t + 1) * width;
                 a += 1;
@@ -2944,6 +3146,144 @@ REALM_FORCEINLINE bool Array::FindSSE_intern(__m128i* action_data, __m128i* data
 }
 #endif //REALM_COMPILER_SSE
 
+#ifdef REALM_COMPILER_AVX2
+template<Action action, size_t width, class Callback>
+REALM_FORCEINLINE bool Array::FindVectorMatches(uint64_t mask, size_t stride, const char* chunk,
+                                                QueryState<int64_t>* state, size_t baseindex, Callback callback) const
+{
+    // Let count aggregate consume the whole vector at once. Each element has exactly one bit set in 'mask', so
+    // popcount gives the number of matches
+    if (mask != 0 && find_action_pattern<action, Callback>(baseindex, mask, state, callback))
+        return true;
+
+    while (mask != 0) {
+        size_t idx = FirstSetBit64(mask) / stride;
+        if (!find_action<action, Callback>(idx + baseindex, get_universal<width>(chunk, idx), state, callback))
+            return false;
+        mask &= mask - 1;
+    }
+    return true;
+}
+
+// 'items' is the number of 32-byte AVX2 vectors. Returns index of packed element relative to first integer of first
+// vector
+template<class cond2, Action action, size_t width, class Callback>
+REALM_TARGET_AVX2 bool Array::FindAVX2(int64_t value, const char* data, size_t items, QueryState<int64_t>* state,
+                                       size_t baseindex, Callback callback) const
+{
+    const int cond = cond2::condition;
+    const size_t per_vector = 256 / no0(width);
+    const uint64_t all_matched = width == 8 ? 0xffffffffULL : width == 16 ? 0x55555555ULL : width == 32 ? 0xffULL : 0xfULL;
+    __m256i search;
+
+    if (width == 8)
+        search = _mm256_set1_epi8(static_cast<char>(value));
+    else if (width == 16)
+        search = _mm256_set1_epi16(static_cast<short int>(value));
+    else if (width == 32)
+        search = _mm256_set1_epi32(static_cast<int>(value));
+    else
+        search = _mm256_set1_epi64x(value);
+
+    for (size_t i = 0; i < items; ++i) {
+        const char* chunk = data + i * sizeof (__m256i);
+        __m256i v = _mm256_load_si256(reinterpret_cast<const __m256i*>(chunk));
+        __m256i compare;
+
+        if (cond == cond_Equal || cond == cond_NotEqual) {
+            if (width == 8)
+                compare = _mm256_cmpeq_epi8(v, search);
+            else if (width == 16)
+                compare = _mm256_cmpeq_epi16(v, search);
+            else if (width == 32)
+                compare = _mm256_cmpeq_epi32(v, search);
+            else
+                compare = _mm256_cmpeq_epi64(v, search);
+        }
+        else {
+            // Less is Greater with the operands swapped
+            __m256i lhs = cond == cond_Greater ? v : search;
+            __m256i rhs = cond == cond_Greater ? search : v;
+            if (width == 8)
+                compare = _mm256_cmpgt_epi8(lhs, rhs);
+            else if (width == 16)
+                compare = _mm256_cmpgt_epi16(lhs, rhs);
+            else if (width == 32)
+                compare = _mm256_cmpgt_epi32(lhs, rhs);
+            else
+                compare = _mm256_cmpgt_epi64(lhs, rhs);
+        }
+
+        // Reduce to one bit per element, except for 16-bit where we keep every second bit of the byte mask
+        uint64_t mask;
+        size_t stride = 1;
+        if (width == 32)
+            mask = uint32_t(_mm256_movemask_ps(_mm256_castsi256_ps(compare)));
+        else if (width == 64)
+            mask = uint32_t(_mm256_movemask_pd(_mm256_castsi256_pd(compare)));
+        else {
+            mask = uint32_t(_mm256_movemask_epi8(compare));
+            if (width == 16) {
+                mask &= 0x55555555;
+                stride = 2;
+            }
+        }
+
+        if (cond == cond_NotEqual)
+            mask = ~mask & all_matched;
+
+        if (!FindVectorMatches<action, width, Callback>(mask, stride, chunk, state, baseindex + i * per_vector,
+                                                        callback))
+            return false;
+    }
+
+    return true;
+}
+
+// 'items' is the number of 64-byte AVX-512 vectors. Returns index of packed element relative to first integer of
+// first vector
+template<class cond2, Action action, size_t width, class Callback>
+REALM_TARGET_AVX512 bool Array::FindAVX512(int64_t value, const char* data, size_t items, QueryState<int64_t>* state,
+                                           size_t baseindex, Callback callback) const
+{
+    const int cond = cond2::condition;
+    const size_t per_vector = 512 / no0(width);
+    const int predicate = cond == cond_Equal ? _MM_CMPINT_EQ : cond == cond_NotEqual ? _MM_CMPINT_NE :
+                          cond == cond_Greater ? _MM_CMPINT_NLE : _MM_CMPINT_LT;
+    __m512i search;
+
+    if (width == 8)
+        search = _mm512_set1_epi8(static_cast<char>(value));
+    else if (width == 16)
+        search = _mm512_set1_epi16(static_cast<short int>(value));
+    else if (width == 32)
+        search = _mm512_set1_epi32(static_cast<int>(value));
+    else
+        search = _mm512_set1_epi64(value);
+
+    for (size_t i = 0; i < items; ++i) {
+        const char* chunk = data + i * sizeof (__m512i);
+        __m512i v = _mm512_load_si512(chunk);
+
+        // AVX-512 compares produce a bit mask with one bit per element directly
+        uint64_t mask;
+        if (width == 8)
+            mask = _mm512_cmp_epi8_mask(v, search, predicate);
+        else if (width == 16)
+            mask = _mm512_cmp_epi16_mask(v, search, predicate);
+        else if (width == 32)
+            mask = _mm512_cmp_epi32_mask(v, search, predicate);
+        else
+            mask = _mm512_cmp_epi64_mask(v, search, predicate);
+
+        if (!FindVectorMatches<action, width, Callback>(mask, 1, chunk, state, baseindex + i * per_vector, callback))
+            return false;
+    }
+
+    return true;
+}
+#endif // REALM_COMPILER_AVX2
+
 template<class cond, Action action, class Callback>
 bool Array::CompareLeafs(const Array* foreign, size_t start, size_t end, size_t baseindex, QueryState<int64_t>* state,
                          Callback callback) const
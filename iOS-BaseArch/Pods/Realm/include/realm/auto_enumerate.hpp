@@ -0,0 +1,216 @@
+/*************************************************************************
+ *
+ * REALM CONFIDENTIAL
+ * __________________
+ *
+ *  [2011] - [2015] Realm Inc
+ *  All Rights Reserved.
+ *
+ * NOTICE:  All information contained herein is, and remains
+ * the property of Realm Incorporated and its suppliers,
+ * if any.  The intellectual and technical concepts contained
+ * herein are proprietary to Realm Incorporated
+ * and its suppliers and may be covered by U.S. and Foreign Patents,
+ * patents in process, and are protected by trade secret or copyright law.
+ * Dissemination of this information or reproduction of this material
+ * is strictly forbidden unless prior written permission is obtained
+ * from Realm Incorporated.
+ *
+ **************************************************************************/
+#ifndef REALM_AUTO_ENUMERATE_HPP
+#define REALM_AUTO_ENUMERATE_HPP
+
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <realm/table.hpp>
+#include <realm/group.hpp>
+#include <realm/group_shared.hpp>
+#include <realm/lang_bind_helper.hpp>
+
+namespace realm {
+
+/// Enumerates low-cardinality string columns automatically when a write
+/// transaction is committed, so that nobody has to remember to call
+/// Table::optimize().
+///
+/// At each commit, the string columns of the tables that changed since the
+/// previous commit are sampled. If a column that is not yet enumerated has
+/// few distinct values in the sample, its table is optimized. The full
+/// decision is then made by Table::optimize(), which also records the
+/// conversion in the transaction log, so it is replicated like any other
+/// change.
+///
+/// Attach it to a SharedGroup with attach(), and it runs at every commit made
+/// through WriteTransaction::commit() or
+/// LangBindHelper::commit_and_continue_as_read() on that SharedGroup, with
+/// no other change to the calling code. It can also be run for a single
+/// commit through WriteTransaction::commit(AutoEnumerator&) or
+/// LangBindHelper::commit_and_continue_as_read(SharedGroup&, AutoEnumerator&),
+/// or by calling run() on the group of a write transaction before committing
+/// it. Either way the other attached enumerators run as usual, and an
+/// enumerator runs only once per commit, even when it is both attached and
+/// passed to the commit.
+class AutoEnumerator {
+public:
+    /// A column is a candidate when at most \a max_distinct_ratio of up to
+    /// \a sample_size sampled values are distinct. Tables with fewer than
+    /// \a min_rows rows are left alone.
+    AutoEnumerator(double max_distinct_ratio = 0.1, std::size_t sample_size = 1000,
+                   std::size_t min_rows = 1000);
+    ~AutoEnumerator() REALM_NOEXCEPT;
+
+    /// Run at every commit of \a sg until detach() is called or this
+    /// enumerator is destroyed. An enumerator can be attached to one
+    /// SharedGroup at a time, and must not be attached or detached while
+    /// that SharedGroup is committing.
+    void attach(SharedGroup& sg);
+    void detach() REALM_NOEXCEPT;
+
+    /// Optimize the changed tables of \a group that have candidate columns.
+    /// Must be called in a write transaction. Returns the number of tables
+    /// that were optimized.
+    std::size_t run(Group& group);
+
+    /// Whether the sampled cardinality of the specified string column is low
+    /// enough for it to be enumerated.
+    bool is_candidate(const Table& table, std::size_t column_ndx) const;
+
+private:
+    double m_max_distinct_ratio;
+    std::size_t m_sample_size;
+    std::size_t m_min_rows;
+    SharedGroup* m_shared_group = nullptr;
+
+    // Version of each group level table at the previous run(), by name,
+    // because the index of a table changes when other tables are inserted
+    // or removed
+    std::unordered_map<std::string, uint_fast64_t> m_table_versions;
+
+    AutoEnumerator(const AutoEnumerator&) = delete;
+    AutoEnumerator& operator=(const AutoEnumerator&) = delete;
+
+    static void run_hook(void* enumerator, Group&);
+
+    friend class WriteTransaction;
+    friend class LangBindHelper;
+};
+
+
+
+
+// Implementation:
+
+inline AutoEnumerator::AutoEnumerator(double max_distinct_ratio, std::size_t sample_size,
+                                      std::size_t min_rows):
+    m_max_distinct_ratio(max_distinct_ratio),
+    m_sample_size(sample_size),
+    m_min_rows(min_rows)
+{
+}
+
+inline AutoEnumerator::~AutoEnumerator() REALM_NOEXCEPT
+{
+    detach();
+}
+
+inline void AutoEnumerator::attach(SharedGroup& sg)
+{
+    detach();
+    _impl::PreCommitHooks::add(sg, &AutoEnumerator::run_hook, this); // Throws
+    m_shared_group = &sg;
+}
+
+inline void AutoEnumerator::detach() REALM_NOEXCEPT
+{
+    if (m_shared_group) {
+        _impl::PreCommitHooks::remove(*m_shared_group, this);
+        m_shared_group = nullptr;
+    }
+}
+
+inline void AutoEnumerator::run_hook(void* enumerator, Group& group)
+{
+    static_cast<AutoEnumerator*>(enumerator)->run(group); // Throws
+}
+
+inline bool AutoEnumerator::is_candidate(const Table& table, std::size_t column_ndx) const
+{
+    std::size_t num_rows = table.size();
+    if (num_rows < m_min_rows || m_sample_size == 0)
+        return false;
+
+    // Evenly spaced rows, so that clustered values do not fool the estimate
+    std::size_t num_samples = std::min(m_sample_size, num_rows);
+    std::size_t max_distinct = std::size_t(num_samples * m_max_distinct_ratio);
+    std::unordered_set<std::string> distinct;
+    for (std::size_t i = 0; i < num_samples; ++i) {
+        std::size_t row_ndx = std::size_t(uint_fast64_t(i) * num_rows / num_samples);
+        StringData value = table.get_string(column_ndx, row_ndx);
+        distinct.insert(std::string(value.data(), value.size())); // Throws
+        if (distinct.size() > max_distinct)
+            return false;
+    }
+    return true;
+}
+
+inline std::size_t AutoEnumerator::run(Group& group)
+{
+    // Only the tables that exist now are remembered, so the versions of
+    // removed tables do not pile up
+    std::unordered_map<std::string, uint_fast64_t> table_versions;
+    table_versions.swap(m_table_versions);
+
+    std::size_t num_tables = group.size();
+    std::size_t num_optimized = 0;
+    for (std::size_t table_ndx = 0; table_ndx < num_tables; ++table_ndx) {
+        TableRef table = group.get_table(table_ndx); // Throws
+#ifdef REALM_ENABLE_REPLICATION
+        std::string name = group.get_table_name(table_ndx); // Throws
+        auto i = table_versions.find(name);
+        if (i != table_versions.end() && i->second == table->m_version) {
+            m_table_versions.insert(*i); // Throws
+            continue;
+        }
+#endif
+        bool has_candidate = false;
+        std::size_t num_columns = table->get_column_count();
+        for (std::size_t col_ndx = 0; col_ndx < num_columns && !has_candidate; ++col_ndx) {
+            if (table->get_real_column_type(col_ndx) == col_type_String)
+                has_candidate = is_candidate(*table, col_ndx); // Throws
+        }
+        if (has_candidate) {
+            bool enforce = false; // Let the columns decide for themselves
+            table->optimize(enforce); // Throws
+            ++num_optimized;
+        }
+#ifdef REALM_ENABLE_REPLICATION
+        m_table_versions[name] = table->m_version; // Throws
+#endif
+    }
+    return num_optimized;
+}
+
+inline SharedGroup::version_type WriteTransaction::commit(AutoEnumerator& enumerator)
+{
+    REALM_ASSERT(m_shared_group);
+    // commit() runs the enumerator anyway when it is attached here
+    if (enumerator.m_shared_group != m_shared_group)
+        enumerator.run(get_group()); // Throws
+    return commit(); // Throws
+}
+
+inline void LangBindHelper::commit_and_continue_as_read(SharedGroup& sg, AutoEnumerator& enumerator)
+{
+    using sgf = _impl::SharedGroupFriend;
+    // commit_and_continue_as_read(sg) runs the enumerator anyway when it is
+    // attached here
+    if (enumerator.m_shared_group != &sg)
+        enumerator.run(sgf::get_group(sg)); // Throws
+    commit_and_continue_as_read(sg); // Throws
+}
+
+} // namespace realm
+
+#endif // REALM_AUTO_ENUMERATE_HPP
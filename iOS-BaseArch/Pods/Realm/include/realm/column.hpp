@@ -24,6 +24,8 @@
 #include <cstdlib> // std::size_t
 #include <vector>
 #include <memory>
+#include <algorithm>
+#include <thread>
 
 #include <realm/array_integer.hpp>
 #include <realm/column_type.hpp>
@@ -613,6 +615,273 @@ inline void ColumnBase::set_search_index_ref(ref_type, ArrayParent*, std::size_t
 {
 }
 
+inline void StringIndex::find_all_prefix(StringData prefix, std::vector<size_t>& result) const
+{
+    std::vector<size_t> candidates;
+    find_prefix_candidates(*m_array, prefix, 0, candidates);
+
+    // The key range is exact only for the leading bytes of each key, so the
+    // candidates are checked against the values themselves
+    char buffer[sizeof(int64_t)];
+    size_t first_new = result.size();
+    for (size_t i = 0; i < candidates.size(); ++i) {
+        if (m_target_column->get_index_data(candidates[i], buffer).begins_with(prefix))
+            result.push_back(candidates[i]);
+    }
+    std::sort(result.begin() + first_new, result.end());
+    result.erase(std::unique(result.begin() + first_new, result.end()), result.end());
+}
+
+inline StringIndex::key_type StringIndex::bulk_key(StringData value, size_t offset) REALM_NOEXCEPT
+{
+    return offset <= value.size() ? create_key(value, offset) : 0;
+}
+
+inline int StringIndex::bulk_compare(StringData a, StringData b) REALM_NOEXCEPT
+{
+    for (size_t offset = 0; ; offset += sizeof(key_type)) {
+        key_type key_a = bulk_key(a, offset);
+        key_type key_b = bulk_key(b, offset);
+        if (key_a != key_b)
+            return key_a < key_b ? -1 : 1;
+        if (offset >= a.size() && offset >= b.size())
+            return 0;
+    }
+}
+
+inline void StringIndex::bulk_insert(const std::vector<StringData>& values, unsigned int num_threads)
+{
+    REALM_ASSERT(is_empty());
+
+    size_t num_rows = values.size();
+    if (num_rows == 0)
+        return;
+
+    // Rows with equal values stay in row order, which is the order of row lists
+    std::vector<size_t> rows(num_rows);
+    for (size_t i = 0; i < num_rows; ++i)
+        rows[i] = i;
+    auto less = [&values](size_t a, size_t b) {
+        int c = bulk_compare(values[a], values[b]);
+        return c < 0 || (c == 0 && a < b);
+    };
+
+    // Each thread sorts one chunk, and the chunks are then merged pairwise
+    const size_t min_chunk_size = 64 * 1024;
+    size_t num_chunks = std::max<size_t>(1, std::min<size_t>(num_threads, num_rows / min_chunk_size));
+    std::vector<size_t> bounds;
+    for (size_t i = 0; i <= num_chunks; ++i)
+        bounds.push_back(num_rows * i / num_chunks);
+    {
+        std::vector<std::thread> threads;
+        try {
+            for (size_t i = 1; i < num_chunks; ++i) {
+                threads.emplace_back([&rows, &bounds, &less, i] {
+                    std::sort(rows.begin() + bounds[i], rows.begin() + bounds[i + 1], less);
+                }); // Throws
+            }
+        }
+        catch (...) {
+            for (size_t i = 0; i < threads.size(); ++i)
+                threads[i].join();
+            throw;
+        }
+        std::sort(rows.begin() + bounds[0], rows.begin() + bounds[1], less);
+        for (size_t i = 0; i < threads.size(); ++i)
+            threads[i].join();
+    }
+    for (size_t width = 1; width < num_chunks; width *= 2) {
+        for (size_t i = 0; i + width < num_chunks; i += 2 * width) {
+            size_t last = std::min(i + 2 * width, num_chunks);
+            std::inplace_merge(rows.begin() + bounds[i], rows.begin() + bounds[i + width],
+                               rows.begin() + bounds[last], less);
+        }
+    }
+
+    Allocator& alloc = m_array->get_alloc();
+    ref_type root = bulk_build(alloc, values, rows.data(), rows.data() + num_rows, 0); // Throws
+
+#ifdef REALM_DEBUG_INDEX_BULK
+    // The entries must be those that inserting the rows one by one gives.
+    // This builds the index a second time, row by row, which costs more than
+    // the bulk build saves, so it is not part of REALM_DEBUG builds.
+    {
+        StringIndex reference(m_target_column, alloc); // Throws
+        for (size_t i = 0; i < num_rows; ++i)
+            reference.insert(i, values[i], 1, true); // Throws
+        std::vector<std::pair<int, int64_t>> entries, reference_entries;
+        bulk_get_entries(alloc, root, entries); // Throws
+        bulk_get_entries(alloc, reference.get_ref(), reference_entries); // Throws
+        reference.destroy();
+        REALM_ASSERT(entries == reference_entries);
+    }
+#endif
+
+    // Replace the empty root leaf
+    m_array->destroy_deep();
+    m_array->init_from_ref(root);
+    m_array->update_parent();
+}
+
+inline void StringIndex::bulk_rebuild()
+{
+    // Integer values are written to the buffer, so each row gets its own
+    // part of it
+    size_t num_rows = m_target_column->size();
+    std::unique_ptr<char[]> buffer(new char[num_rows * sizeof(int64_t)]); // Throws
+    std::vector<StringData> values;
+    values.reserve(num_rows); // Throws
+    for (size_t row_ndx = 0; row_ndx != num_rows; ++row_ndx)
+        values.push_back(m_target_column->get_index_data(row_ndx, buffer.get() + row_ndx * sizeof(int64_t)));
+
+    clear(); // Throws
+    unsigned int num_threads = std::max(1u, std::thread::hardware_concurrency());
+    bulk_insert(values, num_threads); // Throws
+}
+
+inline ref_type StringIndex::bulk_build(Allocator& alloc, const std::vector<StringData>& values,
+                                        const size_t* begin, const size_t* end, size_t offset)
+{
+    // The entries of one level of the tree, and of the level above it while
+    // that is being built. Entries of the first level are literal rows (odd),
+    // row lists and sub-indexes; those of the levels above are nodes.
+    std::vector<int64_t> keys, entries;
+    std::vector<int64_t> next_keys, next_entries;
+    size_t num_attached = 0;
+    try {
+        for (const size_t* i = begin; i != end;) {
+            key_type key = bulk_key(values[*i], offset);
+            const size_t* group_end = i + 1;
+            while (group_end != end && bulk_key(values[*group_end], offset) == key)
+                ++group_end;
+            keys.push_back(key); // Throws
+            entries.push_back(0); // Throws
+
+            if (group_end - i == 1) {
+                // Single row, stored literally and tagged
+                entries.back() = (int64_t(*i) << 1) + 1;
+            }
+            else if (bulk_compare(values[*i], values[*(group_end - 1)]) == 0) {
+                // Equal values, the sort put them in row order
+                Column row_list(alloc, Column::create(alloc)); // Throws
+                try {
+                    for (const size_t* j = i; j != group_end; ++j)
+                        row_list.add(int64_t(*j)); // Throws
+                }
+                catch (...) {
+                    row_list.destroy();
+                    throw;
+                }
+                entries.back() = int64_t(row_list.get_ref());
+            }
+            else {
+                // Values that only share this key go to a sub-index keyed by the next 4 bytes
+                entries.back() = int64_t(bulk_build(alloc, values, i, group_end, offset + 4)); // Throws
+            }
+            i = group_end;
+        }
+
+        const size_t max_node_size = REALM_MAX_BPNODE_SIZE;
+        for (bool is_leaf = true; is_leaf || entries.size() > 1; is_leaf = false) {
+            size_t n = entries.size();
+            next_keys.reserve((n + max_node_size - 1) / max_node_size); // Throws
+            next_entries.reserve((n + max_node_size - 1) / max_node_size); // Throws
+            for (size_t i = 0; i < n; i += max_node_size) {
+                size_t size = std::min(max_node_size, n - i);
+                ref_type ref = bulk_build_node(alloc, is_leaf, &keys[i], &entries[i], size); // Throws
+                num_attached = i + size;
+                // An inner node holds the last key of each child
+                next_keys.push_back(keys[i + size - 1]);
+                next_entries.push_back(int64_t(ref));
+            }
+            keys.swap(next_keys);
+            entries.swap(next_entries);
+            next_keys.clear();
+            next_entries.clear();
+            num_attached = 0;
+        }
+    }
+    catch (...) {
+        for (size_t i = num_attached; i < entries.size(); ++i) {
+            if (entries[i] != 0 && (entries[i] & 1) == 0)
+                Array::destroy_deep(to_ref(entries[i]), alloc);
+        }
+        for (size_t i = 0; i < next_entries.size(); ++i)
+            Array::destroy_deep(to_ref(next_entries[i]), alloc);
+        throw;
+    }
+    return to_ref(entries[0]);
+}
+
+inline ref_type StringIndex::bulk_build_node(Allocator& alloc, bool is_leaf, const int64_t* keys,
+                                             const int64_t* entries, size_t size)
+{
+    // Same layout as create_node(): the keys, then one entry per key. The
+    // entries are only attached, so a failure destroys the node shallowly.
+    Array keys_array(alloc);
+    keys_array.create(Array::type_Normal); // Throws
+    _impl::DestroyGuard<Array> keys_guard(&keys_array);
+    keys_array.ensure_minimum_width(0x7FFFFFFF); // Throws, 31 bits plus a sign bit
+    for (size_t i = 0; i < size; ++i)
+        keys_array.add(keys[i]); // Throws
+
+    Array node(alloc);
+    node.create(is_leaf ? Array::type_HasRefs : Array::type_InnerBptreeNode, true); // Throws
+    _impl::DestroyGuard<Array> node_guard(&node);
+    node.add(int64_t(keys_array.get_ref())); // Throws
+    for (size_t i = 0; i < size; ++i)
+        node.add(entries[i]); // Throws
+
+    keys_guard.release();
+    node_guard.release();
+    return node.get_ref();
+}
+
+#ifdef REALM_DEBUG_INDEX_BULK
+
+inline void StringIndex::bulk_get_entries(Allocator& alloc, ref_type ref,
+                                          std::vector<std::pair<int, int64_t>>& entries)
+{
+    enum { key_entry, literal_entry, row_list_entry, sub_index_begin, sub_index_end };
+
+    Array node(alloc);
+    node.init_from_ref(ref);
+    Array keys(alloc);
+    keys.init_from_ref(node.get_as_ref(0));
+
+    for (size_t i = 0; i < keys.size(); ++i) {
+        if (node.is_inner_bptree_node()) {
+            // Child i holds the keys up to and including keys[i]
+            Array child(alloc);
+            child.init_from_ref(node.get_as_ref(i + 1));
+            Array child_keys(alloc);
+            child_keys.init_from_ref(child.get_as_ref(0));
+            REALM_ASSERT_3(keys.get(i), ==, child_keys.back());
+            bulk_get_entries(alloc, child.get_ref(), entries); // Throws
+            continue;
+        }
+
+        entries.push_back(std::make_pair(int(key_entry), keys.get(i))); // Throws
+        int64_t entry = node.get(i + 1);
+        if (entry & 1) {
+            entries.push_back(std::make_pair(int(literal_entry), int64_t(uint64_t(entry) >> 1))); // Throws
+        }
+        else if (Array::get_context_flag_from_header(alloc.translate(to_ref(entry)))) {
+            entries.push_back(std::make_pair(int(sub_index_begin), int64_t(0))); // Throws
+            bulk_get_entries(alloc, to_ref(entry), entries); // Throws
+            entries.push_back(std::make_pair(int(sub_index_end), int64_t(0))); // Throws
+        }
+        else {
+            std::vector<size_t> rows;
+            add_row_list(alloc, to_ref(entry), rows); // Throws
+            for (size_t j = 0; j < rows.size(); ++j)
+                entries.push_back(std::make_pair(int(row_list_entry), int64_t(rows[j]))); // Throws
+        }
+    }
+}
+
+#endif // REALM_DEBUG_INDEX_BULK
+
 inline void ColumnBase::set_search_index_allow_duplicate_values(bool) REALM_NOEXCEPT
 {
 }
@@ -821,14 +1090,8 @@ template <class T, bool N>
 void TColumn<T,N>::populate_search_index()
 {
     REALM_ASSERT(has_search_index());
-    // Populate the index
-    std::size_t num_rows = size();
-    for (std::size_t row_ndx = 0; row_ndx != num_rows; ++row_ndx) {
-        T value = get(row_ndx);
-        size_t num_rows = 1;
-        bool is_append = true;
-        m_search_index->insert(row_ndx, value, num_rows, is_append); // Throws
-    }
+    // Populate the index in one pass
+    m_search_index->bulk_rebuild(); // Throws
 }
 
 template <class T, bool N>
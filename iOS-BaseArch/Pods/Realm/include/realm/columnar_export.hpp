@@ -0,0 +1,382 @@
+/*************************************************************************
+ *
+ * REALM CONFIDENTIAL
+ * __________________
+ *
+ *  [2011] - [2015] Realm Inc
+ *  All Rights Reserved.
+ *
+ * NOTICE:  All information contained herein is, and remains
+ * the property of Realm Incorporated and its suppliers,
+ * if any.  The intellectual and technical concepts contained
+ * herein are proprietary to Realm Incorporated
+ * and its suppliers and may be covered by U.S. and Foreign Patents,
+ * patents in process, and are protected by trade secret or copyright law.
+ * Dissemination of this information or reproduction of this material
+ * is strictly forbidden unless prior written permission is obtained
+ * from Realm Incorporated.
+ *
+ **************************************************************************/
+#ifndef REALM_COLUMNAR_EXPORT_HPP
+#define REALM_COLUMNAR_EXPORT_HPP
+
+#include <vector>
+
+#include <realm/table.hpp>
+#include <realm/table_view.hpp>
+#include <realm/query_engine.hpp>
+
+namespace realm {
+
+/// The values of one column, laid out like an Apache Arrow array: one
+/// contiguous buffer of fixed width values, or of offsets into a contiguous
+/// buffer of string/binary bytes, plus a validity bitmap.
+struct ColumnarBuffer {
+    DataType type = type_Int;
+    std::size_t size = 0;
+    std::size_t null_count = 0;
+
+    /// type_Int, type_Bool, type_DateTime and type_Link (the target row
+    /// index). Null rows hold 0.
+    std::vector<int64_t> ints;
+
+    /// type_Float and type_Double.
+    std::vector<float> floats;
+    std::vector<double> doubles;
+
+    /// type_String and type_Binary exported with
+    /// ColumnarExport::strings_copy. The bytes of row `i` are
+    /// `data[offsets[i]]` up to `data[offsets[i + 1]]`, so `offsets` has
+    /// `size + 1` entries.
+    std::vector<int64_t> offsets;
+    std::vector<char> data;
+
+    /// type_String and type_Binary exported with
+    /// ColumnarExport::strings_by_reference. Each entry points directly at the
+    /// bytes in the Realm file, so they are only valid for as long as the
+    /// table accessor is, and until the table is modified.
+    std::vector<BinaryData> views;
+
+    /// Bit `i` (least significant bit first) is set if row `i` is not null.
+    /// Empty if no row is null.
+    std::vector<uint8_t> validity;
+
+    bool is_null(std::size_t row_ndx) const REALM_NOEXCEPT;
+};
+
+
+/// Export columns of a table, or of a table view, to ColumnarBuffer objects.
+///
+/// Values are decoded from the column leaves in bulk rather than through the
+/// per-cell accessors (Table::get_int() etc.), so a table can be scanned at
+/// close to memory bandwidth. Rows of a table view are gathered in view
+/// order, and detached rows are exported as null.
+///
+/// Columns of type Table, Mixed and LinkList cannot be exported and cause
+/// LogicError::type_mismatch.
+class ColumnarExport {
+public:
+    enum StringMode {
+        strings_copy,        ///< Copy into ColumnarBuffer::offsets and ColumnarBuffer::data
+        strings_by_reference ///< Refer to the bytes in place from ColumnarBuffer::views
+    };
+
+    static void export_column(const Table&, std::size_t column_ndx, ColumnarBuffer&, std::size_t begin = 0,
+                              std::size_t end = npos, StringMode = strings_copy);
+    static void export_column(const TableViewBase&, std::size_t column_ndx, ColumnarBuffer&,
+                              StringMode = strings_copy);
+
+private:
+    struct TableRows {
+        static const bool contiguous = true;
+        std::size_t begin;
+        std::size_t end;
+        std::size_t size() const REALM_NOEXCEPT { return end - begin; }
+        std::size_t operator[](std::size_t i) const REALM_NOEXCEPT { return begin + i; }
+    };
+
+    struct ViewRows {
+        static const bool contiguous = false;
+        const TableViewBase& view;
+        std::size_t size() const REALM_NOEXCEPT { return view.size(); }
+        std::size_t operator[](std::size_t i) const REALM_NOEXCEPT
+        {
+            return view.is_row_attached(i) ? view.get_source_ndx(i) : npos;
+        }
+    };
+
+    template<class Rows>
+    static void export_rows(DataType, const ColumnBase&, const Rows&, ColumnarBuffer&, StringMode);
+
+    template<class T, class ColType, class Rows>
+    static void export_values(const ColType&, const Rows&, std::vector<T>& values, ColumnarBuffer&);
+
+    template<class Rows>
+    static void export_enum_strings(const ColumnStringEnum&, const Rows&, ColumnarBuffer&, StringMode);
+
+    template<class Rows>
+    static void export_strings(const AdaptiveStringColumn&, const Rows&, ColumnarBuffer&, StringMode);
+
+    template<class Rows>
+    static void export_binaries(const ColumnBinary&, const Rows&, ColumnarBuffer&, StringMode);
+
+    template<class Rows>
+    static void export_links(const ColumnLink&, const Rows&, ColumnarBuffer&);
+
+    template<class Leaf, class T>
+    static void decode(const Leaf&, std::size_t ndx_in_leaf, std::size_t count, T* out);
+    static void decode(const ArrayInteger&, std::size_t ndx_in_leaf, std::size_t count, int64_t* out);
+
+    // Only nullable integer leaves can hold nulls. For the others the check compiles away.
+    template<class Leaf>
+    static bool is_null(const Leaf&, std::size_t) REALM_NOEXCEPT { return false; }
+    static bool is_null(const ArrayIntNull& leaf, std::size_t ndx) REALM_NOEXCEPT { return leaf.is_null(ndx); }
+
+    static void add_bytes(ColumnarBuffer&, std::size_t row_ndx, BinaryData, StringMode);
+    static void set_null(ColumnarBuffer&, std::size_t row_ndx);
+};
+
+
+
+
+// Implementation:
+
+inline bool ColumnarBuffer::is_null(std::size_t row_ndx) const REALM_NOEXCEPT
+{
+    return !validity.empty() && (validity[row_ndx / 8] & (1 << (row_ndx % 8))) == 0;
+}
+
+inline void ColumnarExport::export_column(const Table& table, std::size_t column_ndx, ColumnarBuffer& buf,
+                                          std::size_t begin, std::size_t end, StringMode mode)
+{
+    if (end == npos)
+        end = table.size();
+    REALM_ASSERT_3(begin, <=, end);
+    REALM_ASSERT_3(end, <=, table.size());
+
+    TableRows rows { begin, end };
+    export_rows(table.get_column_type(column_ndx), table.get_column_base(column_ndx), rows, buf, mode);
+}
+
+inline void ColumnarExport::export_column(const TableViewBase& view, std::size_t column_ndx, ColumnarBuffer& buf,
+                                          StringMode mode)
+{
+    ViewRows rows { view };
+    export_rows(view.get_column_type(column_ndx), view.get_column_base(column_ndx), rows, buf, mode);
+}
+
+template<class Rows>
+void ColumnarExport::export_rows(DataType type, const ColumnBase& col, const Rows& rows, ColumnarBuffer& buf,
+                                 StringMode mode)
+{
+    buf = ColumnarBuffer();
+    buf.type = type;
+    buf.size = rows.size();
+    if (type == type_String || type == type_Binary) {
+        if (mode == strings_copy) {
+            buf.offsets.reserve(buf.size + 1);
+            buf.offsets.push_back(0);
+        }
+        else {
+            buf.views.reserve(buf.size);
+        }
+    }
+
+    switch (type) {
+        case type_Int:
+        case type_Bool:
+        case type_DateTime:
+            if (col.is_nullable())
+                export_values<int64_t, ColumnIntNull>(static_cast<const ColumnIntNull&>(col), rows, buf.ints, buf);
+            else
+                export_values<int64_t, Column>(static_cast<const Column&>(col), rows, buf.ints, buf);
+            return;
+        case type_Float:
+            export_values<float, ColumnFloat>(static_cast<const ColumnFloat&>(col), rows, buf.floats, buf);
+            return;
+        case type_Double:
+            export_values<double, ColumnDouble>(static_cast<const ColumnDouble&>(col), rows, buf.doubles, buf);
+            return;
+        case type_String:
+            if (const ColumnStringEnum* cse = dynamic_cast<const ColumnStringEnum*>(&col))
+                export_enum_strings(*cse, rows, buf, mode);
+            else
+                export_strings(static_cast<const AdaptiveStringColumn&>(col), rows, buf, mode);
+            return;
+        case type_Binary:
+            export_binaries(static_cast<const ColumnBinary&>(col), rows, buf, mode);
+            return;
+        case type_Link:
+            export_links(static_cast<const ColumnLink&>(col), rows, buf);
+            return;
+        case type_Table:
+        case type_Mixed:
+        case type_LinkList:
+            break;
+    }
+    throw LogicError(LogicError::type_mismatch);
+}
+
+template<class T, class ColType, class Rows>
+void ColumnarExport::export_values(const ColType& col, const Rows& rows, std::vector<T>& values,
+                                   ColumnarBuffer& buf)
+{
+    SequentialGetter<ColType> getter(&col);
+    std::size_t n = rows.size();
+    values.resize(n);
+
+    for (std::size_t i = 0; i < n; ) {
+        std::size_t row_ndx = rows[i];
+        if (row_ndx == npos) {
+            values[i] = T();
+            set_null(buf, i);
+            ++i;
+            continue;
+        }
+
+        // Decode the rest of the leaf in one go when the rows are consecutive
+        getter.cache_next(row_ndx);
+        std::size_t ndx_in_leaf = row_ndx - getter.m_leaf_start;
+        std::size_t count = 1;
+        if (Rows::contiguous)
+            count = std::min(n - i, getter.m_leaf_end - row_ndx);
+
+        decode(*getter.m_leaf_ptr, ndx_in_leaf, count, &values[i]);
+        for (std::size_t t = 0; t < count; ++t) {
+            if (is_null(*getter.m_leaf_ptr, ndx_in_leaf + t)) {
+                values[i + t] = T();
+                set_null(buf, i + t);
+            }
+        }
+        i += count;
+    }
+}
+
+template<class Rows>
+void ColumnarExport::export_enum_strings(const ColumnStringEnum& col, const Rows& rows, ColumnarBuffer& buf,
+                                         StringMode mode)
+{
+    // Decode the key indexes in bulk, then look each of them up among the (few) keys
+    const AdaptiveStringColumn& keys = col.get_keys();
+    std::vector<StringData> key_values(keys.size());
+    for (std::size_t k = 0; k < key_values.size(); ++k)
+        key_values[k] = keys.get(k);
+
+    std::vector<int64_t> key_ndxs;
+    export_values<int64_t, Column>(col, rows, key_ndxs, buf);
+
+    for (std::size_t i = 0; i < key_ndxs.size(); ++i) {
+        StringData s = buf.is_null(i) ? StringData() : key_values[to_size_t(key_ndxs[i])];
+        add_bytes(buf, i, BinaryData(s.data(), s.size()), mode);
+    }
+}
+
+template<class Rows>
+void ColumnarExport::export_strings(const AdaptiveStringColumn& col, const Rows& rows, ColumnarBuffer& buf,
+                                    StringMode mode)
+{
+    std::unique_ptr<const ArrayParent> leaf;
+    AdaptiveStringColumn::LeafType leaf_type = AdaptiveStringColumn::leaf_type_Small;
+    std::size_t leaf_start = 0;
+    std::size_t leaf_end = 0;
+
+    for (std::size_t i = 0; i < rows.size(); ++i) {
+        std::size_t row_ndx = rows[i];
+        StringData s;
+        if (row_ndx != npos) {
+            if (row_ndx < leaf_start || row_ndx >= leaf_end) {
+                std::size_t ndx_in_leaf;
+                leaf = col.get_leaf(row_ndx, ndx_in_leaf, leaf_type);
+                leaf_start = row_ndx - ndx_in_leaf;
+                if (leaf_type == AdaptiveStringColumn::leaf_type_Small)
+                    leaf_end = leaf_start + static_cast<const ArrayString&>(*leaf).size();
+                else if (leaf_type == AdaptiveStringColumn::leaf_type_Medium)
+                    leaf_end = leaf_start + static_cast<const ArrayStringLong&>(*leaf).size();
+                else
+                    leaf_end = leaf_start + static_cast<const ArrayBigBlobs&>(*leaf).size();
+            }
+
+            if (leaf_type == AdaptiveStringColumn::leaf_type_Small)
+                s = static_cast<const ArrayString&>(*leaf).get(row_ndx - leaf_start);
+            else if (leaf_type == AdaptiveStringColumn::leaf_type_Medium)
+                s = static_cast<const ArrayStringLong&>(*leaf).get(row_ndx - leaf_start);
+            else
+                s = static_cast<const ArrayBigBlobs&>(*leaf).get_string(row_ndx - leaf_start);
+        }
+        add_bytes(buf, i, BinaryData(s.data(), s.size()), mode);
+    }
+}
+
+template<class Rows>
+void ColumnarExport::export_binaries(const ColumnBinary& col, const Rows& rows, ColumnarBuffer& buf,
+                                     StringMode mode)
+{
+    for (std::size_t i = 0; i < rows.size(); ++i) {
+        std::size_t row_ndx = rows[i];
+        add_bytes(buf, i, row_ndx == npos ? BinaryData() : col.get(row_ndx), mode);
+    }
+}
+
+template<class Rows>
+void ColumnarExport::export_links(const ColumnLink& col, const Rows& rows, ColumnarBuffer& buf)
+{
+    buf.ints.resize(rows.size());
+    for (std::size_t i = 0; i < rows.size(); ++i) {
+        std::size_t row_ndx = rows[i];
+        std::size_t target = row_ndx == npos ? npos : col.get_link(row_ndx);
+        if (target == npos) {
+            buf.ints[i] = 0;
+            set_null(buf, i);
+        }
+        else {
+            buf.ints[i] = int64_t(target);
+        }
+    }
+}
+
+template<class Leaf, class T>
+inline void ColumnarExport::decode(const Leaf& leaf, std::size_t ndx_in_leaf, std::size_t count, T* out)
+{
+    for (std::size_t t = 0; t < count; ++t)
+        out[t] = leaf.get(ndx_in_leaf + t);
+}
+
+inline void ColumnarExport::decode(const ArrayInteger& leaf, std::size_t ndx_in_leaf, std::size_t count,
+                                   int64_t* out)
+{
+    // get_chunk() unpacks 8 values per call instead of dispatching on the bit width for each value
+    std::size_t t = 0;
+    for (; t + 8 <= count; t += 8)
+        leaf.get_chunk(ndx_in_leaf + t, out + t);
+    for (; t < count; ++t)
+        out[t] = leaf.get(ndx_in_leaf + t);
+}
+
+inline void ColumnarExport::add_bytes(ColumnarBuffer& buf, std::size_t row_ndx, BinaryData value, StringMode mode)
+{
+    if (value.is_null())
+        set_null(buf, row_ndx);
+
+    if (mode == strings_by_reference) {
+        buf.views.push_back(value);
+        return;
+    }
+
+    buf.data.insert(buf.data.end(), value.data(), value.data() + value.size());
+    buf.offsets.push_back(int64_t(buf.data.size()));
+}
+
+inline void ColumnarExport::set_null(ColumnarBuffer& buf, std::size_t row_ndx)
+{
+    // The bitmap is only allocated once the first null is seen, with all rows marked valid
+    if (buf.is_null(row_ndx))
+        return;
+    if (buf.validity.empty())
+        buf.validity.resize((buf.size + 7) / 8, 0xFF);
+    buf.validity[row_ndx / 8] &= uint8_t(~(1 << (row_ndx % 8)));
+    ++buf.null_count;
+}
+
+} // namespace realm
+
+#endif // REALM_COLUMNAR_EXPORT_HPP
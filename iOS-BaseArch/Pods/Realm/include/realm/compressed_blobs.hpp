@@ -0,0 +1,619 @@
+/*************************************************************************
+ *
+ * REALM CONFIDENTIAL
+ * __________________
+ *
+ *  [2011] - [2015] Realm Inc
+ *  All Rights Reserved.
+ *
+ * NOTICE:  All information contained herein is, and remains
+ * the property of Realm Incorporated and its suppliers,
+ * if any.  The intellectual and technical concepts contained
+ * herein are proprietary to Realm Incorporated
+ * and its suppliers and may be covered by U.S. and Foreign Patents,
+ * patents in process, and are protected by trade secret or copyright law.
+ * Dissemination of this information or reproduction of this material
+ * is strictly forbidden unless prior written permission is obtained
+ * from Realm Incorporated.
+ *
+ **************************************************************************/
+#ifndef REALM_COMPRESSED_BLOBS_HPP
+#define REALM_COMPRESSED_BLOBS_HPP
+
+#include <algorithm>
+#include <exception>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <realm/util/compression.hpp>
+#include <realm/table.hpp>
+#include <realm/group.hpp>
+
+namespace realm {
+
+/// Thrown when a value of a compressed binary column cannot be decompressed,
+/// either because it is corrupt, because it was compressed with a different
+/// dictionary than the one in use, or because it was not written through
+/// CompressedBlobs at all.
+class BadCompressedValue: public std::exception {
+public:
+    const char* what() const REALM_NOEXCEPT_OR_NOTHROW override;
+};
+
+
+/// Accessor that stores the values of a binary column compressed, and makes
+/// that transparent to get().
+///
+/// Each value is stored with a header of a 4 byte marker, which includes the
+/// format version, and one byte that says how the value is encoded:
+/// uncompressed, compressed, or compressed against a dictionary. Values that
+/// are smaller than the minimum size, or that do not shrink, are stored
+/// uncompressed. Nulls and empty values are stored as they are. All the
+/// values of the column must be written through this class; a column that
+/// already holds plain values is converted with compress_plain(). A value
+/// without the marker, such as one written with Table::set_binary(), is
+/// rejected by get() with BadCompressedValue rather than misread.
+///
+/// The dictionary is a sample of byte sequences that are common in the
+/// column, such as the keys of JSON documents. It lets small values be
+/// compressed on their own. For a group-level table, it is stored in the
+/// Realm file, in a row of the table named by metadata_table_name() that
+/// identifies the column by the names of its table and itself. The row is
+/// added the first time the column is written through this class, and it
+/// marks the column as compressed. Accessors load the dictionary when they
+/// are constructed. The dictionary of a subtable column is not stored, and
+/// must be set on every accessor. The values remember a checksum of the
+/// dictionary, so that a wrong dictionary is detected.
+///
+/// Decompressed values are cached for the rows of one leaf sized block at a
+/// time, so that a scan that reads a value more than once, or reads the values
+/// of a block in any order, decompresses each value once. The cache is
+/// discarded when the version of the table changes. Without replication,
+/// tables have no version, so, as for IndexSnapshot, nothing is cached, and
+/// every get() decompresses.
+class CompressedBlobs {
+public:
+    /// \param min_size Values smaller than this are stored uncompressed.
+    CompressedBlobs(Table& table, std::size_t column_ndx, std::size_t min_size = 64);
+
+    Table& get_table() const REALM_NOEXCEPT;
+    std::size_t get_column_index() const REALM_NOEXCEPT;
+
+    /// Also stores the dictionary in the file, for a group-level table, so
+    /// it must then be called in a write transaction.
+    void set_dictionary(BinaryData dictionary);
+    BinaryData get_dictionary() const REALM_NOEXCEPT;
+
+    /// Whether the column has been marked as compressed in the file. Always
+    /// false for subtables.
+    bool is_marked() const;
+
+    /// The name of the group-level table that holds the dictionaries of the
+    /// compressed columns.
+    static StringData metadata_table_name() REALM_NOEXCEPT;
+
+    /// Build a dictionary of at most \a max_size bytes from the byte
+    /// sequences that occur in most of up to \a sample_size values of the
+    /// column. Values that are already stored compressed are decompressed
+    /// first.
+    std::string train_dictionary(std::size_t max_size = 16 * 1024,
+                                 std::size_t sample_size = 1000) const;
+
+    /// The returned value stays valid until get() is called for a row in a
+    /// different block, or the table is changed.
+    BinaryData get(std::size_t row_ndx) const;
+    StringData get_string(std::size_t row_ndx) const;
+
+    void set(std::size_t row_ndx, BinaryData value);
+    void set_string(std::size_t row_ndx, StringData value);
+
+    /// Encode all the values of a column that was written uncompressed,
+    /// directly through the table. Values that already carry the marker are
+    /// left as they are.
+    void compress_plain();
+
+    /// Re-encode all the values of the column with the current dictionary,
+    /// after it has replaced \a old_dictionary.
+    void recompress(BinaryData old_dictionary);
+
+    /// Encode \a value into \a out. \a dictionary may be empty.
+    static void encode(BinaryData value, BinaryData dictionary, std::size_t min_size,
+                       std::vector<char>& out);
+
+    /// Decode \a stored into \a out. Returns \a stored without the header if it
+    /// was stored uncompressed, otherwise the decompressed value in \a out.
+    static BinaryData decode(BinaryData stored, BinaryData dictionary, std::string& out);
+
+private:
+    enum Method {
+        method_stored     = 0,
+        method_lz         = 1,
+        method_lz_dict    = 2
+    };
+
+    static const std::size_t block_size = REALM_MAX_BPNODE_SIZE;
+
+    // The marker with the format version, followed by the method byte
+    static const std::size_t marker_size = 4;
+    static const std::size_t header_size = marker_size + 1;
+
+    // Columns of the metadata table
+    enum {
+        metadata_col_table      = 0,
+        metadata_col_column     = 1,
+        metadata_col_dictionary = 2
+    };
+
+    static bool has_marker(BinaryData stored) REALM_NOEXCEPT;
+    static void put_marker(std::vector<char>& out);
+    static uint32_t checksum(BinaryData) REALM_NOEXCEPT;
+    static BinaryData stored_value(BinaryData stored) REALM_NOEXCEPT;
+    static void do_encode(BinaryData value, BinaryData dictionary, uint32_t dictionary_checksum,
+                          std::size_t min_size, std::vector<char>& out);
+    static BinaryData do_decode(BinaryData stored, BinaryData dictionary,
+                                uint32_t dictionary_checksum, std::string& out);
+    static void put_size(uint_fast64_t size, std::vector<char>& out);
+    static bool get_size(const char*& begin, const char* end, uint_fast64_t& size) REALM_NOEXCEPT;
+
+    void reset_cache(std::size_t block_begin) const;
+
+    // The row of the metadata table that describes the column, or npos
+    std::size_t find_metadata_row(const Table& metadata) const;
+    void load_dictionary();
+    // Adds the row of the column to the metadata table if it is missing, and
+    // stores the dictionary in it
+    void store_metadata();
+
+    TableRef m_table;
+    std::size_t m_column_ndx;
+    std::size_t m_min_size;
+    std::string m_dictionary;
+    uint32_t m_dictionary_checksum;
+    bool m_is_stored = false; // The metadata row is known to be up to date
+
+    mutable std::size_t m_cache_begin = npos;
+    mutable std::vector<std::string> m_cache_values;
+    mutable std::vector<bool> m_cache_is_decoded;
+    mutable uint_fast64_t m_cache_version = 0;
+    mutable std::vector<char> m_encode_buffer;
+};
+
+
+
+
+// Implementation:
+
+inline const char* BadCompressedValue::what() const REALM_NOEXCEPT_OR_NOTHROW
+{
+    return "Compressed value is corrupt or uses another dictionary";
+}
+
+inline CompressedBlobs::CompressedBlobs(Table& table, std::size_t column_ndx,
+                                        std::size_t min_size):
+    m_table(table.get_table_ref()),
+    m_column_ndx(column_ndx),
+    m_min_size(min_size),
+    m_dictionary_checksum(checksum(BinaryData()))
+{
+    if (table.get_column_type(column_ndx) != type_Binary)
+        throw LogicError(LogicError::type_mismatch);
+    load_dictionary(); // Throws
+}
+
+inline Table& CompressedBlobs::get_table() const REALM_NOEXCEPT
+{
+    return *m_table;
+}
+
+inline std::size_t CompressedBlobs::get_column_index() const REALM_NOEXCEPT
+{
+    return m_column_ndx;
+}
+
+inline void CompressedBlobs::set_dictionary(BinaryData dictionary)
+{
+    m_dictionary.assign(dictionary.data(), dictionary.size()); // Throws
+    m_dictionary_checksum = checksum(dictionary);
+    m_cache_begin = npos;
+    m_is_stored = false;
+    store_metadata(); // Throws
+}
+
+inline BinaryData CompressedBlobs::get_dictionary() const REALM_NOEXCEPT
+{
+    return BinaryData(m_dictionary.data(), m_dictionary.size());
+}
+
+inline StringData CompressedBlobs::metadata_table_name() REALM_NOEXCEPT
+{
+    return "__compressed_blobs";
+}
+
+inline std::size_t CompressedBlobs::find_metadata_row(const Table& metadata) const
+{
+    StringData table_name = m_table->get_name();
+    StringData column_name = m_table->get_column_name(m_column_ndx);
+    std::size_t num_rows = metadata.size();
+    for (std::size_t i = 0; i < num_rows; ++i) {
+        if (metadata.get_string(metadata_col_table, i) == table_name &&
+                metadata.get_string(metadata_col_column, i) == column_name)
+            return i;
+    }
+    return npos;
+}
+
+inline bool CompressedBlobs::is_marked() const
+{
+    Group* group = m_table->get_parent_group();
+    if (!group || !group->has_table(metadata_table_name()))
+        return false;
+    ConstTableRef metadata = static_cast<const Group*>(group)->get_table(metadata_table_name()); // Throws
+    return find_metadata_row(*metadata) != npos;
+}
+
+inline void CompressedBlobs::load_dictionary()
+{
+    Group* group = m_table->get_parent_group();
+    if (!group || !group->has_table(metadata_table_name()))
+        return;
+    ConstTableRef metadata = static_cast<const Group*>(group)->get_table(metadata_table_name()); // Throws
+    std::size_t row_ndx = find_metadata_row(*metadata);
+    if (row_ndx == npos)
+        return;
+    BinaryData dictionary = metadata->get_binary(metadata_col_dictionary, row_ndx);
+    m_dictionary.assign(dictionary.data(), dictionary.size()); // Throws
+    m_dictionary_checksum = checksum(dictionary);
+    m_is_stored = true;
+}
+
+inline void CompressedBlobs::store_metadata()
+{
+    if (m_is_stored)
+        return;
+    Group* group = m_table->get_parent_group();
+    if (!group)
+        return;
+
+    bool was_added = false;
+    TableRef metadata = group->get_or_add_table(metadata_table_name(), &was_added); // Throws
+    if (was_added) {
+        metadata->add_column(type_String, "table"); // Throws
+        metadata->add_column(type_String, "column"); // Throws
+        metadata->add_column(type_Binary, "dictionary"); // Throws
+    }
+    std::size_t row_ndx = find_metadata_row(*metadata);
+    if (row_ndx == npos) {
+        row_ndx = metadata->add_empty_row(); // Throws
+        metadata->set_string(metadata_col_table, row_ndx, m_table->get_name()); // Throws
+        metadata->set_string(metadata_col_column, row_ndx,
+                             m_table->get_column_name(m_column_ndx)); // Throws
+    }
+    metadata->set_binary(metadata_col_dictionary, row_ndx, get_dictionary()); // Throws
+    m_is_stored = true;
+}
+
+inline bool CompressedBlobs::has_marker(BinaryData stored) REALM_NOEXCEPT
+{
+    // The first byte is not valid UTF-8 on its own, so text values do not
+    // begin with the marker. The last byte is the format version.
+    const char* data = stored.data();
+    return stored.size() >= header_size && static_cast<unsigned char>(data[0]) == 0x8E &&
+        data[1] == 'R' && data[2] == 'Z' && data[3] == 1;
+}
+
+inline void CompressedBlobs::put_marker(std::vector<char>& out)
+{
+    out.push_back(char(0x8E)); // Throws
+    out.push_back('R'); // Throws
+    out.push_back('Z'); // Throws
+    out.push_back(char(1)); // Throws
+}
+
+inline uint32_t CompressedBlobs::checksum(BinaryData data) REALM_NOEXCEPT
+{
+    // FNV-1a
+    uint32_t h = 2166136261U;
+    for (std::size_t i = 0; i < data.size(); ++i) {
+        h ^= static_cast<unsigned char>(data.data()[i]);
+        h *= 16777619U;
+    }
+    return h;
+}
+
+inline BinaryData CompressedBlobs::stored_value(BinaryData stored) REALM_NOEXCEPT
+{
+    // Without the header
+    if (stored.size() == 0)
+        return stored;
+    return BinaryData(stored.data() + header_size, stored.size() - header_size);
+}
+
+inline void CompressedBlobs::put_size(uint_fast64_t size, std::vector<char>& out)
+{
+    while (size >= 0x80) {
+        out.push_back(char((size & 0x7F) | 0x80)); // Throws
+        size >>= 7;
+    }
+    out.push_back(char(size)); // Throws
+}
+
+inline bool CompressedBlobs::get_size(const char*& begin, const char* end,
+                                      uint_fast64_t& size) REALM_NOEXCEPT
+{
+    size = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (begin == end)
+            return false;
+        unsigned char c = static_cast<unsigned char>(*begin++);
+        size |= uint_fast64_t(c & 0x7F) << shift;
+        if ((c & 0x80) == 0)
+            return true;
+    }
+    return false;
+}
+
+inline void CompressedBlobs::encode(BinaryData value, BinaryData dictionary,
+                                    std::size_t min_size, std::vector<char>& out)
+{
+    do_encode(value, dictionary, checksum(dictionary), min_size, out); // Throws
+}
+
+inline BinaryData CompressedBlobs::decode(BinaryData stored, BinaryData dictionary,
+                                          std::string& out)
+{
+    return do_decode(stored, dictionary, checksum(dictionary), out); // Throws
+}
+
+inline void CompressedBlobs::do_encode(BinaryData value, BinaryData dictionary,
+                                       uint32_t dictionary_checksum, std::size_t min_size,
+                                       std::vector<char>& out)
+{
+    out.clear();
+    if (value.size() == 0)
+        return;
+
+    put_marker(out); // Throws
+    if (value.size() >= min_size) {
+        bool has_dictionary = dictionary.size() != 0;
+        out.push_back(char(has_dictionary ? method_lz_dict : method_lz)); // Throws
+        if (has_dictionary) {
+            for (int i = 0; i < 4; ++i)
+                out.push_back(char((dictionary_checksum >> (8 * i)) & 0xFF)); // Throws
+        }
+        put_size(value.size(), out); // Throws
+        std::size_t prefix_size = out.size();
+
+        // Only worth it if it saves something
+        std::size_t capacity = value.size() - 1 - std::min(value.size() - 1, prefix_size - marker_size);
+        out.resize(prefix_size + util::compression::compress_bound(value.size())); // Throws
+        std::size_t size = util::compression::compress(value.data(), value.size(),
+                                                       out.data() + prefix_size, capacity,
+                                                       dictionary.data(), dictionary.size()); // Throws
+        if (size != 0) {
+            out.resize(prefix_size + size);
+            return;
+        }
+        out.resize(marker_size);
+    }
+
+    out.push_back(char(method_stored)); // Throws
+    out.insert(out.end(), value.data(), value.data() + value.size()); // Throws
+}
+
+inline BinaryData CompressedBlobs::do_decode(BinaryData stored, BinaryData dictionary,
+                                             uint32_t dictionary_checksum, std::string& out)
+{
+    if (stored.size() == 0)
+        return stored;
+    if (!has_marker(stored))
+        throw BadCompressedValue();
+
+    const char* begin = stored.data() + marker_size;
+    const char* end = stored.data() + stored.size();
+    int method = static_cast<unsigned char>(*begin++);
+    if (method == method_stored)
+        return stored_value(stored);
+
+    if (method == method_lz_dict) {
+        if (end - begin < 4)
+            throw BadCompressedValue();
+        uint32_t h = 0;
+        for (int i = 0; i < 4; ++i)
+            h |= uint32_t(static_cast<unsigned char>(*begin++)) << (8 * i);
+        if (h != dictionary_checksum)
+            throw BadCompressedValue();
+    }
+    else if (method == method_lz) {
+        dictionary = BinaryData();
+    }
+    else {
+        throw BadCompressedValue();
+    }
+
+    // A sequence expands to at most 255 times the size of its encoding, so
+    // a larger size can only come from corruption
+    uint_fast64_t size;
+    if (!get_size(begin, end, size) || size / 256 > uint_fast64_t(end - begin))
+        throw BadCompressedValue();
+    out.resize(std::size_t(size)); // Throws
+    if (!util::compression::decompress(begin, end - begin, &out[0], out.size(),
+                                       dictionary.data(), dictionary.size()))
+        throw BadCompressedValue();
+    return BinaryData(out.data(), out.size());
+}
+
+inline void CompressedBlobs::reset_cache(std::size_t block_begin) const
+{
+    std::size_t num_rows = std::min(block_size, m_table->size() - block_begin);
+    m_cache_values.resize(num_rows); // Throws
+    m_cache_is_decoded.assign(num_rows, false); // Throws
+    m_cache_begin = block_begin;
+#ifdef REALM_ENABLE_REPLICATION
+    m_cache_version = m_table->m_version;
+#endif
+}
+
+inline BinaryData CompressedBlobs::get(std::size_t row_ndx) const
+{
+    BinaryData stored = m_table->get_binary(m_column_ndx, row_ndx);
+    if (stored.size() == 0)
+        return stored;
+    if (!has_marker(stored))
+        throw BadCompressedValue();
+    if (static_cast<unsigned char>(stored.data()[marker_size]) == method_stored)
+        return stored_value(stored);
+
+#ifdef REALM_ENABLE_REPLICATION
+    std::size_t block_begin = row_ndx - row_ndx % block_size;
+    if (block_begin != m_cache_begin || m_cache_version != m_table->m_version)
+        reset_cache(block_begin); // Throws
+#else
+    // A change made through the Table cannot be detected, so the value is
+    // decoded into a buffer that is not reused
+    m_cache_begin = npos;
+    m_cache_values.resize(1); // Throws
+    do_decode(stored, get_dictionary(), m_dictionary_checksum, m_cache_values[0]); // Throws
+    return BinaryData(m_cache_values[0].data(), m_cache_values[0].size());
+#endif
+
+    std::size_t i = row_ndx - block_begin;
+    std::string& value = m_cache_values[i];
+    if (!m_cache_is_decoded[i]) {
+        do_decode(stored, get_dictionary(), m_dictionary_checksum, value); // Throws
+        m_cache_is_decoded[i] = true;
+    }
+    return BinaryData(value.data(), value.size());
+}
+
+inline StringData CompressedBlobs::get_string(std::size_t row_ndx) const
+{
+    BinaryData value = get(row_ndx); // Throws
+    return StringData(value.data(), value.size());
+}
+
+inline void CompressedBlobs::set(std::size_t row_ndx, BinaryData value)
+{
+    store_metadata(); // Throws
+    if (value.is_null()) {
+        m_table->set_binary(m_column_ndx, row_ndx, value); // Throws
+    }
+    else {
+        do_encode(value, get_dictionary(), m_dictionary_checksum, m_min_size,
+                  m_encode_buffer); // Throws
+        BinaryData stored(m_encode_buffer.data(), m_encode_buffer.size());
+        if (stored.size() > Table::max_binary_size)
+            throw LogicError(LogicError::binary_too_big);
+        if (stored.is_null())
+            stored = BinaryData("", 0);
+        m_table->set_binary(m_column_ndx, row_ndx, stored); // Throws
+    }
+    // Without replication, the version cannot tell us about this change
+    m_cache_begin = npos;
+}
+
+inline void CompressedBlobs::set_string(std::size_t row_ndx, StringData value)
+{
+    set(row_ndx, BinaryData(value.data(), value.size())); // Throws
+}
+
+inline void CompressedBlobs::compress_plain()
+{
+    std::string buffer;
+    std::size_t num_rows = m_table->size();
+    for (std::size_t i = 0; i < num_rows; ++i) {
+        BinaryData value = m_table->get_binary(m_column_ndx, i);
+        if (value.size() == 0 || has_marker(value))
+            continue;
+        // set() may move the value in the file
+        buffer.assign(value.data(), value.size()); // Throws
+        set(i, BinaryData(buffer.data(), buffer.size())); // Throws
+    }
+}
+
+inline void CompressedBlobs::recompress(BinaryData old_dictionary)
+{
+    uint32_t old_checksum = checksum(old_dictionary);
+    std::string buffer;
+    std::size_t num_rows = m_table->size();
+    for (std::size_t i = 0; i < num_rows; ++i) {
+        BinaryData stored = m_table->get_binary(m_column_ndx, i);
+        if (stored.size() == 0)
+            continue;
+        if (has_marker(stored) && static_cast<unsigned char>(stored.data()[marker_size]) == method_stored &&
+                stored.size() - header_size < m_min_size)
+            continue;
+        BinaryData value = do_decode(stored, old_dictionary, old_checksum, buffer); // Throws
+        if (value.data() != buffer.data()) {
+            buffer.assign(value.data(), value.size()); // Throws
+            value = BinaryData(buffer.data(), buffer.size());
+        }
+        set(i, value); // Throws
+    }
+}
+
+inline std::string CompressedBlobs::train_dictionary(std::size_t max_size,
+                                                     std::size_t sample_size) const
+{
+    // Count, for every 8 byte sequence, the number of sampled values that
+    // contain it, and fill the dictionary with the most common ones. Only the
+    // beginning of large values is looked at.
+    const std::size_t gram_size = 8;
+    const std::size_t max_bytes_per_value = 4096;
+    max_size = std::min(max_size, util::compression::_impl::max_offset);
+
+    std::size_t num_rows = m_table->size();
+    std::size_t num_samples = std::min(sample_size, num_rows);
+    typedef std::unordered_map<std::string, std::pair<std::size_t, std::size_t>> Counts;
+    Counts counts; // Number of values, last value
+    std::string buffer;
+    for (std::size_t i = 0; i < num_samples; ++i) {
+        std::size_t row_ndx = std::size_t(uint_fast64_t(i) * num_rows / num_samples);
+        // Sampled before compress_plain(), the values are not marked yet
+        BinaryData value = m_table->get_binary(m_column_ndx, row_ndx);
+        if (has_marker(value))
+            value = do_decode(value, get_dictionary(), m_dictionary_checksum, buffer); // Throws
+        std::size_t size = std::min(value.size(), max_bytes_per_value);
+        for (std::size_t j = 0; j + gram_size <= size; ++j) {
+            std::pair<std::size_t, std::size_t>& count =
+                counts[std::string(value.data() + j, gram_size)]; // Throws
+            if (count.first == 0 || count.second != i) {
+                ++count.first;
+                count.second = i;
+            }
+        }
+    }
+
+    std::vector<std::pair<std::size_t, const std::string*>> grams;
+    for (Counts::const_iterator i = counts.begin(); i != counts.end(); ++i) {
+        if (i->second.first >= 2)
+            grams.push_back(std::make_pair(i->second.first, &i->first)); // Throws
+    }
+    std::sort(grams.begin(), grams.end(),
+              [](const std::pair<std::size_t, const std::string*>& a,
+                 const std::pair<std::size_t, const std::string*>& b) {
+                  return a.first != b.first ? a.first > b.first : *a.second < *b.second;
+              });
+
+    std::string dictionary;
+    for (std::size_t i = 0; i < grams.size(); ++i) {
+        const std::string& gram = *grams[i].second;
+        if (dictionary.find(gram) != std::string::npos)
+            continue;
+        // Let overlapping sequences share their common part
+        std::size_t overlap = gram_size - 1;
+        while (overlap > 0 && (dictionary.size() < overlap ||
+                               dictionary.compare(dictionary.size() - overlap, overlap,
+                                                  gram, 0, overlap) != 0))
+            --overlap;
+        if (dictionary.size() + gram_size - overlap > max_size)
+            break;
+        dictionary.append(gram, overlap, std::string::npos); // Throws
+    }
+    return dictionary;
+}
+
+} // namespace realm
+
+#endif // REALM_COMPRESSED_BLOBS_HPP
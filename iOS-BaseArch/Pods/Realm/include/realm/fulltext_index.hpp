@@ -0,0 +1,491 @@
+/*************************************************************************
+ *
+ * REALM CONFIDENTIAL
+ * __________________
+ *
+ *  [2011] - [2015] Realm Inc
+ *  All Rights Reserved.
+ *
+ * NOTICE:  All information contained herein is, and remains
+ * the property of Realm Incorporated and its suppliers,
+ * if any.  The intellectual and technical concepts contained
+ * herein are proprietary to Realm Incorporated
+ * and its suppliers and may be covered by U.S. and Foreign Patents,
+ * patents in process, and are protected by trade secret or copyright law.
+ * Dissemination of this information or reproduction of this material
+ * is strictly forbidden unless prior written permission is obtained
+ * from Realm Incorporated.
+ *
+ **************************************************************************/
+#ifndef REALM_FULLTEXT_INDEX_HPP
+#define REALM_FULLTEXT_INDEX_HPP
+
+#include <algorithm>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <realm/unicode.hpp>
+#include <realm/column.hpp>
+#include <realm/table.hpp>
+#include <realm/query_engine.hpp>
+#include <realm/index_snapshot.hpp>
+
+namespace realm {
+
+/// Full-text index over the words of a string column.
+///
+/// A word is a maximal run of ASCII letters and digits and of non-ASCII
+/// characters, so that letters of any script stay together. The text is
+/// decoded as UTF-8, and the common non-ASCII spaces and punctuation also
+/// separate words: those of Latin-1 (such as U+00A0, the no-break space), the
+/// General Punctuation and Supplemental Punctuation blocks, CJK Symbols and
+/// Punctuation (such as U+3000, the ideographic space), and the punctuation of
+/// the CJK compatibility, small and fullwidth forms. Bytes that are not valid
+/// UTF-8 are kept in words as they are. Words are indexed
+/// in lower case, and each distinct word maps to a posting list: the sorted
+/// indexes of the rows that contain it. Posting lists are integer columns, so
+/// they are stored as bit-packed B+-trees like the row lists of StringIndex.
+///
+/// The index lives in memory and belongs to the Table accessor it was built
+/// from. It is a snapshot helper, brought up to date as described for
+/// IndexSnapshot. Its hooks mirror those that StringIndex is maintained
+/// through.
+class FullTextIndex {
+public:
+    FullTextIndex(const Table& table, std::size_t column_ndx);
+    ~FullTextIndex() REALM_NOEXCEPT;
+
+    const Table& get_table() const REALM_NOEXCEPT;
+    std::size_t get_column_index() const REALM_NOEXCEPT;
+
+    /// Number of distinct words.
+    std::size_t size() const REALM_NOEXCEPT;
+
+    /// Rebuild the index if the table has changed since the index was
+    /// built or last updated through the hooks below.
+    void sync_if_needed();
+    void rebuild();
+
+    //@{
+    /// Incremental maintenance, for callers that pass every change of the
+    /// column to the index. Each function must be called after the
+    /// corresponding change has been made to the table. \a value is the
+    /// string that the row held (erase(), move_last_over()) or now holds
+    /// (insert()).
+    void insert(std::size_t row_ndx, StringData value, std::size_t num_rows, bool is_append);
+    void set(std::size_t row_ndx, StringData old_value, StringData new_value);
+    void erase(std::size_t row_ndx, StringData value, bool is_last);
+    void move_last_over(std::size_t row_ndx, std::size_t last_row_ndx, StringData value,
+                        StringData last_value);
+    void clear();
+    //@}
+
+    /// Write to \a rows, in ascending order, the rows that contain all the
+    /// words in \a text. A word that is followed by '*' matches every word
+    /// that begins with it. If \a text has no words, all rows match.
+    void find_all(StringData text, std::vector<std::size_t>& rows) const;
+
+    /// Split \a text into lower case words. Duplicates are removed.
+    static void tokenize(StringData text, std::vector<std::string>& words);
+
+private:
+    typedef std::map<std::string, std::unique_ptr<Column>> Postings;
+
+    struct Term {
+        std::string word;
+        bool is_prefix;
+    };
+
+    /// Whether the character that starts at \a pos is part of a word. Its
+    /// length in bytes is stored in \a char_size.
+    static bool is_word_char(StringData text, std::size_t pos, std::size_t& char_size) REALM_NOEXCEPT;
+    static bool is_separator(uint_fast32_t code_point) REALM_NOEXCEPT;
+    static std::string fold(StringData word);
+    static void parse(StringData text, std::vector<Term>& terms);
+
+    void add_row(std::size_t row_ndx, StringData value);
+    void remove_row(std::size_t row_ndx, StringData value);
+    void add_posting(const std::string& word, std::size_t row_ndx);
+    void remove_posting(const std::string& word, std::size_t row_ndx);
+    void term_rows(const Term& term, std::vector<std::size_t>& rows) const;
+
+    ConstTableRef m_table;
+    std::size_t m_column_ndx;
+    Postings m_postings;
+    IndexSnapshot m_snapshot;
+};
+
+
+/// Query condition that is answered from a FullTextIndex, by intersecting
+/// the posting lists of the words.
+class FullTextNode: public IndexRowsNode {
+public:
+    FullTextNode(FullTextIndex& index, StringData text):
+        IndexRowsNode(index.get_column_index()), m_index(&index), m_text(text)
+    {
+    }
+    ~FullTextNode() REALM_NOEXCEPT override {}
+
+    ParentNode* clone() override
+    {
+        return new FullTextNode(*this);
+    }
+
+    FullTextNode(const FullTextNode& from)
+        : IndexRowsNode(from)
+    {
+        m_index = from.m_index;
+        m_text = from.m_text;
+    }
+
+protected:
+    void find_rows(const Table&, std::vector<size_t>& rows) override
+    {
+        m_index->sync_if_needed();
+        m_index->find_all(m_text, rows);
+    }
+
+private:
+    FullTextIndex* m_index;
+    std::string m_text;
+};
+
+
+
+
+// Implementation:
+
+inline FullTextIndex::FullTextIndex(const Table& table, std::size_t column_ndx):
+    m_table(table.get_table_ref()),
+    m_column_ndx(column_ndx)
+{
+    if (table.get_column_type(column_ndx) != type_String)
+        throw LogicError(LogicError::type_mismatch);
+    rebuild(); // Throws
+}
+
+inline FullTextIndex::~FullTextIndex() REALM_NOEXCEPT
+{
+    for (Postings::iterator i = m_postings.begin(); i != m_postings.end(); ++i)
+        i->second->destroy();
+}
+
+inline const Table& FullTextIndex::get_table() const REALM_NOEXCEPT
+{
+    return *m_table;
+}
+
+inline std::size_t FullTextIndex::get_column_index() const REALM_NOEXCEPT
+{
+    return m_column_ndx;
+}
+
+inline std::size_t FullTextIndex::size() const REALM_NOEXCEPT
+{
+    return m_postings.size();
+}
+
+inline void FullTextIndex::sync_if_needed()
+{
+    if (!m_snapshot.is_current(*m_table))
+        rebuild(); // Throws
+}
+
+inline void FullTextIndex::rebuild()
+{
+    clear();
+    std::size_t n = m_table->size();
+    for (std::size_t row_ndx = 0; row_ndx < n; ++row_ndx)
+        add_row(row_ndx, m_table->get_string(m_column_ndx, row_ndx)); // Throws
+    m_snapshot.mark_current(*m_table);
+}
+
+inline void FullTextIndex::insert(std::size_t row_ndx, StringData value, std::size_t num_rows, bool is_append)
+{
+    // Rows after the inserted ones move up
+    if (!is_append) {
+        for (Postings::iterator i = m_postings.begin(); i != m_postings.end(); ++i)
+            i->second->adjust_ge(int64_t(row_ndx), int64_t(num_rows));
+    }
+    for (std::size_t t = 0; t < num_rows; ++t)
+        add_row(row_ndx + t, value); // Throws
+    m_snapshot.mark_current(*m_table);
+}
+
+inline void FullTextIndex::set(std::size_t row_ndx, StringData old_value, StringData new_value)
+{
+    if (new_value != old_value) {
+        remove_row(row_ndx, old_value);
+        add_row(row_ndx, new_value); // Throws
+    }
+    m_snapshot.mark_current(*m_table);
+}
+
+inline void FullTextIndex::erase(std::size_t row_ndx, StringData value, bool is_last)
+{
+    remove_row(row_ndx, value);
+    if (!is_last) {
+        for (Postings::iterator i = m_postings.begin(); i != m_postings.end(); ++i)
+            i->second->adjust_ge(int64_t(row_ndx + 1), -1);
+    }
+    m_snapshot.mark_current(*m_table);
+}
+
+inline void FullTextIndex::move_last_over(std::size_t row_ndx, std::size_t last_row_ndx, StringData value,
+                                          StringData last_value)
+{
+    remove_row(row_ndx, value);
+    if (row_ndx != last_row_ndx) {
+        remove_row(last_row_ndx, last_value);
+        add_row(row_ndx, last_value); // Throws
+    }
+    m_snapshot.mark_current(*m_table);
+}
+
+inline void FullTextIndex::clear()
+{
+    for (Postings::iterator i = m_postings.begin(); i != m_postings.end(); ++i)
+        i->second->destroy();
+    m_postings.clear();
+    m_snapshot.mark_current(*m_table);
+}
+
+inline void FullTextIndex::find_all(StringData text, std::vector<std::size_t>& rows) const
+{
+    std::vector<Term> terms;
+    parse(text, terms);
+
+    rows.clear();
+    if (terms.empty()) {
+        std::size_t n = m_table->size();
+        for (std::size_t row_ndx = 0; row_ndx < n; ++row_ndx)
+            rows.push_back(row_ndx);
+        return;
+    }
+
+    std::vector<std::size_t> term_matches, intersection;
+    term_rows(terms[0], rows);
+    for (std::size_t t = 1; t < terms.size() && !rows.empty(); ++t) {
+        term_rows(terms[t], term_matches);
+        intersection.clear();
+        std::set_intersection(rows.begin(), rows.end(), term_matches.begin(), term_matches.end(),
+                              std::back_inserter(intersection));
+        rows.swap(intersection);
+    }
+}
+
+inline void FullTextIndex::term_rows(const Term& term, std::vector<std::size_t>& rows) const
+{
+    rows.clear();
+    Postings::const_iterator i = m_postings.lower_bound(term.word);
+    Postings::const_iterator end = i;
+    if (term.is_prefix) {
+        while (end != m_postings.end() && end->first.compare(0, term.word.size(), term.word) == 0)
+            ++end;
+    }
+    else if (i != m_postings.end() && i->first == term.word) {
+        ++end;
+    }
+
+    for (; i != end; ++i) {
+        const Column& postings = *i->second;
+        std::size_t n = postings.size();
+        std::size_t middle = rows.size();
+        for (std::size_t t = 0; t < n; ++t)
+            rows.push_back(to_size_t(postings.get(t)));
+        // Several words for a prefix are merged into one sorted list
+        if (middle != 0)
+            std::inplace_merge(rows.begin(), rows.begin() + middle, rows.end());
+    }
+    rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+}
+
+inline bool FullTextIndex::is_word_char(StringData text, std::size_t pos, std::size_t& char_size) REALM_NOEXCEPT
+{
+    unsigned char u = static_cast<unsigned char>(text[pos]);
+    char_size = 1;
+    if (u < 0x80)
+        return (u >= '0' && u <= '9') || (u >= 'a' && u <= 'z') || (u >= 'A' && u <= 'Z');
+
+    std::size_t n;
+    uint_fast32_t code_point;
+    if (u >= 0xC2 && u <= 0xDF) {
+        n = 2;
+        code_point = u & 0x1F;
+    }
+    else if (u >= 0xE0 && u <= 0xEF) {
+        n = 3;
+        code_point = u & 0x0F;
+    }
+    else if (u >= 0xF0 && u <= 0xF4) {
+        n = 4;
+        code_point = u & 0x07;
+    }
+    else {
+        return true; // Not a lead byte
+    }
+    if (text.size() - pos < n)
+        return true;
+    for (std::size_t i = 1; i < n; ++i) {
+        unsigned char c = static_cast<unsigned char>(text[pos + i]);
+        if ((c & 0xC0) != 0x80)
+            return true;
+        code_point = code_point << 6 | (c & 0x3F);
+    }
+    char_size = n;
+    return !is_separator(code_point);
+}
+
+inline bool FullTextIndex::is_separator(uint_fast32_t c) REALM_NOEXCEPT
+{
+    if (c < 0x00C0) {
+        // Latin-1 controls, spaces and punctuation, but not the ordinal
+        // indicators, the micro sign and the superscript digits and fractions
+        return c != 0x00AA && c != 0x00B2 && c != 0x00B3 && c != 0x00B5 && c != 0x00B9 &&
+            c != 0x00BA && !(c >= 0x00BC && c <= 0x00BE);
+    }
+    if (c < 0x2000) {
+        return c == 0x00D7 || c == 0x00F7 ||                      // Multiplication and division signs
+            c == 0x037E || c == 0x0387 || c == 0x0589 ||          // Greek and Armenian punctuation
+            c == 0x060C || c == 0x061B || c == 0x061F ||          // Arabic comma, semicolon, question mark
+            (c >= 0x066A && c <= 0x066D) || c == 0x06D4 ||        // Arabic percent sign to full stop
+            c == 0x0964 || c == 0x0965 ||                         // Devanagari dandas
+            c == 0x1680;                                          // Ogham space mark
+    }
+    if (c <= 0x206F)
+        return c != 0x200C && c != 0x200D; // Zero width (non-)joiners belong to words
+    if (c >= 0x2E00 && c <= 0x2E7F)
+        return true; // Supplemental Punctuation
+    if (c >= 0x3000 && c <= 0x303F) {
+        // Iteration marks, ideographic numbers and kana repeat marks are
+        // letters
+        return !(c >= 0x3005 && c <= 0x3007) && !(c >= 0x3021 && c <= 0x3029) &&
+            !(c >= 0x3031 && c <= 0x3035) && !(c >= 0x3038 && c <= 0x303C);
+    }
+    if (c >= 0xFE10 && c <= 0xFE1F)
+        return true; // Vertical forms
+    if (c >= 0xFE30 && c <= 0xFE6F)
+        return true; // CJK compatibility and small forms
+    if (c == 0xFEFF)
+        return true; // Byte order mark
+    if (c >= 0xFF00 && c <= 0xFF65) {
+        // Fullwidth and halfwidth punctuation, but not the fullwidth digits
+        // and Latin letters
+        return !(c >= 0xFF10 && c <= 0xFF19) && !(c >= 0xFF21 && c <= 0xFF3A) &&
+            !(c >= 0xFF41 && c <= 0xFF5A);
+    }
+    return false;
+}
+
+inline std::string FullTextIndex::fold(StringData word)
+{
+    bool ascii = true;
+    for (std::size_t t = 0; t < word.size(); ++t)
+        ascii &= static_cast<unsigned char>(word[t]) < 0x80;
+    if (!ascii)
+        return case_map(word, false); // Throws
+
+    std::string folded(word.data(), word.size());
+    for (std::size_t t = 0; t < folded.size(); ++t) {
+        if (folded[t] >= 'A' && folded[t] <= 'Z')
+            folded[t] = char(folded[t] - 'A' + 'a');
+    }
+    return folded;
+}
+
+inline void FullTextIndex::parse(StringData text, std::vector<Term>& terms)
+{
+    std::size_t t = 0;
+    std::size_t char_size;
+    while (t < text.size()) {
+        if (!is_word_char(text, t, char_size)) {
+            t += char_size;
+            continue;
+        }
+        std::size_t begin = t;
+        while (t < text.size() && is_word_char(text, t, char_size))
+            t += char_size;
+        Term term;
+        term.word = fold(text.substr(begin, t - begin)); // Throws
+        term.is_prefix = t < text.size() && text[t] == '*';
+        terms.push_back(term);
+    }
+}
+
+inline void FullTextIndex::tokenize(StringData text, std::vector<std::string>& words)
+{
+    words.clear();
+    std::vector<Term> terms;
+    parse(text, terms);
+    for (std::size_t t = 0; t < terms.size(); ++t)
+        words.push_back(terms[t].word);
+    std::sort(words.begin(), words.end());
+    words.erase(std::unique(words.begin(), words.end()), words.end());
+}
+
+inline void FullTextIndex::add_row(std::size_t row_ndx, StringData value)
+{
+    std::vector<std::string> words;
+    tokenize(value, words); // Throws
+    for (std::size_t t = 0; t < words.size(); ++t)
+        add_posting(words[t], row_ndx); // Throws
+}
+
+inline void FullTextIndex::remove_row(std::size_t row_ndx, StringData value)
+{
+    std::vector<std::string> words;
+    tokenize(value, words); // Throws
+    for (std::size_t t = 0; t < words.size(); ++t)
+        remove_posting(words[t], row_ndx);
+}
+
+inline void FullTextIndex::add_posting(const std::string& word, std::size_t row_ndx)
+{
+    std::unique_ptr<Column>& postings = m_postings[word];
+    if (!postings) {
+        Allocator& alloc = Allocator::get_default();
+        postings.reset(new Column(alloc, Column::create(alloc))); // Throws
+    }
+    // Rows are usually added in ascending order, in which case this appends
+    std::size_t ndx = postings->lower_bound_int(int64_t(row_ndx));
+    if (ndx == postings->size())
+        postings->add(int64_t(row_ndx)); // Throws
+    else if (to_size_t(postings->get(ndx)) != row_ndx)
+        postings->insert(ndx, int64_t(row_ndx)); // Throws
+}
+
+inline void FullTextIndex::remove_posting(const std::string& word, std::size_t row_ndx)
+{
+    Postings::iterator i = m_postings.find(word);
+    if (i == m_postings.end())
+        return;
+
+    Column& postings = *i->second;
+    std::size_t ndx = postings.lower_bound_int(int64_t(row_ndx));
+    if (ndx == postings.size() || to_size_t(postings.get(ndx)) != row_ndx)
+        return;
+
+    bool is_last = ndx == postings.size() - 1;
+    postings.erase(ndx, is_last);
+    if (postings.is_empty()) {
+        postings.destroy();
+        m_postings.erase(i);
+    }
+}
+
+inline Query& Query::contains_words(FullTextIndex& index, StringData text)
+{
+    if (&index.get_table() != m_table.get())
+        throw LogicError(LogicError::illegal_combination);
+
+    ParentNode* const p = new FullTextNode(index, text);
+    UpdatePointers(p, &p->m_child);
+    return *this;
+}
+
+} // namespace realm
+
+#endif // REALM_FULLTEXT_INDEX_HPP
@@ -0,0 +1,651 @@
+/*************************************************************************
+ *
+ * REALM CONFIDENTIAL
+ * __________________
+ *
+ *  [2011] - [2015] Realm Inc
+ *  All Rights Reserved.
+ *
+ * NOTICE:  All information contained herein is, and remains
+ * the property of Realm Incorporated and its suppliers,
+ * if any.  The intellectual and technical concepts contained
+ * herein are proprietary to Realm Incorporated
+ * and its suppliers and may be covered by U.S. and Foreign Patents,
+ * patents in process, and are protected by trade secret or copyright law.
+ * Dissemination of this information or reproduction of this material
+ * is strictly forbidden unless prior written permission is obtained
+ * from Realm Incorporated.
+ *
+ **************************************************************************/
+#ifndef REALM_GROUP_BY_HPP
+#define REALM_GROUP_BY_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <realm/exceptions.hpp>
+#include <realm/table.hpp>
+#include <realm/table_view.hpp>
+#include <realm/query.hpp>
+#include <realm/util/thread.hpp>
+
+namespace realm {
+
+/// One aggregate of a GroupBy. `column_ndx` is ignored for aggr_count, which
+/// counts the rows of each group.
+struct GroupByAggregate {
+    Table::AggrType op;
+    std::size_t column_ndx;
+};
+
+/// Hash based grouping on any number of key columns, with any number of
+/// aggregates, computed in one pass over the rows of a Table, a TableView or
+/// the matches of a Query.
+///
+/// The result table gets one row per group, in the order in which the groups
+/// first appear. Its columns are the key columns, with the names and types of
+/// the source columns, followed by one column per aggregate:
+///
+///  - aggr_count: type_Int, named "count".
+///  - aggr_sum: type_Int for int, bool and DateTime columns, type_Double for
+///    float and double columns, named "sum_<column>".
+///  - aggr_avg: type_Double, named "avg_<column>".
+///  - aggr_min, aggr_max: the type of the column, named "min_<column>" or
+///    "max_<column>".
+///
+/// Null values are left out of the aggregates. The sum, average, minimum
+/// and maximum of a group without values are 0, as for Table::sum_int() and
+/// friends. Key columns can be int, bool, DateTime, float, double or string
+/// columns, and nulls form a group of their own. Aggregate columns can be
+/// int, bool, DateTime, float or double columns.
+///
+/// With more than one thread, the rows are split into chunks of whole leaves.
+/// Each chunk is aggregated into its own hash table, and the partial results
+/// are merged in row order, so the groups, their order, counts, minimums and
+/// maximums, and integer sums are the same as with one thread. Float and
+/// double sums and averages add up the sums of the chunks, which rounds
+/// differently, so they may differ from those of one thread in the last
+/// bits.
+class GroupBy {
+public:
+    GroupBy(std::vector<std::size_t> key_columns, std::vector<GroupByAggregate> aggregates);
+
+    /// The number of threads to use. 0 means one per hardware thread. The
+    /// default is 1.
+    void set_threads(unsigned int threadcount) REALM_NOEXCEPT;
+
+    /// Group the rows of \a table into \a result, which must be a table
+    /// without columns.
+    ///
+    /// \throw LogicError with LogicError::illegal_combination if \a result
+    /// has columns, or with LogicError::type_mismatch if a key or aggregate
+    /// column is of an unsupported type.
+    void run(const Table& table, Table& result) const;
+
+    /// Group the rows of \a view, in view order. Detached rows are skipped.
+    void run(const TableViewBase& view, Table& result) const;
+
+    /// Group the rows that match \a query, without materializing them.
+    void run(const Query& query, Table& result) const;
+
+private:
+    enum ValueKind { kind_none, kind_int, kind_bool, kind_datetime, kind_float, kind_double, kind_string };
+
+    // The state of one aggregate of one group
+    struct State {
+        int64_t int_value;
+        double double_value;
+        std::size_t count;
+    };
+
+    // The groups of a range of rows, in order of first appearance
+    struct Partial {
+        std::unordered_map<std::string, std::size_t> index;
+        std::vector<const std::string*> keys;
+        std::vector<std::size_t> first_rows;
+        std::vector<std::size_t> row_counts;
+        std::vector<State> states; // Aggregates of group `g` start at `g * num_aggregates`
+    };
+
+    struct Resolved {
+        std::vector<ValueKind> key_kinds;
+        std::vector<bool> key_nullable;
+        std::vector<ValueKind> aggr_kinds;
+        std::vector<bool> aggr_nullable;
+    };
+
+    // How the rows of a run are split into chunks, and over how many threads
+    struct Plan {
+        unsigned int threads;
+        std::size_t chunk_size;
+        std::size_t num_chunks;
+    };
+
+    std::vector<std::size_t> m_key_columns;
+    std::vector<GroupByAggregate> m_aggregates;
+    unsigned int m_threads = 1;
+
+    static ValueKind get_kind(DataType);
+    Resolved resolve(const Table&, Table& result) const;
+    unsigned int get_threads() const REALM_NOEXCEPT;
+
+    void add_row(const Table&, const Resolved&, std::size_t row_ndx, Partial&, std::string& key) const;
+    void merge(Partial& into, const Partial& from) const;
+    void write_result(const Table&, const Resolved&, const Partial&, Table& result) const;
+
+    Plan make_plan(std::size_t num_rows) const REALM_NOEXCEPT;
+
+    // Calls add_range(thread_ndx, begin, end, partial) for every chunk of the
+    // plan, and merges the partial results into `total` in row order
+    template<class F> void run_ranges(const Plan&, std::size_t num_rows, Partial& total, F add_range) const;
+
+    // Calls func(thread_ndx, chunk_ndx) for every chunk, on up to `threads`
+    // threads, of which the calling thread is the first. The first exception
+    // thrown by func() stops the other threads at their next chunk, and is
+    // rethrown once all threads have finished.
+    template<class F> static void run_chunks(std::size_t num_chunks, unsigned int threads, F func);
+};
+
+
+
+
+// Implementation:
+
+inline GroupBy::GroupBy(std::vector<std::size_t> key_columns, std::vector<GroupByAggregate> aggregates):
+    m_key_columns(std::move(key_columns)),
+    m_aggregates(std::move(aggregates))
+{
+}
+
+inline void GroupBy::set_threads(unsigned int threadcount) REALM_NOEXCEPT
+{
+    m_threads = threadcount;
+}
+
+inline unsigned int GroupBy::get_threads() const REALM_NOEXCEPT
+{
+    return m_threads == 0 ? std::max(1u, std::thread::hardware_concurrency()) : m_threads;
+}
+
+inline GroupBy::ValueKind GroupBy::get_kind(DataType type)
+{
+    switch (type) {
+        case type_Int:      return kind_int;
+        case type_Bool:     return kind_bool;
+        case type_DateTime: return kind_datetime;
+        case type_Float:    return kind_float;
+        case type_Double:   return kind_double;
+        case type_String:   return kind_string;
+        default:            return kind_none;
+    }
+}
+
+inline GroupBy::Resolved GroupBy::resolve(const Table& table, Table& result) const
+{
+    if (result.get_column_count() != 0)
+        throw LogicError(LogicError::illegal_combination);
+    // Check all columns before the result is touched
+    for (std::size_t col_ndx : m_key_columns) {
+        if (get_kind(table.get_column_type(col_ndx)) == kind_none)
+            throw LogicError(LogicError::type_mismatch);
+    }
+    for (const GroupByAggregate& aggr : m_aggregates) {
+        if (aggr.op == Table::aggr_count)
+            continue;
+        ValueKind kind = get_kind(table.get_column_type(aggr.column_ndx));
+        if (kind == kind_none || kind == kind_string)
+            throw LogicError(LogicError::type_mismatch);
+    }
+
+    Resolved resolved;
+    for (std::size_t col_ndx : m_key_columns) {
+        DataType type = table.get_column_type(col_ndx);
+        ValueKind kind = get_kind(type);
+        bool nullable = table.is_nullable(col_ndx);
+        resolved.key_kinds.push_back(kind);
+        resolved.key_nullable.push_back(nullable);
+        result.add_column(type, table.get_column_name(col_ndx), nullable); // Throws
+    }
+
+    for (const GroupByAggregate& aggr : m_aggregates) {
+        if (aggr.op == Table::aggr_count) {
+            resolved.aggr_kinds.push_back(kind_none);
+            resolved.aggr_nullable.push_back(false);
+            result.add_column(type_Int, "count"); // Throws
+            continue;
+        }
+        DataType type = table.get_column_type(aggr.column_ndx);
+        ValueKind kind = get_kind(type);
+        resolved.aggr_kinds.push_back(kind);
+        resolved.aggr_nullable.push_back(table.is_nullable(aggr.column_ndx));
+
+        bool floating = kind == kind_float || kind == kind_double;
+        DataType result_type = type;
+        std::string name;
+        switch (aggr.op) {
+            case Table::aggr_sum:
+                name = "sum_";
+                result_type = floating ? type_Double : type_Int;
+                break;
+            case Table::aggr_avg:
+                name = "avg_";
+                result_type = type_Double;
+                break;
+            case Table::aggr_min:
+                name = "min_";
+                break;
+            case Table::aggr_max:
+                name = "max_";
+                break;
+            case Table::aggr_count:
+                break;
+        }
+        name += table.get_column_name(aggr.column_ndx);
+        result.add_column(result_type, name); // Throws
+    }
+    return resolved;
+}
+
+inline void GroupBy::add_row(const Table& table, const Resolved& resolved, std::size_t row_ndx,
+                             Partial& partial, std::string& key) const
+{
+    // Encode the key values into bytes, with a null marker for nullable
+    // columns and a length prefix for strings, so that distinct keys never
+    // encode alike
+    key.clear();
+    for (std::size_t k = 0; k < m_key_columns.size(); ++k) {
+        std::size_t col_ndx = m_key_columns[k];
+        if (resolved.key_nullable[k]) {
+            bool null = table.is_null(col_ndx, row_ndx);
+            key += char(null);
+            if (null)
+                continue;
+        }
+        int64_t bits = 0;
+        switch (resolved.key_kinds[k]) {
+            case kind_int:
+                bits = table.get_int(col_ndx, row_ndx);
+                break;
+            case kind_bool:
+                bits = table.get_bool(col_ndx, row_ndx);
+                break;
+            case kind_datetime:
+                bits = int64_t(table.get_datetime(col_ndx, row_ndx).get_datetime());
+                break;
+            case kind_float:
+            case kind_double: {
+                double value = resolved.key_kinds[k] == kind_float ? table.get_float(col_ndx, row_ndx) :
+                    table.get_double(col_ndx, row_ndx);
+                if (value == 0)
+                    value = 0; // -0.0 groups with 0.0
+                std::memcpy(&bits, &value, sizeof bits);
+                break;
+            }
+            case kind_string: {
+                StringData value = table.get_string(col_ndx, row_ndx);
+                key += char(value.is_null());
+                uint64_t size = value.size();
+                key.append(reinterpret_cast<const char*>(&size), sizeof size); // Throws
+                key.append(value.data(), value.size()); // Throws
+                continue;
+            }
+            case kind_none:
+                break;
+        }
+        key.append(reinterpret_cast<const char*>(&bits), sizeof bits); // Throws
+    }
+
+    std::size_t num_aggregates = m_aggregates.size();
+    auto res = partial.index.insert(std::make_pair(key, partial.keys.size())); // Throws
+    std::size_t group = res.first->second;
+    if (res.second) {
+        partial.keys.push_back(&res.first->first); // Throws
+        partial.first_rows.push_back(row_ndx); // Throws
+        partial.row_counts.push_back(0); // Throws
+        partial.states.resize(partial.states.size() + num_aggregates, State{0, 0, 0}); // Throws
+    }
+    ++partial.row_counts[group];
+
+    State* states = &partial.states[group * num_aggregates];
+    for (std::size_t a = 0; a < num_aggregates; ++a) {
+        ValueKind kind = resolved.aggr_kinds[a];
+        if (kind == kind_none)
+            continue;
+        std::size_t col_ndx = m_aggregates[a].column_ndx;
+        if (resolved.aggr_nullable[a] && table.is_null(col_ndx, row_ndx))
+            continue;
+
+        State& state = states[a];
+        Table::AggrType op = m_aggregates[a].op;
+        if (kind == kind_float || kind == kind_double) {
+            double value = kind == kind_float ? table.get_float(col_ndx, row_ndx) :
+                table.get_double(col_ndx, row_ndx);
+            if (op == Table::aggr_sum || op == Table::aggr_avg)
+                state.double_value += value;
+            else if (state.count == 0 || (op == Table::aggr_min ? value < state.double_value :
+                                                                  value > state.double_value))
+                state.double_value = value;
+        }
+        else {
+            int64_t value;
+            if (kind == kind_bool)
+                value = table.get_bool(col_ndx, row_ndx);
+            else if (kind == kind_datetime)
+                value = int64_t(table.get_datetime(col_ndx, row_ndx).get_datetime());
+            else
+                value = table.get_int(col_ndx, row_ndx);
+            if (op == Table::aggr_sum || op == Table::aggr_avg)
+                state.int_value += value;
+            else if (state.count == 0 || (op == Table::aggr_min ? value < state.int_value :
+                                                                  value > state.int_value))
+                state.int_value = value;
+        }
+        ++state.count;
+    }
+}
+
+inline void GroupBy::merge(Partial& into, const Partial& from) const
+{
+    std::size_t num_aggregates = m_aggregates.size();
+    for (std::size_t g = 0; g < from.keys.size(); ++g) {
+        auto res = into.index.insert(std::make_pair(*from.keys[g], into.keys.size())); // Throws
+        std::size_t group = res.first->second;
+        if (res.second) {
+            into.keys.push_back(&res.first->first); // Throws
+            into.first_rows.push_back(from.first_rows[g]); // Throws
+            into.row_counts.push_back(0); // Throws
+            into.states.resize(into.states.size() + num_aggregates, State{0, 0, 0}); // Throws
+        }
+        into.row_counts[group] += from.row_counts[g];
+
+        for (std::size_t a = 0; a < num_aggregates; ++a) {
+            const State& source = from.states[g * num_aggregates + a];
+            State& target = into.states[group * num_aggregates + a];
+            if (source.count == 0)
+                continue;
+            Table::AggrType op = m_aggregates[a].op;
+            if (op == Table::aggr_sum || op == Table::aggr_avg || target.count == 0) {
+                bool first = target.count == 0;
+                target.int_value = first ? source.int_value : target.int_value + source.int_value;
+                target.double_value = first ? source.double_value : target.double_value + source.double_value;
+            }
+            else if (op == Table::aggr_min) {
+                target.int_value = std::min(target.int_value, source.int_value);
+                target.double_value = std::min(target.double_value, source.double_value);
+            }
+            else {
+                target.int_value = std::max(target.int_value, source.int_value);
+                target.double_value = std::max(target.double_value, source.double_value);
+            }
+            target.count += source.count;
+        }
+    }
+}
+
+inline void GroupBy::write_result(const Table& table, const Resolved& resolved, const Partial& partial,
+                                  Table& result) const
+{
+    std::size_t num_groups = partial.keys.size();
+    std::size_t num_keys = m_key_columns.size();
+    std::size_t num_aggregates = m_aggregates.size();
+    result.add_empty_row(num_groups); // Throws
+
+    for (std::size_t g = 0; g < num_groups; ++g) {
+        // The key values are taken from the first row of the group
+        std::size_t row_ndx = partial.first_rows[g];
+        for (std::size_t k = 0; k < num_keys; ++k) {
+            std::size_t col_ndx = m_key_columns[k];
+            if (resolved.key_nullable[k] && table.is_null(col_ndx, row_ndx)) {
+                result.set_null(k, g); // Throws
+                continue;
+            }
+            switch (resolved.key_kinds[k]) {
+                case kind_int:
+                    result.set_int(k, g, table.get_int(col_ndx, row_ndx)); // Throws
+                    break;
+                case kind_bool:
+                    result.set_bool(k, g, table.get_bool(col_ndx, row_ndx)); // Throws
+                    break;
+                case kind_datetime:
+                    result.set_datetime(k, g, table.get_datetime(col_ndx, row_ndx)); // Throws
+                    break;
+                case kind_float:
+                    result.set_float(k, g, table.get_float(col_ndx, row_ndx)); // Throws
+                    break;
+                case kind_double:
+                    result.set_double(k, g, table.get_double(col_ndx, row_ndx)); // Throws
+                    break;
+                case kind_string:
+                    result.set_string(k, g, table.get_string(col_ndx, row_ndx)); // Throws
+                    break;
+                case kind_none:
+                    break;
+            }
+        }
+
+        for (std::size_t a = 0; a < num_aggregates; ++a) {
+            std::size_t result_col = num_keys + a;
+            const State& state = partial.states[g * num_aggregates + a];
+            ValueKind kind = resolved.aggr_kinds[a];
+            Table::AggrType op = m_aggregates[a].op;
+            bool floating = kind == kind_float || kind == kind_double;
+            if (op == Table::aggr_count) {
+                result.set_int(result_col, g, int64_t(partial.row_counts[g])); // Throws
+            }
+            else if (op == Table::aggr_avg) {
+                double sum = floating ? state.double_value : double(state.int_value);
+                result.set_double(result_col, g, state.count == 0 ? 0 : sum / state.count); // Throws
+            }
+            else if (op == Table::aggr_sum && floating) {
+                result.set_double(result_col, g, state.double_value); // Throws
+            }
+            else if (kind == kind_float) {
+                result.set_float(result_col, g, float(state.double_value)); // Throws
+            }
+            else if (kind == kind_double) {
+                result.set_double(result_col, g, state.double_value); // Throws
+            }
+            else if (kind == kind_datetime && op != Table::aggr_sum) {
+                result.set_datetime(result_col, g, DateTime(std::time_t(state.int_value))); // Throws
+            }
+            else if (kind == kind_bool && op != Table::aggr_sum) {
+                result.set_bool(result_col, g, state.int_value != 0); // Throws
+            }
+            else {
+                result.set_int(result_col, g, state.int_value); // Throws
+            }
+        }
+    }
+}
+
+template<class F>
+void GroupBy::run_chunks(std::size_t num_chunks, unsigned int threads, F func)
+{
+    std::atomic<std::size_t> next_chunk(0);
+    std::exception_ptr error;
+    util::Mutex error_mutex;
+    auto worker = [&](unsigned int thread_ndx) {
+        try {
+            for (;;) {
+                std::size_t c = next_chunk++;
+                if (c >= num_chunks)
+                    return;
+                func(thread_ndx, c); // Throws
+            }
+        }
+        catch (...) {
+            util::LockGuard lock(error_mutex);
+            if (!error)
+                error = std::current_exception();
+            next_chunk = num_chunks;
+        }
+    };
+
+    // Joins the threads that were started, also when starting one of them
+    // throws
+    struct Joiner {
+        util::Thread* threads;
+        unsigned int num_started;
+        ~Joiner() REALM_NOEXCEPT
+        {
+            for (unsigned int t = 0; t < num_started; ++t)
+                threads[t].join();
+        }
+    };
+
+    std::unique_ptr<util::Thread[]> workers(new util::Thread[threads - 1]);
+    {
+        Joiner joiner = { workers.get(), 0 };
+        try {
+            for (unsigned int t = 1; t < threads; ++t) {
+                workers[t - 1].start([&worker, t] { worker(t); }); // Throws
+                ++joiner.num_started;
+            }
+        }
+        catch (...) {
+            next_chunk = num_chunks;
+            throw;
+        }
+        worker(0);
+    }
+    if (error)
+        std::rethrow_exception(error);
+}
+
+inline GroupBy::Plan GroupBy::make_plan(std::size_t num_rows) const REALM_NOEXCEPT
+{
+    // Several chunks per thread, of whole leaves, like Query::split_multi()
+    const std::size_t leaf_size = REALM_MAX_BPNODE_SIZE;
+    const std::size_t chunks_per_thread = 8;
+    unsigned int threads = get_threads();
+    std::size_t leaves = (num_rows + leaf_size - 1) / leaf_size;
+
+    Plan plan;
+    plan.chunk_size = std::max<std::size_t>(1, leaves / (threads * chunks_per_thread)) * leaf_size;
+    plan.num_chunks = (num_rows + plan.chunk_size - 1) / plan.chunk_size;
+    plan.threads = unsigned(std::max<std::size_t>(1, std::min<std::size_t>(threads, plan.num_chunks)));
+    return plan;
+}
+
+template<class F>
+void GroupBy::run_ranges(const Plan& plan, std::size_t num_rows, Partial& total, F add_range) const
+{
+    if (plan.threads <= 1) {
+        add_range(0, 0, num_rows, total); // Throws
+        return;
+    }
+
+    std::vector<Partial> partials(plan.num_chunks);
+    run_chunks(plan.num_chunks, plan.threads, [&](unsigned int t, std::size_t c) {
+        std::size_t begin = c * plan.chunk_size;
+        std::size_t end = std::min(num_rows, begin + plan.chunk_size);
+        add_range(t, begin, end, partials[c]); // Throws
+    }); // Throws
+    for (const Partial& partial : partials)
+        merge(total, partial); // Throws
+}
+
+inline void GroupBy::run(const Table& table, Table& result) const
+{
+    Resolved resolved = resolve(table, result); // Throws
+    std::size_t num_rows = table.size();
+
+    Partial total;
+    run_ranges(make_plan(num_rows), num_rows, total,
+               [&](unsigned int, std::size_t begin, std::size_t end, Partial& partial) {
+        std::string key;
+        for (std::size_t row_ndx = begin; row_ndx < end; ++row_ndx)
+            add_row(table, resolved, row_ndx, partial, key); // Throws
+    }); // Throws
+    write_result(table, resolved, total, result); // Throws
+}
+
+inline void GroupBy::run(const TableViewBase& view, Table& result) const
+{
+    const Table& table = *view.m_table;
+    Resolved resolved = resolve(table, result); // Throws
+    std::size_t num_rows = view.size();
+
+    Partial total;
+    run_ranges(make_plan(num_rows), num_rows, total,
+               [&](unsigned int, std::size_t begin, std::size_t end, Partial& partial) {
+        std::string key;
+        for (std::size_t i = begin; i < end; ++i) {
+            std::size_t row_ndx = view.get_source_ndx(i);
+            if (row_ndx != detached_ref)
+                add_row(table, resolved, row_ndx, partial, key); // Throws
+        }
+    }); // Throws
+    write_result(table, resolved, total, result); // Throws
+}
+
+inline void GroupBy::run(const Query& query, Table& result) const
+{
+    // The rows of a restricting view are not in table order
+    if (query.m_view) {
+        ConstTableView view = query.find_all(); // Throws
+        run(view, result); // Throws
+        return;
+    }
+
+    const Table& table = *query.m_table;
+    Resolved resolved = resolve(table, result); // Throws
+    std::size_t num_rows = table.size();
+    Plan plan = make_plan(num_rows);
+
+    // With more than one thread, each thread searches with its own copy of
+    // the node tree, made up front, like in Query::execute_multi()
+    std::vector<std::unique_ptr<Query>> copies;
+    std::vector<const Query*> queries;
+    if (plan.threads <= 1) {
+        queries.push_back(&query); // Throws
+    }
+    else {
+        for (unsigned int t = 0; t < plan.threads; ++t) {
+            copies.emplace_back(new Query(query, Query::TCopyExpressionTag())); // Throws
+            queries.push_back(copies.back().get()); // Throws
+        }
+    }
+    for (const Query* q : queries)
+        q->Init(table);
+
+    Partial total;
+    run_ranges(plan, num_rows, total,
+               [&](unsigned int t, std::size_t begin, std::size_t end, Partial& partial) {
+        const Query& q = *queries[t];
+        std::string key;
+        for (std::size_t row_ndx = begin; row_ndx < end; ++row_ndx) {
+            row_ndx = q.FindInternal(row_ndx, end);
+            if (row_ndx == not_found)
+                break;
+            add_row(table, resolved, row_ndx, partial, key); // Throws
+        }
+    }); // Throws
+    write_result(table, resolved, total, result); // Throws
+}
+
+inline void Table::group_by(const GroupBy& group_by, Table& result) const
+{
+    group_by.run(*this, result); // Throws
+}
+
+inline void TableViewBase::group_by(const GroupBy& group_by, Table& result) const
+{
+    group_by.run(*this, result); // Throws
+}
+
+inline void Query::group_by(const GroupBy& group_by, Table& result) const
+{
+    group_by.run(*this, result); // Throws
+}
+
+} // namespace realm
+
+#endif // REALM_GROUP_BY_HPP
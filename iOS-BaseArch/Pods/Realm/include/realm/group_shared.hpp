@@ -20,7 +20,9 @@
 #ifndef REALM_GROUP_SHARED_HPP
 #define REALM_GROUP_SHARED_HPP
 
+#include <atomic>
 #include <limits>
+#include <vector>
 
 #include <realm/util/features.h>
 #include <realm/util/thread.hpp>
@@ -38,6 +40,8 @@ class SharedGroupFriend;
 class WriteLogCollector;
 }
 
+class AutoEnumerator;
+
 /// Thrown by SharedGroup::open() if the lock file is already open in another
 /// process which can't share mutexes with this process
 struct IncompatibleLockFile: std::runtime_error {
@@ -603,6 +607,47 @@ private:
 };
 
 
+namespace _impl {
+
+/// Functions to be called on the group of a write transaction just before it
+/// is committed by WriteTransaction::commit() or
+/// LangBindHelper::commit_and_continue_as_read(), registered per
+/// SharedGroup. A commit made by calling SharedGroup::commit() directly does
+/// not run them. See AutoEnumerator::attach().
+class PreCommitHooks {
+public:
+    typedef void (*func_type)(void* data, Group&);
+
+    static void add(const SharedGroup&, func_type, void* data);
+    static void remove(const SharedGroup&, void* data) REALM_NOEXCEPT;
+
+    /// Run the functions registered for \a sg.
+    static void run(const SharedGroup& sg, Group&);
+
+private:
+    struct Hook {
+        const SharedGroup* shared_group;
+        func_type func;
+        void* data;
+    };
+
+    struct Registry {
+        util::Mutex mutex;
+        std::vector<Hook> hooks;
+        std::atomic<std::size_t> size;
+        Registry(): size(0) {}
+    };
+
+    static Registry& get_registry()
+    {
+        static Registry registry;
+        return registry;
+    }
+};
+
+} // namespace _impl
+
+
 
 class ReadTransaction {
 public:
@@ -704,11 +749,17 @@ public:
     SharedGroup::version_type commit()
     {
         REALM_ASSERT(m_shared_group);
+        _impl::PreCommitHooks::run(*m_shared_group, get_group()); // Throws
         SharedGroup::version_type new_version = m_shared_group->commit();
         m_shared_group = nullptr;
         return new_version;
     }
 
+    /// Like commit(), but first lets \a enumerator enumerate the string
+    /// columns that have become low-cardinality. Defined in
+    /// auto_enumerate.hpp.
+    SharedGroup::version_type commit(AutoEnumerator& enumerator);
+
     void rollback() REALM_NOEXCEPT
     {
         REALM_ASSERT(m_shared_group);
@@ -1036,6 +1087,50 @@ public:
     }
 };
 
+inline void _impl::PreCommitHooks::add(const SharedGroup& sg, func_type func, void* data)
+{
+    Registry& registry = get_registry();
+    util::LockGuard lock(registry.mutex);
+    Hook hook = { &sg, func, data };
+    registry.hooks.push_back(hook); // Throws
+    registry.size = registry.hooks.size();
+}
+
+inline void _impl::PreCommitHooks::remove(const SharedGroup& sg, void* data) REALM_NOEXCEPT
+{
+    Registry& registry = get_registry();
+    util::LockGuard lock(registry.mutex);
+    std::vector<Hook>& hooks = registry.hooks;
+    for (std::size_t i = 0; i < hooks.size(); ++i) {
+        if (hooks[i].shared_group == &sg && hooks[i].data == data) {
+            hooks.erase(hooks.begin() + i);
+            break;
+        }
+    }
+    registry.size = hooks.size();
+}
+
+inline void _impl::PreCommitHooks::run(const SharedGroup& sg, Group& group)
+{
+    // Most processes register nothing, and then no lock is taken
+    Registry& registry = get_registry();
+    if (registry.size == 0)
+        return;
+
+    // The functions are called without holding the lock, so that they do not
+    // hold up the commits of other shared groups
+    std::vector<Hook> hooks;
+    {
+        util::LockGuard lock(registry.mutex);
+        for (const Hook& hook : registry.hooks) {
+            if (hook.shared_group == &sg)
+                hooks.push_back(hook); // Throws
+        }
+    }
+    for (const Hook& hook : hooks)
+        (*hook.func)(hook.data, group); // Throws
+}
+
 inline const Group& ReadTransaction::get_group() const REALM_NOEXCEPT
 {
     using sgf = _impl::SharedGroupFriend;
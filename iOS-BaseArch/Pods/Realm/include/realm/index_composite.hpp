@@ -0,0 +1,719 @@
+/*************************************************************************
+ *
+ * REALM CONFIDENTIAL
+ * __________________
+ *
+ *  [2011] - [2015] Realm Inc
+ *  All Rights Reserved.
+ *
+ * NOTICE:  All information contained herein is, and remains
+ * the property of Realm Incorporated and its suppliers,
+ * if any.  The intellectual and technical concepts contained
+ * herein are proprietary to Realm Incorporated
+ * and its suppliers and may be covered by U.S. and Foreign Patents,
+ * patents in process, and are protected by trade secret or copyright law.
+ * Dissemination of this information or reproduction of this material
+ * is strictly forbidden unless prior written permission is obtained
+ * from Realm Incorporated.
+ *
+ **************************************************************************/
+#ifndef REALM_INDEX_COMPOSITE_HPP
+#define REALM_INDEX_COMPOSITE_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include <realm/mixed.hpp>
+#include <realm/column.hpp>
+#include <realm/table.hpp>
+#include <realm/table_view.hpp>
+#include <realm/query_engine.hpp>
+#include <realm/index_snapshot.hpp>
+
+namespace realm {
+
+/// Index over a tuple of columns, such as (owner_id, created_at).
+///
+/// The rows are kept in lexicographic order of their tuples, with ties in row
+/// order, as a bit-packed B+-tree of row indexes. Rows that agree on a prefix
+/// of the tuple are therefore adjacent and ordered by the remaining columns,
+/// so "rows of owner X" and "rows of owner X created between A and B" are a
+/// binary search each, and the matches come out ordered by time.
+///
+/// Integer, bool, DateTime, float, double and string columns can be part of
+/// the tuple. Lookup values are given as Mixed, and must have the type of
+/// their column. NaN sorts after all other float and double values, and is
+/// never matched by a prefix or a range.
+///
+/// The index is an in-memory snapshot helper, see IndexSnapshot.
+class CompositeIndex {
+public:
+    /// A tuple of column values. It holds its own copy of string values, so
+    /// that it stays valid when the row it was read from changes.
+    class Key {
+    public:
+        Key() {}
+        Key(const Key&);
+        Key& operator=(const Key&);
+
+        void add(Mixed value);
+        std::size_t size() const REALM_NOEXCEPT;
+        const Mixed& operator[](std::size_t ndx) const REALM_NOEXCEPT;
+
+    private:
+        std::vector<Mixed> m_values;
+        std::vector<std::unique_ptr<char[]>> m_strings;
+    };
+
+    /// One end of a range on the column that follows the prefix.
+    struct Bound {
+        Mixed value;
+        bool is_set;
+        bool is_inclusive;
+    };
+
+    CompositeIndex(const Table& table, std::vector<std::size_t> column_ndxs);
+    ~CompositeIndex() REALM_NOEXCEPT;
+
+    const Table& get_table() const REALM_NOEXCEPT;
+    const std::vector<std::size_t>& get_column_indexes() const REALM_NOEXCEPT;
+
+    /// Rebuild the index unless it is current, see IndexSnapshot.
+    void sync_if_needed();
+    void rebuild();
+
+    /// The tuple of \a row_ndx. Hooks that need the tuple a row held before
+    /// a change take a key read with this function before the change.
+    Key get_key(std::size_t row_ndx) const;
+
+    //@{
+    /// Incremental maintenance. Each function must be called after the
+    /// corresponding change has been made to the table. \a key is the tuple
+    /// that the row held before the change.
+    void insert(std::size_t row_ndx, std::size_t num_rows, bool is_append);
+    void set(std::size_t row_ndx, const Key& old_key);
+    void erase(std::size_t row_ndx, const Key& key, bool is_last);
+    void move_last_over(std::size_t row_ndx, std::size_t last_row_ndx, const Key& key, const Key& last_key);
+    void clear();
+    //@}
+
+    /// Number of entries, which is the number of rows in the table.
+    std::size_t size() const REALM_NOEXCEPT;
+
+    /// The row at position \a ndx in tuple order.
+    std::size_t get_row(std::size_t ndx) const REALM_NOEXCEPT;
+
+    /// Position of the first entry whose tuple equals that of the entry at
+    /// position \a ndx.
+    std::size_t find_run_begin(std::size_t ndx) const;
+
+    /// Find the positions [\a begin, \a end) of the entries whose leading
+    /// columns equal \a prefix and, where bounds are set, whose next column
+    /// lies between \a lower and \a upper. NaN values select nothing, and
+    /// NaN entries are never within a bound.
+    void find_range(const Key& prefix, const Bound& lower, const Bound& upper, std::size_t& begin,
+                    std::size_t& end) const;
+
+    /// Write to \a rows, in ascending order, the rows at positions [begin,
+    /// end) of the index.
+    void get_rows(std::size_t begin, std::size_t end, std::vector<std::size_t>& rows) const;
+
+    /// Throw LogicError::type_mismatch unless \a prefix followed by \a
+    /// num_extra more values fits the columns of the index and its values
+    /// have the types of their columns.
+    void check_key(const Key& prefix, std::size_t num_extra) const;
+
+private:
+    // While a hook runs, the entries still describe the table as it was
+    // before the change. This says how to read their tuples from the table
+    // as it is now.
+    struct Before {
+        std::size_t row = npos;         // Entry whose tuple was `key`
+        const Key* key = nullptr;
+        std::size_t row_2 = npos;       // Entry whose tuple was `key_2`
+        const Key* key_2 = nullptr;
+        std::size_t erased_row = npos;  // Entries above it moved down by one
+    };
+
+    Mixed get_value(std::size_t column, std::size_t row_ndx) const REALM_NOEXCEPT;
+    static int compare(DataType type, const Mixed& a, const Mixed& b) REALM_NOEXCEPT;
+    template<class T> static int compare_floats(T a, T b) REALM_NOEXCEPT;
+    static bool is_nan(const Mixed&) REALM_NOEXCEPT;
+
+    // Compare the first `key_size` columns of the entry for `row_ndx` with
+    // `key`
+    int compare(std::size_t row_ndx, const Key& key, std::size_t key_size, const Before&) const REALM_NOEXCEPT;
+
+    // Position of the first entry whose leading columns compare greater
+    // than (`after_equal`) or not less than `key`
+    std::size_t partition(const Key& key, bool after_equal) const;
+
+    // Position of the first entry that is not less than (key, row_ndx)
+    std::size_t find_position(const Key& key, std::size_t row_ndx, const Before&) const;
+    void insert_entry(std::size_t row_ndx);
+    void erase_entry(std::size_t row_ndx, const Key& key, const Before&);
+
+    ConstTableRef m_table;
+    std::vector<std::size_t> m_column_ndxs;
+    std::vector<DataType> m_column_types;
+    Column m_rows;
+    IndexSnapshot m_snapshot;
+};
+
+
+/// Query condition on a prefix of the columns of a CompositeIndex, optionally
+/// with a range on the column that follows.
+class CompositeIndexNode: public IndexRowsNode {
+public:
+    CompositeIndexNode(CompositeIndex& index, const CompositeIndex::Key& prefix,
+                       const CompositeIndex::Bound& lower, const CompositeIndex::Bound& upper):
+        IndexRowsNode(index.get_column_indexes()[0]),
+        m_index(&index), m_prefix(prefix), m_lower(lower), m_upper(upper)
+    {
+        // Bound values may be strings owned by the caller
+        if (m_lower.is_set)
+            m_bounds.add(m_lower.value);
+        if (m_upper.is_set)
+            m_bounds.add(m_upper.value);
+    }
+    ~CompositeIndexNode() REALM_NOEXCEPT override {}
+
+    ParentNode* clone() override
+    {
+        return new CompositeIndexNode(*this);
+    }
+
+    CompositeIndexNode(const CompositeIndexNode& from)
+        : IndexRowsNode(from)
+    {
+        m_index = from.m_index;
+        m_prefix = from.m_prefix;
+        m_bounds = from.m_bounds;
+        m_lower = from.m_lower;
+        m_upper = from.m_upper;
+    }
+
+protected:
+    void find_rows(const Table&, std::vector<size_t>& rows) override
+    {
+        m_index->sync_if_needed();
+
+        std::size_t bound_ndx = 0;
+        if (m_lower.is_set)
+            m_lower.value = m_bounds[bound_ndx++];
+        if (m_upper.is_set)
+            m_upper.value = m_bounds[bound_ndx++];
+
+        size_t begin, end;
+        m_index->find_range(m_prefix, m_lower, m_upper, begin, end);
+        m_index->get_rows(begin, end, rows);
+    }
+
+private:
+    CompositeIndex* m_index;
+    CompositeIndex::Key m_prefix;
+    CompositeIndex::Key m_bounds;
+    CompositeIndex::Bound m_lower;
+    CompositeIndex::Bound m_upper;
+};
+
+
+
+// Implementation:
+
+inline CompositeIndex::Key::Key(const Key& key)
+{
+    for (std::size_t i = 0; i < key.size(); ++i)
+        add(key[i]); // Throws
+}
+
+inline CompositeIndex::Key& CompositeIndex::Key::operator=(const Key& key)
+{
+    if (&key != this) {
+        Key copy(key); // Throws
+        m_values.swap(copy.m_values);
+        m_strings.swap(copy.m_strings);
+    }
+    return *this;
+}
+
+inline void CompositeIndex::Key::add(Mixed value)
+{
+    if (value.get_type() == type_String) {
+        StringData str = value.get_string();
+        if (!str.is_null()) {
+            std::unique_ptr<char[]> copy(new char[str.size() + 1]); // Throws
+            std::memcpy(copy.get(), str.data(), str.size());
+            value = StringData(copy.get(), str.size());
+            m_strings.push_back(std::move(copy)); // Throws
+        }
+    }
+    m_values.push_back(value); // Throws
+}
+
+inline std::size_t CompositeIndex::Key::size() const REALM_NOEXCEPT
+{
+    return m_values.size();
+}
+
+inline const Mixed& CompositeIndex::Key::operator[](std::size_t ndx) const REALM_NOEXCEPT
+{
+    return m_values[ndx];
+}
+
+inline CompositeIndex::CompositeIndex(const Table& table, std::vector<std::size_t> column_ndxs):
+    m_table(table.get_table_ref()),
+    m_column_ndxs(std::move(column_ndxs)),
+    m_rows(Allocator::get_default(), Column::create(Allocator::get_default())) // Throws
+{
+    bool valid = !m_column_ndxs.empty();
+    for (std::size_t i = 0; i < m_column_ndxs.size(); ++i) {
+        DataType type = table.get_column_type(m_column_ndxs[i]);
+        valid &= type == type_Int || type == type_Bool || type == type_DateTime || type == type_Float ||
+                 type == type_Double || type == type_String;
+        m_column_types.push_back(type);
+    }
+    if (!valid) {
+        m_rows.destroy();
+        throw LogicError(LogicError::type_mismatch);
+    }
+    rebuild(); // Throws
+}
+
+inline CompositeIndex::~CompositeIndex() REALM_NOEXCEPT
+{
+    m_rows.destroy();
+}
+
+inline const Table& CompositeIndex::get_table() const REALM_NOEXCEPT
+{
+    return *m_table;
+}
+
+inline const std::vector<std::size_t>& CompositeIndex::get_column_indexes() const REALM_NOEXCEPT
+{
+    return m_column_ndxs;
+}
+
+inline std::size_t CompositeIndex::size() const REALM_NOEXCEPT
+{
+    return m_rows.size();
+}
+
+inline std::size_t CompositeIndex::get_row(std::size_t ndx) const REALM_NOEXCEPT
+{
+    return to_size_t(m_rows.get(ndx));
+}
+
+inline Mixed CompositeIndex::get_value(std::size_t column, std::size_t row_ndx) const REALM_NOEXCEPT
+{
+    std::size_t col_ndx = m_column_ndxs[column];
+    switch (m_column_types[column]) {
+        case type_Int:
+            return Mixed(m_table->get_int(col_ndx, row_ndx));
+        case type_Bool:
+            return Mixed(m_table->get_bool(col_ndx, row_ndx));
+        case type_DateTime:
+            return Mixed(m_table->get_datetime(col_ndx, row_ndx));
+        case type_Float:
+            return Mixed(m_table->get_float(col_ndx, row_ndx));
+        case type_Double:
+            return Mixed(m_table->get_double(col_ndx, row_ndx));
+        case type_String:
+            return Mixed(m_table->get_string(col_ndx, row_ndx));
+        default:
+            REALM_ASSERT(false);
+            return Mixed();
+    }
+}
+
+inline int CompositeIndex::compare(DataType type, const Mixed& a, const Mixed& b) REALM_NOEXCEPT
+{
+    switch (type) {
+        case type_Int:
+            return a.get_int() < b.get_int() ? -1 : b.get_int() < a.get_int() ? 1 : 0;
+        case type_Bool:
+            return int(a.get_bool()) - int(b.get_bool());
+        case type_DateTime:
+            return a.get_datetime() < b.get_datetime() ? -1 : b.get_datetime() < a.get_datetime() ? 1 : 0;
+        case type_Float:
+            return compare_floats(a.get_float(), b.get_float());
+        case type_Double:
+            return compare_floats(a.get_double(), b.get_double());
+        case type_String:
+            return a.get_string() < b.get_string() ? -1 : b.get_string() < a.get_string() ? 1 : 0;
+        default:
+            REALM_ASSERT(false);
+            return 0;
+    }
+}
+
+template<class T> inline int CompositeIndex::compare_floats(T a, T b) REALM_NOEXCEPT
+{
+    // NaN last, so that the order is total
+    if (std::isnan(a))
+        return std::isnan(b) ? 0 : 1;
+    if (std::isnan(b))
+        return -1;
+    return a < b ? -1 : b < a ? 1 : 0;
+}
+
+inline bool CompositeIndex::is_nan(const Mixed& value) REALM_NOEXCEPT
+{
+    switch (value.get_type()) {
+        case type_Float:
+            return std::isnan(value.get_float());
+        case type_Double:
+            return std::isnan(value.get_double());
+        default:
+            return false;
+    }
+}
+
+inline int CompositeIndex::compare(std::size_t row_ndx, const Key& key, std::size_t key_size,
+                                   const Before& before) const REALM_NOEXCEPT
+{
+    const Key* row_key = nullptr;
+    if (row_ndx == before.row)
+        row_key = before.key;
+    else if (row_ndx == before.row_2)
+        row_key = before.key_2;
+    else if (before.erased_row != npos && row_ndx > before.erased_row)
+        --row_ndx;
+
+    for (std::size_t i = 0; i < key_size; ++i) {
+        Mixed value = row_key ? (*row_key)[i] : get_value(i, row_ndx);
+        int c = compare(m_column_types[i], value, key[i]);
+        if (c != 0)
+            return c;
+    }
+    return 0;
+}
+
+inline void CompositeIndex::sync_if_needed()
+{
+    if (!m_snapshot.is_current(*m_table))
+        rebuild(); // Throws
+}
+
+inline void CompositeIndex::rebuild()
+{
+    std::size_t n = m_table->size();
+    std::vector<std::size_t> rows(n);
+    for (std::size_t i = 0; i < n; ++i)
+        rows[i] = i;
+    // Stable, so that ties stay in row order
+    std::size_t num_columns = m_column_ndxs.size();
+    std::stable_sort(rows.begin(), rows.end(), [this, num_columns](std::size_t a, std::size_t b) {
+        for (std::size_t i = 0; i < num_columns; ++i) {
+            int c = compare(m_column_types[i], get_value(i, a), get_value(i, b));
+            if (c != 0)
+                return c < 0;
+        }
+        return false;
+    });
+
+    m_rows.clear(); // Throws
+    for (std::size_t i = 0; i < n; ++i)
+        m_rows.add(int64_t(rows[i])); // Throws
+    m_snapshot.mark_current(*m_table);
+}
+
+inline CompositeIndex::Key CompositeIndex::get_key(std::size_t row_ndx) const
+{
+    Key key;
+    for (std::size_t i = 0; i < m_column_ndxs.size(); ++i)
+        key.add(get_value(i, row_ndx)); // Throws
+    return key;
+}
+
+inline void CompositeIndex::check_key(const Key& prefix, std::size_t num_extra) const
+{
+    if (prefix.size() + num_extra > m_column_types.size())
+        throw LogicError(LogicError::type_mismatch);
+    for (std::size_t i = 0; i < prefix.size(); ++i) {
+        if (prefix[i].get_type() != m_column_types[i])
+            throw LogicError(LogicError::type_mismatch);
+    }
+}
+
+inline std::size_t CompositeIndex::partition(const Key& key, bool after_equal) const
+{
+    Before before;
+    std::size_t begin = 0;
+    std::size_t end = m_rows.size();
+    while (begin < end) {
+        std::size_t mid = begin + (end - begin) / 2;
+        int c = compare(to_size_t(m_rows.get(mid)), key, key.size(), before);
+        if (c < 0 || (c == 0 && after_equal))
+            begin = mid + 1;
+        else
+            end = mid;
+    }
+    return begin;
+}
+
+inline void CompositeIndex::find_range(const Key& prefix, const Bound& lower, const Bound& upper,
+                                       std::size_t& begin, std::size_t& end) const
+{
+    bool has_nan = (lower.is_set && is_nan(lower.value)) || (upper.is_set && is_nan(upper.value));
+    for (std::size_t i = 0; i < prefix.size(); ++i)
+        has_nan |= is_nan(prefix[i]);
+    if (has_nan) {
+        begin = end = 0;
+        return;
+    }
+
+    if (lower.is_set) {
+        Key key = prefix; // Throws
+        key.add(lower.value); // Throws
+        begin = partition(key, !lower.is_inclusive);
+    }
+    else {
+        begin = partition(prefix, false);
+    }
+
+    if (upper.is_set) {
+        Key key = prefix; // Throws
+        key.add(upper.value); // Throws
+        end = partition(key, upper.is_inclusive);
+    }
+    else if (lower.is_set && (m_column_types[prefix.size()] == type_Float ||
+                              m_column_types[prefix.size()] == type_Double)) {
+        // Stop before the NaN entries, which sort last
+        Key key = prefix; // Throws
+        if (m_column_types[prefix.size()] == type_Float)
+            key.add(Mixed(std::numeric_limits<float>::quiet_NaN())); // Throws
+        else
+            key.add(Mixed(std::numeric_limits<double>::quiet_NaN())); // Throws
+        end = partition(key, false);
+    }
+    else {
+        end = partition(prefix, true);
+    }
+    end = std::max(begin, end);
+}
+
+inline std::size_t CompositeIndex::find_run_begin(std::size_t ndx) const
+{
+    return partition(get_key(get_row(ndx)), false); // Throws
+}
+
+inline void CompositeIndex::get_rows(std::size_t begin, std::size_t end, std::vector<std::size_t>& rows) const
+{
+    std::size_t first_new = rows.size();
+    for (std::size_t i = begin; i < end; ++i)
+        rows.push_back(to_size_t(m_rows.get(i)));
+    std::sort(rows.begin() + first_new, rows.end());
+}
+
+inline std::size_t CompositeIndex::find_position(const Key& key, std::size_t row_ndx, const Before& before) const
+{
+    std::size_t begin = 0;
+    std::size_t end = m_rows.size();
+    while (begin < end) {
+        std::size_t mid = begin + (end - begin) / 2;
+        std::size_t r = to_size_t(m_rows.get(mid));
+        int c = compare(r, key, key.size(), before);
+        if (c < 0 || (c == 0 && r < row_ndx))
+            begin = mid + 1;
+        else
+            end = mid;
+    }
+    return begin;
+}
+
+inline void CompositeIndex::insert_entry(std::size_t row_ndx)
+{
+    std::size_t ndx = find_position(get_key(row_ndx), row_ndx, Before()); // Throws
+    if (ndx == m_rows.size())
+        m_rows.add(int64_t(row_ndx)); // Throws
+    else
+        m_rows.insert(ndx, int64_t(row_ndx)); // Throws
+}
+
+inline void CompositeIndex::erase_entry(std::size_t row_ndx, const Key& key, const Before& before)
+{
+    std::size_t ndx = find_position(key, row_ndx, before);
+    REALM_ASSERT_3(ndx, <, m_rows.size());
+    REALM_ASSERT_3(to_size_t(m_rows.get(ndx)), ==, row_ndx);
+    bool is_last = ndx == m_rows.size() - 1;
+    m_rows.erase(ndx, is_last);
+}
+
+inline void CompositeIndex::insert(std::size_t row_ndx, std::size_t num_rows, bool is_append)
+{
+    // Rows after the inserted ones move up, just like in StringIndex::insert()
+    if (!is_append)
+        m_rows.adjust_ge(int64_t(row_ndx), int64_t(num_rows));
+    for (std::size_t i = 0; i < num_rows; ++i)
+        insert_entry(row_ndx + i); // Throws
+    m_snapshot.mark_current(*m_table);
+}
+
+inline void CompositeIndex::set(std::size_t row_ndx, const Key& old_key)
+{
+    Before before;
+    before.row = row_ndx;
+    before.key = &old_key;
+    erase_entry(row_ndx, old_key, before);
+    insert_entry(row_ndx); // Throws
+    m_snapshot.mark_current(*m_table);
+}
+
+inline void CompositeIndex::erase(std::size_t row_ndx, const Key& key, bool is_last)
+{
+    Before before;
+    before.row = row_ndx;
+    before.key = &key;
+    before.erased_row = row_ndx;
+    erase_entry(row_ndx, key, before);
+    if (!is_last)
+        m_rows.adjust_ge(int64_t(row_ndx + 1), -1);
+    m_snapshot.mark_current(*m_table);
+}
+
+inline void CompositeIndex::move_last_over(std::size_t row_ndx, std::size_t last_row_ndx, const Key& key,
+                                           const Key& last_key)
+{
+    Before before;
+    before.row = row_ndx;
+    before.key = &key;
+    erase_entry(row_ndx, key, before);
+    if (row_ndx != last_row_ndx) {
+        before.row_2 = last_row_ndx;
+        before.key_2 = &last_key;
+        erase_entry(last_row_ndx, last_key, before);
+        insert_entry(row_ndx); // Throws
+    }
+    m_snapshot.mark_current(*m_table);
+}
+
+inline void CompositeIndex::clear()
+{
+    m_rows.clear(); // Throws
+    m_snapshot.mark_current(*m_table);
+}
+
+
+inline Query& Query::equal(CompositeIndex& index, const std::vector<Mixed>& prefix)
+{
+    return add_composite_index_condition(index, prefix, Mixed(), false, false, Mixed(), false, false);
+}
+
+inline Query& Query::greater(CompositeIndex& index, const std::vector<Mixed>& prefix, Mixed value)
+{
+    return add_composite_index_condition(index, prefix, value, true, false, Mixed(), false, false);
+}
+
+inline Query& Query::greater_equal(CompositeIndex& index, const std::vector<Mixed>& prefix, Mixed value)
+{
+    return add_composite_index_condition(index, prefix, value, true, true, Mixed(), false, false);
+}
+
+inline Query& Query::less(CompositeIndex& index, const std::vector<Mixed>& prefix, Mixed value)
+{
+    return add_composite_index_condition(index, prefix, Mixed(), false, false, value, true, false);
+}
+
+inline Query& Query::less_equal(CompositeIndex& index, const std::vector<Mixed>& prefix, Mixed value)
+{
+    return add_composite_index_condition(index, prefix, Mixed(), false, false, value, true, true);
+}
+
+inline Query& Query::between(CompositeIndex& index, const std::vector<Mixed>& prefix, Mixed from, Mixed to)
+{
+    return add_composite_index_condition(index, prefix, from, true, true, to, true, true);
+}
+
+inline Query& Query::add_composite_index_condition(CompositeIndex& index, const std::vector<Mixed>& prefix,
+                                                   Mixed lower, bool has_lower, bool lower_inclusive,
+                                                   Mixed upper, bool has_upper, bool upper_inclusive)
+{
+    if (&index.get_table() != m_table.get())
+        throw LogicError(LogicError::illegal_combination);
+
+    CompositeIndex::Key key;
+    for (std::size_t i = 0; i < prefix.size(); ++i)
+        key.add(prefix[i]); // Throws
+    bool has_range = has_lower || has_upper;
+    index.check_key(key, has_range ? 1 : 0); // Throws
+    if (has_range) {
+        DataType type = m_table->get_column_type(index.get_column_indexes()[prefix.size()]);
+        if ((has_lower && lower.get_type() != type) || (has_upper && upper.get_type() != type))
+            throw LogicError(LogicError::type_mismatch);
+    }
+
+    CompositeIndex::Bound lower_bound = { lower, has_lower, lower_inclusive };
+    CompositeIndex::Bound upper_bound = { upper, has_upper, upper_inclusive };
+    ParentNode* const p = new CompositeIndexNode(index, key, lower_bound, upper_bound);
+    UpdatePointers(p, &p->m_child);
+    return *this;
+}
+
+inline TableView Query::find_all_sorted(CompositeIndex& index, const std::vector<Mixed>& prefix, bool ascending)
+{
+    if (&index.get_table() != m_table.get())
+        throw LogicError(LogicError::illegal_combination);
+
+    CompositeIndex::Key key;
+    for (std::size_t i = 0; i < prefix.size(); ++i)
+        key.add(prefix[i]); // Throws
+    index.check_key(key, 0); // Throws
+
+    index.sync_if_needed();
+    CompositeIndex::Bound none = { Mixed(), false, false };
+    std::size_t begin, end;
+    index.find_range(key, none, none, begin, end);
+
+    // FindInternal() does not know about a restricting view, so its rows are
+    // checked separately
+    std::vector<std::size_t> view_rows;
+    if (m_view) {
+        for (std::size_t i = 0; i < m_view->m_row_indexes.size(); ++i)
+            view_rows.push_back(to_size_t(m_view->m_row_indexes.get(i)));
+        std::sort(view_rows.begin(), view_rows.end());
+    }
+
+    // The view holds this query restricted to the prefix, and the order of
+    // the remaining columns, so that bringing it up to date after the table
+    // changes re-runs the query and sorts the matches
+    Query view_query(*this, Query::TCopyExpressionTag()); // Throws
+    view_query.equal(index, prefix); // Throws
+    TableView tv(*m_table, view_query, 0, size_t(-1), size_t(-1));
+    const std::vector<std::size_t>& column_ndxs = index.get_column_indexes();
+    if (prefix.size() < column_ndxs.size()) {
+        std::vector<std::size_t> sort_columns(column_ndxs.begin() + prefix.size(), column_ndxs.end());
+        std::vector<bool> sort_ascending(sort_columns.size(), ascending);
+        tv.m_sorting_predicate = RowIndexes::Sorter(sort_columns, sort_ascending);
+        tv.m_auto_sort = true;
+    }
+
+    Init(*m_table);
+
+    // Visit the entries of the prefix in index order and keep those that
+    // match, so the view is born ordered by the remaining columns. When
+    // descending, runs of equal tuples are visited from the last one, but
+    // each in row order, which is how a stable sort orders ties.
+    std::size_t run_end = end;
+    while (run_end > begin) {
+        std::size_t run_begin = ascending ? begin : std::max(begin, index.find_run_begin(run_end - 1));
+        for (std::size_t i = run_begin; i < run_end; ++i) {
+            std::size_t r = index.get_row(i);
+            if (m_view && !std::binary_search(view_rows.begin(), view_rows.end(), r))
+                continue;
+            if (FindInternal(r, r + 1) == r)
+                tv.m_row_indexes.add(r);
+        }
+        run_end = run_begin;
+    }
+    return tv;
+}
+
+} // namespace realm
+
+#endif // REALM_INDEX_COMPOSITE_HPP
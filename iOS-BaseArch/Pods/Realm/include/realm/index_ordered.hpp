@@ -0,0 +1,566 @@
+/*************************************************************************
+ *
+ * REALM CONFIDENTIAL
+ * __________________
+ *
+ *  [2011] - [2015] Realm Inc
+ *  All Rights Reserved.
+ *
+ * NOTICE:  All information contained herein is, and remains
+ * the property of Realm Incorporated and its suppliers,
+ * if any.  The intellectual and technical concepts contained
+ * herein are proprietary to Realm Incorporated
+ * and its suppliers and may be covered by U.S. and Foreign Patents,
+ * patents in process, and are protected by trade secret or copyright law.
+ * Dissemination of this information or reproduction of this material
+ * is strictly forbidden unless prior written permission is obtained
+ * from Realm Incorporated.
+ *
+ **************************************************************************/
+#ifndef REALM_INDEX_ORDERED_HPP
+#define REALM_INDEX_ORDERED_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <realm/column.hpp>
+#include <realm/datetime.hpp>
+#include <realm/table.hpp>
+#include <realm/table_view.hpp>
+#include <realm/query_engine.hpp>
+#include <realm/index_snapshot.hpp>
+
+namespace realm {
+
+/// Ordered secondary index over an integer, float, double or DateTime
+/// column. T is the value type of the column: int64_t, float, double or
+/// DateTime.
+///
+/// The index is a B+-tree of row indexes (an integer Column, so it is
+/// bit-packed), kept in ascending order of value, with ties in row order.
+/// Range lookups are binary searches over it, so the Query conditions that
+/// take an OrderedIndex find their rows without scanning the column, and the
+/// rows can be visited in value order without sorting. The conditions that
+/// take a column index, such as Query::greater(column_ndx, value), are built
+/// by the library and know nothing of the index, so they still scan.
+///
+/// NaN sorts after all other values of a float or double column, and is
+/// never within a range, just as it never compares greater or less than a
+/// value in a scanning condition.
+///
+/// The index is an in-memory snapshot helper, see IndexSnapshot.
+template<class T> class OrderedIndex {
+public:
+    typedef T value_type;
+
+    OrderedIndex(const Table& table, std::size_t column_ndx);
+    ~OrderedIndex() REALM_NOEXCEPT;
+
+    const Table& get_table() const REALM_NOEXCEPT;
+    std::size_t get_column_index() const REALM_NOEXCEPT;
+
+    /// Rebuild the index unless it is current, see IndexSnapshot.
+    void sync_if_needed();
+    void rebuild();
+
+    //@{
+    /// Incremental maintenance. Each function must be called after the
+    /// corresponding change has been made to the table. \a value is the
+    /// value that the row held before the change.
+    void insert(std::size_t row_ndx, std::size_t num_rows, bool is_append);
+    void set(std::size_t row_ndx, T old_value);
+    void erase(std::size_t row_ndx, T value, bool is_last);
+    void move_last_over(std::size_t row_ndx, std::size_t last_row_ndx, T value, T last_value);
+    void clear();
+    //@}
+
+    /// Number of entries, which is the number of rows in the table.
+    std::size_t size() const REALM_NOEXCEPT;
+
+    /// The row at position \a ndx in value order.
+    std::size_t get_row(std::size_t ndx) const REALM_NOEXCEPT;
+
+    //@{
+    /// Position of the first entry whose value is not less than
+    /// (lower_bound()), or greater than (upper_bound()), \a value.
+    std::size_t lower_bound(T value) const;
+    std::size_t upper_bound(T value) const;
+    //@}
+
+    /// Position of the first NaN entry, which is size() if there are none.
+    std::size_t nan_begin() const;
+
+    /// Position of the first entry whose value equals that of the entry at
+    /// position \a ndx.
+    std::size_t find_run_begin(std::size_t ndx) const;
+
+    /// Whether \a value is NaN. Always false unless T is float or double.
+    static bool is_nan(T value) REALM_NOEXCEPT;
+
+    /// Write to \a rows, in ascending order, the rows at positions [begin,
+    /// end) of the index.
+    void get_rows(std::size_t begin, std::size_t end, std::vector<std::size_t>& rows) const;
+
+private:
+    // While a hook runs, the entries still describe the table as it was
+    // before the change. This says how to read their values from the table
+    // as it is now.
+    struct Before {
+        std::size_t row = npos;         // Entry whose value was `value`
+        T value = T();
+        std::size_t row_2 = npos;       // Entry whose value was `value_2`
+        T value_2 = T();
+        std::size_t erased_row = npos;  // Entries above it moved down by one
+    };
+
+    T get_value(std::size_t row_ndx) const REALM_NOEXCEPT;
+    T get_value(std::size_t row_ndx, const Before&) const REALM_NOEXCEPT;
+
+    // The order of the entries, which is `<` with NaN last
+    static bool less(T a, T b) REALM_NOEXCEPT;
+
+    // Position of the first entry that is not less than (value, row_ndx)
+    std::size_t find_position(T value, std::size_t row_ndx, const Before&) const;
+    void insert_entry(std::size_t row_ndx);
+    void erase_entry(std::size_t row_ndx, T value, const Before&);
+
+    ConstTableRef m_table;
+    std::size_t m_column_ndx;
+    Column m_rows;
+    IndexSnapshot m_snapshot;
+};
+
+
+/// Query condition on a range of values, answered from an OrderedIndex.
+template<class T> class OrderedIndexNode: public IndexRowsNode {
+public:
+    struct Bound {
+        T value;
+        bool is_set;
+        bool is_inclusive;
+    };
+
+    OrderedIndexNode(OrderedIndex<T>& index, Bound lower, Bound upper):
+        IndexRowsNode(index.get_column_index()),
+        m_index(&index), m_lower(lower), m_upper(upper)
+    {
+    }
+    ~OrderedIndexNode() REALM_NOEXCEPT override {}
+
+    ParentNode* clone() override
+    {
+        return new OrderedIndexNode(*this);
+    }
+
+    OrderedIndexNode(const OrderedIndexNode& from)
+        : IndexRowsNode(from)
+    {
+        m_index = from.m_index;
+        m_lower = from.m_lower;
+        m_upper = from.m_upper;
+    }
+
+protected:
+    void find_rows(const Table&, std::vector<size_t>& rows) override
+    {
+        if ((m_lower.is_set && OrderedIndex<T>::is_nan(m_lower.value)) ||
+            (m_upper.is_set && OrderedIndex<T>::is_nan(m_upper.value)))
+            return;
+
+        m_index->sync_if_needed();
+
+        size_t begin = 0;
+        size_t end = m_index->nan_begin();
+        if (m_lower.is_set)
+            begin = m_lower.is_inclusive ? m_index->lower_bound(m_lower.value) : m_index->upper_bound(m_lower.value);
+        if (m_upper.is_set)
+            end = m_upper.is_inclusive ? m_index->upper_bound(m_upper.value) : m_index->lower_bound(m_upper.value);
+        m_index->get_rows(begin, std::max(begin, end), rows);
+    }
+
+private:
+    OrderedIndex<T>* m_index;
+    Bound m_lower;
+    Bound m_upper;
+};
+
+
+
+// Implementation:
+
+template<class T>
+inline OrderedIndex<T>::OrderedIndex(const Table& table, std::size_t column_ndx):
+    m_table(table.get_table_ref()),
+    m_column_ndx(column_ndx),
+    m_rows(Allocator::get_default(), Column::create(Allocator::get_default())) // Throws
+{
+    DataType type = table.get_column_type(column_ndx);
+    bool match = (std::is_same<T, int64_t>::value && type == type_Int) ||
+                 (std::is_same<T, float>::value && type == type_Float) ||
+                 (std::is_same<T, double>::value && type == type_Double) ||
+                 (std::is_same<T, DateTime>::value && type == type_DateTime);
+    if (!match) {
+        m_rows.destroy();
+        throw LogicError(LogicError::type_mismatch);
+    }
+    rebuild(); // Throws
+}
+
+template<class T>
+inline OrderedIndex<T>::~OrderedIndex() REALM_NOEXCEPT
+{
+    m_rows.destroy();
+}
+
+template<class T>
+inline const Table& OrderedIndex<T>::get_table() const REALM_NOEXCEPT
+{
+    return *m_table;
+}
+
+template<class T>
+inline std::size_t OrderedIndex<T>::get_column_index() const REALM_NOEXCEPT
+{
+    return m_column_ndx;
+}
+
+template<class T>
+inline std::size_t OrderedIndex<T>::size() const REALM_NOEXCEPT
+{
+    return m_rows.size();
+}
+
+template<class T>
+inline std::size_t OrderedIndex<T>::get_row(std::size_t ndx) const REALM_NOEXCEPT
+{
+    return to_size_t(m_rows.get(ndx));
+}
+
+template<>
+inline int64_t OrderedIndex<int64_t>::get_value(std::size_t row_ndx) const REALM_NOEXCEPT
+{
+    return m_table->get_int(m_column_ndx, row_ndx);
+}
+
+template<>
+inline float OrderedIndex<float>::get_value(std::size_t row_ndx) const REALM_NOEXCEPT
+{
+    return m_table->get_float(m_column_ndx, row_ndx);
+}
+
+template<>
+inline double OrderedIndex<double>::get_value(std::size_t row_ndx) const REALM_NOEXCEPT
+{
+    return m_table->get_double(m_column_ndx, row_ndx);
+}
+
+template<>
+inline DateTime OrderedIndex<DateTime>::get_value(std::size_t row_ndx) const REALM_NOEXCEPT
+{
+    return m_table->get_datetime(m_column_ndx, row_ndx);
+}
+
+template<class T>
+inline T OrderedIndex<T>::get_value(std::size_t row_ndx, const Before& before) const REALM_NOEXCEPT
+{
+    if (row_ndx == before.row)
+        return before.value;
+    if (row_ndx == before.row_2)
+        return before.value_2;
+    if (before.erased_row != npos && row_ndx > before.erased_row)
+        return get_value(row_ndx - 1);
+    return get_value(row_ndx);
+}
+
+template<class T>
+inline bool OrderedIndex<T>::is_nan(T) REALM_NOEXCEPT
+{
+    return false;
+}
+
+template<>
+inline bool OrderedIndex<float>::is_nan(float value) REALM_NOEXCEPT
+{
+    return std::isnan(value);
+}
+
+template<>
+inline bool OrderedIndex<double>::is_nan(double value) REALM_NOEXCEPT
+{
+    return std::isnan(value);
+}
+
+template<class T>
+inline bool OrderedIndex<T>::less(T a, T b) REALM_NOEXCEPT
+{
+    if (is_nan(a))
+        return false;
+    return is_nan(b) || a < b;
+}
+
+template<class T>
+inline void OrderedIndex<T>::sync_if_needed()
+{
+    if (!m_snapshot.is_current(*m_table))
+        rebuild(); // Throws
+}
+
+template<class T>
+inline void OrderedIndex<T>::rebuild()
+{
+    std::size_t n = m_table->size();
+    std::vector<std::pair<T, std::size_t>> entries;
+    entries.reserve(n);
+    for (std::size_t i = 0; i < n; ++i)
+        entries.push_back(std::make_pair(get_value(i), i));
+    // Stable, so that ties stay in row order
+    std::stable_sort(entries.begin(), entries.end(),
+                     [](const std::pair<T, std::size_t>& a, const std::pair<T, std::size_t>& b) {
+                         return less(a.first, b.first);
+                     });
+
+    m_rows.clear(); // Throws
+    for (std::size_t i = 0; i < n; ++i)
+        m_rows.add(int64_t(entries[i].second)); // Throws
+    m_snapshot.mark_current(*m_table);
+}
+
+template<class T>
+inline std::size_t OrderedIndex<T>::find_position(T value, std::size_t row_ndx, const Before& before) const
+{
+    std::size_t begin = 0;
+    std::size_t end = m_rows.size();
+    while (begin < end) {
+        std::size_t mid = begin + (end - begin) / 2;
+        std::size_t r = to_size_t(m_rows.get(mid));
+        T v = get_value(r, before);
+        if (less(v, value) || (!less(value, v) && r < row_ndx))
+            begin = mid + 1;
+        else
+            end = mid;
+    }
+    return begin;
+}
+
+template<class T>
+inline std::size_t OrderedIndex<T>::lower_bound(T value) const
+{
+    return find_position(value, 0, Before());
+}
+
+template<class T>
+inline std::size_t OrderedIndex<T>::upper_bound(T value) const
+{
+    std::size_t begin = 0;
+    std::size_t end = m_rows.size();
+    while (begin < end) {
+        std::size_t mid = begin + (end - begin) / 2;
+        if (less(value, get_value(to_size_t(m_rows.get(mid)))))
+            end = mid;
+        else
+            begin = mid + 1;
+    }
+    return begin;
+}
+
+template<class T>
+inline std::size_t OrderedIndex<T>::nan_begin() const
+{
+    // Only float and double columns can hold NaN, and it sorts last
+    std::size_t end = m_rows.size();
+    if (!std::is_floating_point<T>::value)
+        return end;
+    std::size_t begin = 0;
+    while (begin < end) {
+        std::size_t mid = begin + (end - begin) / 2;
+        if (is_nan(get_value(to_size_t(m_rows.get(mid)))))
+            end = mid;
+        else
+            begin = mid + 1;
+    }
+    return begin;
+}
+
+template<class T>
+inline std::size_t OrderedIndex<T>::find_run_begin(std::size_t ndx) const
+{
+    return lower_bound(get_value(get_row(ndx)));
+}
+
+template<class T>
+inline void OrderedIndex<T>::get_rows(std::size_t begin, std::size_t end, std::vector<std::size_t>& rows) const
+{
+    std::size_t first_new = rows.size();
+    for (std::size_t i = begin; i < end; ++i)
+        rows.push_back(to_size_t(m_rows.get(i)));
+    std::sort(rows.begin() + first_new, rows.end());
+}
+
+template<class T>
+inline void OrderedIndex<T>::insert_entry(std::size_t row_ndx)
+{
+    std::size_t ndx = find_position(get_value(row_ndx), row_ndx, Before());
+    if (ndx == m_rows.size())
+        m_rows.add(int64_t(row_ndx)); // Throws
+    else
+        m_rows.insert(ndx, int64_t(row_ndx)); // Throws
+}
+
+template<class T>
+inline void OrderedIndex<T>::erase_entry(std::size_t row_ndx, T value, const Before& before)
+{
+    std::size_t ndx = find_position(value, row_ndx, before);
+    REALM_ASSERT_3(ndx, <, m_rows.size());
+    REALM_ASSERT_3(to_size_t(m_rows.get(ndx)), ==, row_ndx);
+    bool is_last = ndx == m_rows.size() - 1;
+    m_rows.erase(ndx, is_last);
+}
+
+template<class T>
+inline void OrderedIndex<T>::insert(std::size_t row_ndx, std::size_t num_rows, bool is_append)
+{
+    // Rows after the inserted ones move up, just like in StringIndex::insert()
+    if (!is_append)
+        m_rows.adjust_ge(int64_t(row_ndx), int64_t(num_rows));
+    for (std::size_t i = 0; i < num_rows; ++i)
+        insert_entry(row_ndx + i); // Throws
+    m_snapshot.mark_current(*m_table);
+}
+
+template<class T>
+inline void OrderedIndex<T>::set(std::size_t row_ndx, T old_value)
+{
+    Before before;
+    before.row = row_ndx;
+    before.value = old_value;
+    erase_entry(row_ndx, old_value, before);
+    insert_entry(row_ndx); // Throws
+    m_snapshot.mark_current(*m_table);
+}
+
+template<class T>
+inline void OrderedIndex<T>::erase(std::size_t row_ndx, T value, bool is_last)
+{
+    Before before;
+    before.row = row_ndx;
+    before.value = value;
+    before.erased_row = row_ndx;
+    erase_entry(row_ndx, value, before);
+    if (!is_last)
+        m_rows.adjust_ge(int64_t(row_ndx + 1), -1);
+    m_snapshot.mark_current(*m_table);
+}
+
+template<class T>
+inline void OrderedIndex<T>::move_last_over(std::size_t row_ndx, std::size_t last_row_ndx, T value,
+                                            T last_value)
+{
+    Before before;
+    before.row = row_ndx;
+    before.value = value;
+    erase_entry(row_ndx, value, before);
+    if (row_ndx != last_row_ndx) {
+        before.row_2 = last_row_ndx;
+        before.value_2 = last_value;
+        erase_entry(last_row_ndx, last_value, before);
+        insert_entry(row_ndx); // Throws
+    }
+    m_snapshot.mark_current(*m_table);
+}
+
+template<class T>
+inline void OrderedIndex<T>::clear()
+{
+    m_rows.clear(); // Throws
+    m_snapshot.mark_current(*m_table);
+}
+
+
+template<class T> inline Query& Query::greater(OrderedIndex<T>& index, typename OrderedIndex<T>::value_type value)
+{
+    return add_ordered_index_condition(index, value, true, false, value, false, false);
+}
+
+template<class T>
+inline Query& Query::greater_equal(OrderedIndex<T>& index, typename OrderedIndex<T>::value_type value)
+{
+    return add_ordered_index_condition(index, value, true, true, value, false, false);
+}
+
+template<class T> inline Query& Query::less(OrderedIndex<T>& index, typename OrderedIndex<T>::value_type value)
+{
+    return add_ordered_index_condition(index, value, false, false, value, true, false);
+}
+
+template<class T>
+inline Query& Query::less_equal(OrderedIndex<T>& index, typename OrderedIndex<T>::value_type value)
+{
+    return add_ordered_index_condition(index, value, false, false, value, true, true);
+}
+
+template<class T>
+inline Query& Query::between(OrderedIndex<T>& index, typename OrderedIndex<T>::value_type from,
+                             typename OrderedIndex<T>::value_type to)
+{
+    return add_ordered_index_condition(index, from, true, true, to, true, true);
+}
+
+template<class T>
+inline Query& Query::add_ordered_index_condition(OrderedIndex<T>& index, T lower, bool has_lower,
+                                                 bool lower_inclusive, T upper, bool has_upper,
+                                                 bool upper_inclusive)
+{
+    if (&index.get_table() != m_table.get())
+        throw LogicError(LogicError::illegal_combination);
+
+    typename OrderedIndexNode<T>::Bound lower_bound = { lower, has_lower, lower_inclusive };
+    typename OrderedIndexNode<T>::Bound upper_bound = { upper, has_upper, upper_inclusive };
+    ParentNode* const p = new OrderedIndexNode<T>(index, lower_bound, upper_bound);
+    UpdatePointers(p, &p->m_child);
+    return *this;
+}
+
+template<class T> inline TableView Query::find_all_sorted(OrderedIndex<T>& index, bool ascending)
+{
+    if (&index.get_table() != m_table.get())
+        throw LogicError(LogicError::illegal_combination);
+
+    // The view holds the query and the sort order, so that bringing it up to
+    // date after the table changes re-runs the query and sorts the matches
+    TableView tv(*m_table, *this, 0, size_t(-1), size_t(-1));
+
+    // The rows of a restricting view are not visited through FindInternal(), so they are sorted instead
+    if (m_view) {
+        find_all(tv);
+        tv.sort(index.get_column_index(), ascending);
+        return tv;
+    }
+    tv.m_sorting_predicate = RowIndexes::Sorter(std::vector<size_t>(1, index.get_column_index()),
+                                                std::vector<bool>(1, ascending));
+    tv.m_auto_sort = true;
+
+    index.sync_if_needed();
+    Init(*m_table);
+
+    // Visit the rows in index order and keep those that match, so the view
+    // is born sorted. When descending, runs of equal values are visited from
+    // the last one, but each in row order, which is how sort() orders ties.
+    std::size_t run_end = index.size();
+    while (run_end > 0) {
+        std::size_t run_begin = ascending ? 0 : index.find_run_begin(run_end - 1);
+        for (std::size_t i = run_begin; i < run_end; ++i) {
+            std::size_t r = index.get_row(i);
+            if (FindInternal(r, r + 1) == r)
+                tv.m_row_indexes.add(r);
+        }
+        run_end = run_begin;
+    }
+    return tv;
+}
+
+} // namespace realm
+
+#endif // REALM_INDEX_ORDERED_HPP
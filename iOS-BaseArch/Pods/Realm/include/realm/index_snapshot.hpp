@@ -0,0 +1,134 @@
+/*************************************************************************
+ *
+ * REALM CONFIDENTIAL
+ * __________________
+ *
+ *  [2011] - [2015] Realm Inc
+ *  All Rights Reserved.
+ *
+ * NOTICE:  All information contained herein is, and remains
+ * the property of Realm Incorporated and its suppliers,
+ * if any.  The intellectual and technical concepts contained
+ * herein are proprietary to Realm Incorporated
+ * and its suppliers and may be covered by U.S. and Foreign Patents,
+ * patents in process, and are protected by trade secret or copyright law.
+ * Dissemination of this information or reproduction of this material
+ * is strictly forbidden unless prior written permission is obtained
+ * from Realm Incorporated.
+ *
+ **************************************************************************/
+#ifndef REALM_INDEX_SNAPSHOT_HPP
+#define REALM_INDEX_SNAPSHOT_HPP
+
+#include <algorithm>
+#include <vector>
+
+#include <realm/table.hpp>
+#include <realm/query_engine.hpp>
+
+namespace realm {
+
+/// Whether an in-memory index is a snapshot of the current contents of its
+/// table.
+///
+/// FullTextIndex, OrderedIndex, CompositeIndex and StringHashIndex are
+/// snapshot helpers. The Realm file has no place for them, and nothing in
+/// the library tells them about changes to the table. Their
+/// sync_if_needed() therefore rebuilds them in full whenever the version of
+/// the table differs from the one they were built for, which after a write
+/// means before the next query that uses them. Without replication, tables
+/// have no version, and every sync_if_needed() rebuilds.
+///
+/// Their incremental hooks (insert(), set(), erase(), move_last_over() and
+/// clear()) are for callers that pass every change of the indexed columns
+/// to them as well. Each hook marks the index current, so that the next
+/// sync_if_needed() has nothing to do.
+class IndexSnapshot {
+public:
+    bool is_current(const Table&) const REALM_NOEXCEPT;
+    void mark_current(const Table&) REALM_NOEXCEPT;
+
+private:
+    bool m_is_marked = false;
+    uint_fast64_t m_version = 0;
+};
+
+
+/// Base of the query conditions that are answered from an in-memory index.
+/// The matching rows are looked up by find_rows() once per execution, and
+/// are then handed out in row order. The match distance is exact, like for
+/// an indexed StringNode<Equal>.
+class IndexRowsNode: public ParentNode {
+public:
+    ~IndexRowsNode() REALM_NOEXCEPT override {}
+
+    void init(const Table& table) override
+    {
+        m_table = &table;
+        m_rows.clear();
+        find_rows(table, m_rows);
+        m_dD = (table.size() + 1.0) / (m_rows.size() + 1.0);
+
+        if (m_child)
+            m_child->init(table);
+    }
+
+    size_t find_first_local(size_t start, size_t end) override
+    {
+        std::vector<size_t>::const_iterator it = std::lower_bound(m_rows.begin(), m_rows.end(), start);
+        if (it == m_rows.end() || *it >= end)
+            return not_found;
+        return *it;
+    }
+
+protected:
+    explicit IndexRowsNode(size_t column_ndx)
+    {
+        m_condition_column_idx = column_ndx;
+        m_child = nullptr;
+        m_dT = 0.0;
+    }
+
+    IndexRowsNode(const IndexRowsNode& from)
+        : ParentNode(from)
+    {
+        m_child = from.m_child;
+        // m_rows is not copied
+    }
+
+    /// Write the matching rows to \a rows in ascending order, after
+    /// bringing the index up to date.
+    virtual void find_rows(const Table&, std::vector<size_t>& rows) = 0;
+
+private:
+    std::vector<size_t> m_rows;
+};
+
+
+
+
+// Implementation:
+
+inline bool IndexSnapshot::is_current(const Table& table) const REALM_NOEXCEPT
+{
+#ifdef REALM_ENABLE_REPLICATION
+    return m_is_marked && m_version == table.m_version;
+#else
+    static_cast<void>(table);
+    return false;
+#endif
+}
+
+inline void IndexSnapshot::mark_current(const Table& table) REALM_NOEXCEPT
+{
+#ifdef REALM_ENABLE_REPLICATION
+    m_version = table.m_version;
+#else
+    static_cast<void>(table);
+#endif
+    m_is_marked = true;
+}
+
+} // namespace realm
+
+#endif // REALM_INDEX_SNAPSHOT_HPP
@@ -22,7 +22,9 @@
 
 #include <iostream>
 #include <cstring>
+#include <limits>
 #include <memory>
+#include <vector>
 
 #include <realm/array.hpp>
 #include <realm/column_fwd.hpp>
@@ -113,6 +115,28 @@ public:
         do_update_ref(to_str(value), old_row_ndx, new_row_ndx, 0);
     }
 
+    /// Add to \a result, in ascending order, the rows whose value begins with
+    /// \a prefix. Only the key range of the index that can hold such values is
+    /// visited. Defined in column.hpp, because it needs the complete
+    /// ColumnBase to check the candidate rows.
+    void find_all_prefix(StringData prefix, std::vector<size_t>& result) const;
+
+    /// Fill an empty index in one pass. \a values[i] is the value of row i,
+    /// and must stay valid during the call. Instead of inserting the rows one
+    /// by one, the (value, row) pairs are sorted once and the leaves and inner
+    /// nodes are built bottom-up. With \a num_threads > 1, the sort is split
+    /// across that many threads. Rows with equal values share a row list, so
+    /// if the index denies duplicate values, \a values must have none. When
+    /// REALM_DEBUG_INDEX_BULK is defined, the result is checked against the
+    /// tree that inserting the rows one by one builds. Defined in column.hpp.
+    void bulk_insert(const std::vector<StringData>& values, unsigned int num_threads = 1);
+
+    /// Replace the contents of the index by a bulk_insert() of the values of
+    /// the target column, read through ColumnBase::get_index_data(), so it
+    /// works for integer and string columns alike. The sort is split across
+    /// the hardware threads. Defined in column.hpp.
+    void bulk_rebuild();
+
     void clear();
 
     void distinct(Column& result) const;
@@ -177,6 +201,32 @@ private:
 
     void NodeAddKey(ref_type ref);
 
+    // Ordered traversal for find_all_prefix(). Adds every row that is stored
+    // under a key that begins with the bytes of \a prefix from \a offset on,
+    // so the rows are candidates that must still be checked.
+    static void find_prefix_candidates(const Array& node, StringData prefix, size_t offset,
+                                       std::vector<size_t>& rows);
+    static void add_row_list(Allocator&, ref_type, std::vector<size_t>& rows);
+
+    // Bulk loading for bulk_insert(). bulk_compare() orders values the way
+    // the tree stores them: by the key at offset 0, then the key at offset 4,
+    // and so on. bulk_build() returns the root of a tree holding the sorted
+    // rows [begin, end), keyed from \a offset on.
+    static key_type bulk_key(StringData, size_t offset) REALM_NOEXCEPT;
+    static int bulk_compare(StringData, StringData) REALM_NOEXCEPT;
+    static ref_type bulk_build(Allocator&, const std::vector<StringData>& values, const size_t* begin,
+                               const size_t* end, size_t offset);
+    static ref_type bulk_build_node(Allocator&, bool is_leaf, const int64_t* keys, const int64_t* values,
+                                    size_t size);
+
+#ifdef REALM_DEBUG_INDEX_BULK
+    // The leaf entries of the tree at \a ref in key order, with row lists
+    // and sub-indexes expanded, so that trees that only differ in how they
+    // are split into nodes give the same list. Each element is a kind (key,
+    // literal row, row list row, sub-index begin or end) and a value.
+    static void bulk_get_entries(Allocator&, ref_type, std::vector<std::pair<int, int64_t>>& entries);
+#endif
+
 #ifdef REALM_DEBUG
     static void dump_node_structure(const Array& node, std::ostream&, int level);
     void to_dot_2(std::ostream&, StringData title = StringData()) const;
@@ -343,6 +393,91 @@ template <class T> void StringIndex::erase(size_t row_ndx, bool is_last)
         adjust_row_indexes(row_ndx, -1);
 }
 
+inline void StringIndex::find_prefix_candidates(const Array& node, StringData prefix, size_t offset,
+                                                std::vector<size_t>& rows)
+{
+    Allocator& alloc = node.get_alloc();
+    Array keys(alloc);
+    keys.init_from_ref(node.get_as_ref(0));
+
+    // Keys are compared as signed 32-bit integers. Fixing the leading bytes of a key to those of the prefix leaves a
+    // contiguous range of keys, [lower, upper]. With 4 or more prefix bytes left, that is a single key.
+    int64_t lower = std::numeric_limits<key_type>::min();
+    int64_t upper = std::numeric_limits<key_type>::max();
+    size_t fixed = offset < prefix.size() ? std::min<size_t>(prefix.size() - offset, sizeof(key_type)) : 0;
+    if (fixed != 0) {
+        uint32_t bits = 0;
+        for (size_t i = 0; i < fixed; ++i)
+            bits |= uint32_t(static_cast<unsigned char>(prefix[offset + i])) << (24 - 8 * i);
+        uint32_t mask = fixed == sizeof(key_type) ? ~uint32_t(0) : ~(~uint32_t(0) >> (8 * fixed));
+        lower = key_type(bits & mask);
+        upper = key_type(bits | ~mask);
+    }
+
+    // First key that is not less than 'lower'
+    size_t begin = 0;
+    size_t end = keys.size();
+    while (begin < end) {
+        size_t mid = begin + (end - begin) / 2;
+        if (keys.get(mid) < lower)
+            begin = mid + 1;
+        else
+            end = mid;
+    }
+
+    const bool is_inner = node.is_inner_bptree_node();
+    for (size_t i = begin; i < keys.size(); ++i) {
+        int64_t key = keys.get(i);
+        if (is_inner) {
+            // Child i holds the keys up to and including keys[i]
+            Array child(alloc);
+            child.init_from_ref(node.get_as_ref(i + 1));
+            find_prefix_candidates(child, prefix, offset, rows);
+            if (key > upper)
+                break;
+            continue;
+        }
+
+        if (key > upper)
+            break;
+
+        int64_t ref = node.get(i + 1);
+        if (ref & 1) {
+            // Literal row index
+            rows.push_back(size_t(uint64_t(ref) >> 1));
+            continue;
+        }
+
+        const char* header = alloc.translate(to_ref(ref));
+        if (Array::get_context_flag_from_header(header)) {
+            // Sub-index for the next 4 bytes of the values
+            Array sub_index(alloc);
+            sub_index.init_from_ref(to_ref(ref));
+            find_prefix_candidates(sub_index, prefix, offset + sizeof(key_type), rows);
+        }
+        else {
+            add_row_list(alloc, to_ref(ref), rows);
+        }
+    }
+}
+
+inline void StringIndex::add_row_list(Allocator& alloc, ref_type ref, std::vector<size_t>& rows)
+{
+    Array list(alloc);
+    list.init_from_ref(ref);
+    if (!list.is_inner_bptree_node()) {
+        size_t n = list.size();
+        for (size_t i = 0; i < n; ++i)
+            rows.push_back(to_size_t(list.get(i)));
+        return;
+    }
+
+    // The list has grown into a B+-tree. The first and last elements of an inner node are not children.
+    size_t n = list.size();
+    for (size_t i = 1; i + 1 < n; ++i)
+        add_row_list(alloc, list.get_as_ref(i), rows);
+}
+
 inline
 void StringIndex::destroy() REALM_NOEXCEPT
 {
@@ -0,0 +1,595 @@
+/*************************************************************************
+ *
+ * REALM CONFIDENTIAL
+ * __________________
+ *
+ *  [2011] - [2015] Realm Inc
+ *  All Rights Reserved.
+ *
+ * NOTICE:  All information contained herein is, and remains
+ * the property of Realm Incorporated and its suppliers,
+ * if any.  The intellectual and technical concepts contained
+ * herein are proprietary to Realm Incorporated
+ * and its suppliers and may be covered by U.S. and Foreign Patents,
+ * patents in process, and are protected by trade secret or copyright law.
+ * Dissemination of this information or reproduction of this material
+ * is strictly forbidden unless prior written permission is obtained
+ * from Realm Incorporated.
+ *
+ **************************************************************************/
+#ifndef REALM_INDEX_STRING_HASH_HPP
+#define REALM_INDEX_STRING_HASH_HPP
+
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <realm/array.hpp>
+#include <realm/column.hpp>
+#include <realm/table.hpp>
+#include <realm/query_engine.hpp>
+#include <realm/index_snapshot.hpp>
+
+namespace realm {
+
+/// Hash index for equality lookups on a string column.
+///
+/// StringIndex descends one 4-byte key at a time, so values with long shared
+/// prefixes, like URLs and UUIDs, end up several sub-indexes deep. This index
+/// hashes the whole value instead, into an open-addressing table with linear
+/// probing, so a lookup is one probe sequence that is usually a single slot.
+/// It answers equality only, no prefixes or ranges.
+///
+/// Each distinct value has one slot, a 64-bit integer that holds a 32-bit
+/// fingerprint of the hash in the upper half and the lowest row that holds
+/// the value, plus one, in the lower half, so zero is an empty slot. The
+/// other rows that hold the value are chained from it in ascending order
+/// through an integer column with an entry per row, which holds the next row
+/// of the chain plus one, or zero at the end. Rows that share a value thus
+/// take no extra slots, so they neither lengthen the probe sequences of
+/// other values nor get compared one by one. The fingerprint decides the
+/// home slot, and filters out most other values before the table is read.
+/// The slots are stored in integer arrays of at most 2^16 elements, the refs
+/// of which are held by a top array. The table is grown to keep it at most
+/// half full, and erasing uses backward shifting, so there are no
+/// tombstones.
+///
+/// The index is an in-memory snapshot helper, see IndexSnapshot, that is
+/// only consulted through its own find functions and through
+/// Query::equal(StringHashIndex&, StringData). It is not a persisted index
+/// of the column, and Table::find_pkey_string() does not use it.
+class StringHashIndex {
+public:
+    StringHashIndex(const Table& table, std::size_t column_ndx);
+    ~StringHashIndex() REALM_NOEXCEPT;
+
+    const Table& get_table() const REALM_NOEXCEPT;
+    std::size_t get_column_index() const REALM_NOEXCEPT;
+
+    /// Rebuild the index unless it is current, see IndexSnapshot.
+    void sync_if_needed();
+    void rebuild();
+
+    //@{
+    /// Incremental maintenance. Each function must be called after the
+    /// corresponding change has been made to the table. \a value is the
+    /// string that the row held before the change.
+    void insert(std::size_t row_ndx, std::size_t num_rows, bool is_append);
+    void set(std::size_t row_ndx, StringData old_value);
+    void erase(std::size_t row_ndx, StringData value, bool is_last);
+    void move_last_over(std::size_t row_ndx, std::size_t last_row_ndx, StringData value,
+                        StringData last_value);
+    void clear();
+    //@}
+
+    /// Number of entries, which is the number of rows in the table.
+    std::size_t size() const REALM_NOEXCEPT;
+
+    /// The lowest row that holds \a value, or not_found.
+    std::size_t find_first(StringData value) const;
+
+    /// Write to \a rows, in ascending order, the rows that hold \a value.
+    void find_all(StringData value, std::vector<std::size_t>& rows) const;
+
+    std::size_t count(StringData value) const;
+
+private:
+    static const std::size_t segment_bits = 16;
+    static const std::size_t min_capacity = 16;
+
+    // While a hook runs, the slots and chains still describe the table as it
+    // was before the change. This says how to read their values from the
+    // table as it is now.
+    struct Before {
+        std::size_t row = npos;         // Row that held `value`
+        StringData value;
+        std::size_t row_2 = npos;       // Row that held `value_2`
+        StringData value_2;
+        std::size_t erased_row = npos;  // Rows above it moved down by one
+    };
+
+    static uint_fast32_t hash(StringData) REALM_NOEXCEPT;
+    static uint_fast32_t get_fingerprint(uint_fast64_t slot) REALM_NOEXCEPT;
+    static std::size_t get_row_ndx(uint_fast64_t slot) REALM_NOEXCEPT;
+    static uint_fast64_t make_slot(uint_fast32_t fingerprint, std::size_t row_ndx) REALM_NOEXCEPT;
+
+    uint_fast64_t get_slot(std::size_t slot_ndx) const REALM_NOEXCEPT;
+    void set_slot(std::size_t slot_ndx, uint_fast64_t slot);
+
+    // The row after `row_ndx` in its chain, or npos
+    std::size_t get_next(std::size_t row_ndx) const REALM_NOEXCEPT;
+    void set_next(std::size_t row_ndx, std::size_t next_row_ndx);
+
+    StringData get_value(std::size_t row_ndx, const Before&) const REALM_NOEXCEPT;
+
+    // Replace the slots by `capacity` empty ones
+    void reset(std::size_t capacity);
+    void add_entry(uint_fast32_t fingerprint, std::size_t row_ndx);
+
+    // The slot of `value`, or npos
+    std::size_t find_slot(StringData value, const Before&) const REALM_NOEXCEPT;
+    void remove_entry(std::size_t slot_ndx);
+
+    // Add the row to the chain of the value it holds now
+    void link_row(std::size_t row_ndx);
+    // Remove the row from the chain of `value`
+    void unlink_row(std::size_t row_ndx, StringData value, const Before&);
+    void adjust_row_indexes(std::size_t min_row_ndx, int diff);
+
+    ConstTableRef m_table;
+    std::size_t m_column_ndx;
+    Array m_top;
+    std::vector<std::unique_ptr<Array>> m_segments;
+    Column m_next;
+    std::size_t m_capacity = 0;
+    std::size_t m_num_values = 0;
+    IndexSnapshot m_snapshot;
+};
+
+
+/// Query condition that is answered from a StringHashIndex.
+class StringHashIndexNode: public IndexRowsNode {
+public:
+    StringHashIndexNode(StringHashIndex& index, StringData value):
+        IndexRowsNode(index.get_column_index()),
+        m_index(&index), m_value(value.data(), value.size()), m_is_null(value.is_null())
+    {
+    }
+    ~StringHashIndexNode() REALM_NOEXCEPT override {}
+
+    ParentNode* clone() override
+    {
+        return new StringHashIndexNode(*this);
+    }
+
+    StringHashIndexNode(const StringHashIndexNode& from)
+        : IndexRowsNode(from)
+    {
+        m_index = from.m_index;
+        m_value = from.m_value;
+        m_is_null = from.m_is_null;
+    }
+
+protected:
+    void find_rows(const Table&, std::vector<size_t>& rows) override
+    {
+        m_index->sync_if_needed();
+        m_index->find_all(m_is_null ? StringData() : StringData(m_value), rows);
+    }
+
+private:
+    StringHashIndex* m_index;
+    std::string m_value;
+    bool m_is_null;
+};
+
+
+
+
+// Implementation:
+
+inline StringHashIndex::StringHashIndex(const Table& table, std::size_t column_ndx):
+    m_table(table.get_table_ref()),
+    m_column_ndx(column_ndx),
+    m_top(Allocator::get_default()),
+    m_next(Allocator::get_default(), Column::create(Allocator::get_default())) // Throws
+{
+    if (table.get_column_type(column_ndx) != type_String) {
+        m_next.destroy();
+        throw LogicError(LogicError::type_mismatch);
+    }
+    try {
+        m_top.create(Array::type_HasRefs); // Throws
+        rebuild(); // Throws
+    }
+    catch (...) {
+        if (m_top.is_attached())
+            m_top.destroy_deep();
+        m_next.destroy();
+        throw;
+    }
+}
+
+inline StringHashIndex::~StringHashIndex() REALM_NOEXCEPT
+{
+    m_next.destroy();
+    m_top.destroy_deep();
+}
+
+inline const Table& StringHashIndex::get_table() const REALM_NOEXCEPT
+{
+    return *m_table;
+}
+
+inline std::size_t StringHashIndex::get_column_index() const REALM_NOEXCEPT
+{
+    return m_column_ndx;
+}
+
+inline std::size_t StringHashIndex::size() const REALM_NOEXCEPT
+{
+    return m_next.size();
+}
+
+inline uint_fast32_t StringHashIndex::hash(StringData value) REALM_NOEXCEPT
+{
+    // FNV-1a, followed by the MurmurHash3 finalizer, because the upper bits
+    // are used
+    uint_fast64_t h = 14695981039346656037ULL;
+    for (std::size_t t = 0; t < value.size(); ++t) {
+        h ^= static_cast<unsigned char>(value.data()[t]);
+        h *= 1099511628211ULL;
+    }
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return uint_fast32_t(h >> 32);
+}
+
+inline uint_fast32_t StringHashIndex::get_fingerprint(uint_fast64_t slot) REALM_NOEXCEPT
+{
+    return uint_fast32_t(slot >> 32);
+}
+
+inline std::size_t StringHashIndex::get_row_ndx(uint_fast64_t slot) REALM_NOEXCEPT
+{
+    return std::size_t(slot & 0xFFFFFFFFULL) - 1;
+}
+
+inline uint_fast64_t StringHashIndex::make_slot(uint_fast32_t fingerprint, std::size_t row_ndx) REALM_NOEXCEPT
+{
+    return (uint_fast64_t(fingerprint) << 32) | uint_fast64_t(row_ndx + 1);
+}
+
+inline uint_fast64_t StringHashIndex::get_slot(std::size_t slot_ndx) const REALM_NOEXCEPT
+{
+    const Array& segment = *m_segments[slot_ndx >> segment_bits];
+    return uint_fast64_t(segment.get(slot_ndx & ((std::size_t(1) << segment_bits) - 1)));
+}
+
+inline void StringHashIndex::set_slot(std::size_t slot_ndx, uint_fast64_t slot)
+{
+    Array& segment = *m_segments[slot_ndx >> segment_bits];
+    segment.set(slot_ndx & ((std::size_t(1) << segment_bits) - 1), int64_t(slot)); // Throws
+}
+
+inline std::size_t StringHashIndex::get_next(std::size_t row_ndx) const REALM_NOEXCEPT
+{
+    int64_t next = m_next.get(row_ndx);
+    return next == 0 ? npos : to_size_t(next - 1);
+}
+
+inline void StringHashIndex::set_next(std::size_t row_ndx, std::size_t next_row_ndx)
+{
+    m_next.set(row_ndx, next_row_ndx == npos ? 0 : int64_t(next_row_ndx + 1)); // Throws
+}
+
+inline StringData StringHashIndex::get_value(std::size_t row_ndx, const Before& before) const REALM_NOEXCEPT
+{
+    if (row_ndx == before.row)
+        return before.value;
+    if (row_ndx == before.row_2)
+        return before.value_2;
+    if (before.erased_row != npos && row_ndx > before.erased_row)
+        return m_table->get_string(m_column_ndx, row_ndx - 1);
+    return m_table->get_string(m_column_ndx, row_ndx);
+}
+
+inline void StringHashIndex::reset(std::size_t capacity)
+{
+    // Row indexes must fit in the lower half of a slot
+    if (capacity / 2 > std::numeric_limits<uint32_t>::max() - 1)
+        throw std::bad_alloc();
+
+    Allocator& alloc = m_top.get_alloc();
+    Array top(alloc);
+    top.create(Array::type_HasRefs); // Throws
+    std::vector<std::unique_ptr<Array>> segments;
+    try {
+        std::size_t segment_size = std::min(capacity, std::size_t(1) << segment_bits);
+        for (std::size_t i = 0; i < capacity; i += segment_size) {
+            std::unique_ptr<Array> segment(new Array(alloc)); // Throws
+            segment->create(Array::type_Normal, false, segment_size, 0); // Throws
+            try {
+                // Full width up front, so that setting a slot never reallocates
+                segment->ensure_minimum_width(std::numeric_limits<int64_t>::min()); // Throws
+                top.add(int64_t(segment->get_ref())); // Throws
+            }
+            catch (...) {
+                segment->destroy();
+                throw;
+            }
+            segment->set_parent(&top, top.size() - 1);
+            segments.push_back(std::move(segment)); // Throws
+        }
+    }
+    catch (...) {
+        top.destroy_deep();
+        throw;
+    }
+
+    m_top.destroy_deep();
+    m_top.init_from_ref(top.get_ref());
+    for (std::size_t i = 0; i < segments.size(); ++i)
+        segments[i]->set_parent(&m_top, i);
+    m_segments.swap(segments);
+    m_capacity = capacity;
+    m_num_values = 0;
+}
+
+inline void StringHashIndex::add_entry(uint_fast32_t fingerprint, std::size_t row_ndx)
+{
+    if ((m_num_values + 1) * 2 > m_capacity) {
+        // Grow, and re-add the entries from their fingerprints
+        std::vector<uint_fast64_t> slots;
+        slots.reserve(m_num_values); // Throws
+        for (std::size_t i = 0; i < m_capacity; ++i) {
+            uint_fast64_t slot = get_slot(i);
+            if (slot != 0)
+                slots.push_back(slot);
+        }
+        reset(std::max(min_capacity, m_capacity * 2)); // Throws
+        for (std::size_t i = 0; i < slots.size(); ++i)
+            add_entry(get_fingerprint(slots[i]), get_row_ndx(slots[i])); // Throws
+    }
+
+    std::size_t mask = m_capacity - 1;
+    std::size_t i = fingerprint & mask;
+    while (get_slot(i) != 0)
+        i = (i + 1) & mask;
+    set_slot(i, make_slot(fingerprint, row_ndx)); // Throws
+    ++m_num_values;
+}
+
+inline std::size_t StringHashIndex::find_slot(StringData value, const Before& before) const REALM_NOEXCEPT
+{
+    uint_fast32_t fingerprint = hash(value);
+    std::size_t mask = m_capacity - 1;
+    for (std::size_t i = fingerprint & mask; ; i = (i + 1) & mask) {
+        uint_fast64_t slot = get_slot(i);
+        if (slot == 0)
+            return npos;
+        if (get_fingerprint(slot) == fingerprint && get_value(get_row_ndx(slot), before) == value)
+            return i;
+    }
+}
+
+inline void StringHashIndex::remove_entry(std::size_t slot_ndx)
+{
+    // Move later entries of the probe sequence back into the hole, unless
+    // that would put them before their home slot
+    std::size_t mask = m_capacity - 1;
+    std::size_t hole = slot_ndx;
+    for (std::size_t i = (hole + 1) & mask; ; i = (i + 1) & mask) {
+        uint_fast64_t slot = get_slot(i);
+        if (slot == 0)
+            break;
+        std::size_t home = get_fingerprint(slot) & mask;
+        bool movable = hole <= i ? (home <= hole || home > i) : (home <= hole && home > i);
+        if (movable) {
+            set_slot(hole, slot); // Throws
+            hole = i;
+        }
+    }
+    set_slot(hole, 0); // Throws
+    --m_num_values;
+}
+
+inline void StringHashIndex::link_row(std::size_t row_ndx)
+{
+    StringData value = m_table->get_string(m_column_ndx, row_ndx);
+    std::size_t slot_ndx = find_slot(value, Before());
+    if (slot_ndx == npos) {
+        set_next(row_ndx, npos); // Throws
+        add_entry(hash(value), row_ndx); // Throws
+        return;
+    }
+
+    uint_fast64_t slot = get_slot(slot_ndx);
+    std::size_t row = get_row_ndx(slot);
+    if (row_ndx < row) {
+        set_next(row_ndx, row); // Throws
+        set_slot(slot_ndx, make_slot(get_fingerprint(slot), row_ndx)); // Throws
+        return;
+    }
+    std::size_t next = get_next(row);
+    while (next != npos && next < row_ndx) {
+        row = next;
+        next = get_next(row);
+    }
+    set_next(row_ndx, next); // Throws
+    set_next(row, row_ndx); // Throws
+}
+
+inline void StringHashIndex::unlink_row(std::size_t row_ndx, StringData value, const Before& before)
+{
+    std::size_t slot_ndx = find_slot(value, before);
+    REALM_ASSERT(slot_ndx != npos);
+    uint_fast64_t slot = get_slot(slot_ndx);
+    std::size_t row = get_row_ndx(slot);
+    std::size_t next = get_next(row_ndx);
+    if (row == row_ndx) {
+        if (next == npos)
+            remove_entry(slot_ndx); // Throws
+        else
+            set_slot(slot_ndx, make_slot(get_fingerprint(slot), next)); // Throws
+    }
+    else {
+        while (get_next(row) != row_ndx) {
+            row = get_next(row);
+            REALM_ASSERT(row != npos);
+        }
+        set_next(row, next); // Throws
+    }
+    set_next(row_ndx, npos); // Throws
+}
+
+inline void StringHashIndex::adjust_row_indexes(std::size_t min_row_ndx, int diff)
+{
+    for (std::size_t i = 0; i < m_capacity; ++i) {
+        uint_fast64_t slot = get_slot(i);
+        if (slot != 0 && get_row_ndx(slot) >= min_row_ndx)
+            set_slot(i, make_slot(get_fingerprint(slot), get_row_ndx(slot) + diff)); // Throws
+    }
+    // The chains hold row indexes plus one
+    m_next.adjust_ge(int64_t(min_row_ndx + 1), diff); // Throws
+}
+
+inline void StringHashIndex::sync_if_needed()
+{
+    if (!m_snapshot.is_current(*m_table))
+        rebuild(); // Throws
+}
+
+inline void StringHashIndex::rebuild()
+{
+    std::size_t n = m_table->size();
+    std::size_t capacity = min_capacity;
+    while (capacity < n * 2)
+        capacity *= 2;
+    reset(capacity); // Throws
+    m_next.clear(); // Throws
+    if (n != 0)
+        m_next.insert(0, 0, n); // Throws
+
+    // Backwards, so that each row goes in front of its chain, and the chains
+    // come out in ascending order
+    for (std::size_t i = n; i > 0; --i) {
+        std::size_t row_ndx = i - 1;
+        StringData value = m_table->get_string(m_column_ndx, row_ndx);
+        std::size_t slot_ndx = find_slot(value, Before());
+        if (slot_ndx == npos) {
+            add_entry(hash(value), row_ndx); // Throws
+            continue;
+        }
+        uint_fast64_t slot = get_slot(slot_ndx);
+        set_next(row_ndx, get_row_ndx(slot)); // Throws
+        set_slot(slot_ndx, make_slot(get_fingerprint(slot), row_ndx)); // Throws
+    }
+    m_snapshot.mark_current(*m_table);
+}
+
+inline void StringHashIndex::insert(std::size_t row_ndx, std::size_t num_rows, bool is_append)
+{
+    // Rows after the inserted ones move up, just like in StringIndex::insert()
+    if (!is_append)
+        adjust_row_indexes(row_ndx, int(num_rows)); // Throws
+    m_next.insert(row_ndx, 0, num_rows); // Throws
+    for (std::size_t i = 0; i < num_rows; ++i)
+        link_row(row_ndx + i); // Throws
+    m_snapshot.mark_current(*m_table);
+}
+
+inline void StringHashIndex::set(std::size_t row_ndx, StringData old_value)
+{
+    Before before;
+    before.row = row_ndx;
+    before.value = old_value;
+    unlink_row(row_ndx, old_value, before); // Throws
+    link_row(row_ndx); // Throws
+    m_snapshot.mark_current(*m_table);
+}
+
+inline void StringHashIndex::erase(std::size_t row_ndx, StringData value, bool is_last)
+{
+    Before before;
+    before.row = row_ndx;
+    before.value = value;
+    before.erased_row = row_ndx;
+    unlink_row(row_ndx, value, before); // Throws
+    m_next.erase(row_ndx, is_last); // Throws
+    if (!is_last)
+        adjust_row_indexes(row_ndx + 1, -1); // Throws
+    m_snapshot.mark_current(*m_table);
+}
+
+inline void StringHashIndex::move_last_over(std::size_t row_ndx, std::size_t last_row_ndx, StringData value,
+                                            StringData last_value)
+{
+    Before before;
+    before.row = row_ndx;
+    before.value = value;
+    before.row_2 = last_row_ndx;
+    before.value_2 = last_value;
+    unlink_row(row_ndx, value, before); // Throws
+    if (row_ndx != last_row_ndx)
+        unlink_row(last_row_ndx, last_value, before); // Throws
+    m_next.erase(last_row_ndx, true); // Throws
+    if (row_ndx != last_row_ndx)
+        link_row(row_ndx); // Throws
+    m_snapshot.mark_current(*m_table);
+}
+
+inline void StringHashIndex::clear()
+{
+    reset(min_capacity); // Throws
+    m_next.clear(); // Throws
+    m_snapshot.mark_current(*m_table);
+}
+
+inline void StringHashIndex::find_all(StringData value, std::vector<std::size_t>& rows) const
+{
+    rows.clear();
+    std::size_t slot_ndx = find_slot(value, Before());
+    if (slot_ndx == npos)
+        return;
+    for (std::size_t row_ndx = get_row_ndx(get_slot(slot_ndx)); row_ndx != npos; row_ndx = get_next(row_ndx))
+        rows.push_back(row_ndx);
+}
+
+inline std::size_t StringHashIndex::find_first(StringData value) const
+{
+    std::size_t slot_ndx = find_slot(value, Before());
+    if (slot_ndx == npos)
+        return not_found;
+    return get_row_ndx(get_slot(slot_ndx));
+}
+
+inline std::size_t StringHashIndex::count(StringData value) const
+{
+    std::size_t n = 0;
+    std::size_t slot_ndx = find_slot(value, Before());
+    if (slot_ndx != npos) {
+        for (std::size_t row_ndx = get_row_ndx(get_slot(slot_ndx)); row_ndx != npos; row_ndx = get_next(row_ndx))
+            ++n;
+    }
+    return n;
+}
+
+inline Query& Query::equal(StringHashIndex& index, StringData value)
+{
+    if (&index.get_table() != m_table.get())
+        throw LogicError(LogicError::illegal_combination);
+
+    ParentNode* const p = new StringHashIndexNode(index, value);
+    UpdatePointers(p, &p->m_child);
+    return *this;
+}
+
+} // namespace realm
+
+#endif // REALM_INDEX_STRING_HASH_HPP
@@ -34,6 +34,8 @@
 
 namespace realm {
 
+class AutoEnumerator;
+class ViewUpdater;
 
 /// These functions are only to be used by language bindings to gain
 /// access to certain memebers that are othewise private.
@@ -176,10 +178,17 @@ public:
     template<class O>
     static void advance_read(SharedGroup&, History&, O&& observer,
                              SharedGroup::VersionID version = SharedGroup::VersionID());
+    // Defined in view_updater.hpp
+    static void advance_read(SharedGroup&, History&, ViewUpdater&,
+                             SharedGroup::VersionID version = SharedGroup::VersionID());
     static void promote_to_write(SharedGroup&, History&);
     template<class O>
     static void promote_to_write(SharedGroup&, History&, O&& observer);
+    // Defined in view_updater.hpp
+    static void promote_to_write(SharedGroup&, History&, ViewUpdater&);
     static void commit_and_continue_as_read(SharedGroup&);
+    // Defined in auto_enumerate.hpp
+    static void commit_and_continue_as_read(SharedGroup&, AutoEnumerator&);
     static void rollback_and_continue_as_read(SharedGroup&, History&);
     template<class O>
     static void rollback_and_continue_as_read(SharedGroup&, History&, O&& observer);
@@ -385,6 +394,7 @@ inline void LangBindHelper::promote_to_write(SharedGroup& sg, History& history,
 inline void LangBindHelper::commit_and_continue_as_read(SharedGroup& sg)
 {
     using sgf = _impl::SharedGroupFriend;
+    _impl::PreCommitHooks::run(sg, sgf::get_group(sg)); // Throws
     sgf::commit_and_continue_as_read(sg);
 }
 
@@ -150,6 +150,7 @@ private:
     friend class SharedGroup;
     friend class Query;
     friend class TableViewBase;
+    friend class ViewUpdater;
 };
 
 
@@ -27,14 +27,6 @@
 #include <string>
 #include <vector>
 
-#define REALM_MULTITHREAD_QUERY 0
-
-#if REALM_MULTITHREAD_QUERY
-// FIXME: Use our C++ thread abstraction API since it provides a much
-// higher level of encapsulation and safety.
-#include <pthread.h>
-#endif
-
 #include <realm/views.hpp>
 #include <realm/table_ref.hpp>
 #include <realm/binary_data.hpp>
@@ -54,6 +46,13 @@ class Array;
 class Expression;
 class SequentialGetterBase;
 class Group;
+class FullTextIndex;
+template<class T> class OrderedIndex;
+class CompositeIndex;
+class StringHashIndex;
+class Mixed;
+class GroupBy;
+class QueryCursor;
 
 class Query {
 public:
@@ -77,6 +76,45 @@ public:
     // Find links that point to a specific target row 
     Query& links_to(size_t column_ndx, size_t target_row);
 
+    // Find links that point to any of the specified target rows
+    Query& links_to(size_t column_ndx, const std::vector<size_t>& target_rows);
+
+    // Conditions: IN-list. Matches rows whose value is any of the listed
+    // values. Integer lists apply to integer, bool and DateTime columns.
+    Query& in(size_t column_ndx, const std::vector<int64_t>& values);
+    Query& in(size_t column_ndx, const std::vector<StringData>& values);
+
+    // Conditions: full-text. Matches rows whose indexed column contains all
+    // the words in text (see FullTextIndex::find_all()). Defined in
+    // fulltext_index.hpp.
+    Query& contains_words(FullTextIndex& index, StringData text);
+
+    // Conditions: ranges answered from an OrderedIndex on the column, where T
+    // is int64_t, float, double or DateTime. The overloads below that take a
+    // column index never consult such an index. Defined in
+    // index_ordered.hpp.
+    // T is deduced from the index alone, so the values convert to it.
+    template<class T> Query& greater(OrderedIndex<T>& index, typename OrderedIndex<T>::value_type value);
+    template<class T> Query& greater_equal(OrderedIndex<T>& index, typename OrderedIndex<T>::value_type value);
+    template<class T> Query& less(OrderedIndex<T>& index, typename OrderedIndex<T>::value_type value);
+    template<class T> Query& less_equal(OrderedIndex<T>& index, typename OrderedIndex<T>::value_type value);
+    template<class T> Query& between(OrderedIndex<T>& index, typename OrderedIndex<T>::value_type from,
+                                     typename OrderedIndex<T>::value_type to);
+
+    // Conditions: rows whose leading columns in a CompositeIndex equal
+    // prefix, optionally with a range on the column that follows. Defined in
+    // index_composite.hpp.
+    Query& equal(CompositeIndex& index, const std::vector<Mixed>& prefix);
+    Query& greater(CompositeIndex& index, const std::vector<Mixed>& prefix, Mixed value);
+    Query& greater_equal(CompositeIndex& index, const std::vector<Mixed>& prefix, Mixed value);
+    Query& less(CompositeIndex& index, const std::vector<Mixed>& prefix, Mixed value);
+    Query& less_equal(CompositeIndex& index, const std::vector<Mixed>& prefix, Mixed value);
+    Query& between(CompositeIndex& index, const std::vector<Mixed>& prefix, Mixed from, Mixed to);
+
+    // Conditions: equality answered from a StringHashIndex on the column.
+    // Defined in index_string_hash.hpp.
+    Query& equal(StringHashIndex& index, StringData value);
+
     // Conditions: int64_t
     Query& equal(size_t column_ndx, int64_t value);
     Query& not_equal(size_t column_ndx, int64_t value);
@@ -157,6 +195,16 @@ public:
     Query& ends_with(size_t column_ndx, StringData value, bool case_sensitive=true);
     Query& contains(size_t column_ndx, StringData value, bool case_sensitive=true);
 
+    // Like begins_with(), but the matching rows are looked up in the search
+    // index of the column, if it has one, instead of found by a scan.
+    Query& begins_with_indexed(size_t column_ndx, StringData value);
+
+    // Like equal(), case sensitive, but on an enumerated column (see
+    // Table::optimize()) without a search index, the value is resolved to its
+    // key index once, and the integer key indexes are searched instead of the
+    // strings.
+    Query& equal_enumerated(size_t column_ndx, StringData value);
+
     // These are shortcuts for equal(StringData(c_str)) and
     // not_equal(StringData(c_str)), and are needed to avoid unwanted
     // implicit conversion of char* to bool.
@@ -191,6 +239,43 @@ public:
     TableView      find_all(size_t start = 0, size_t end=size_t(-1), size_t limit = size_t(-1));
     ConstTableView find_all(size_t start = 0, size_t end=size_t(-1), size_t limit = size_t(-1)) const;
 
+    // Top-K. Returns the first k matches in the order given by the sort
+    // column(s): the rows that find_all() followed by TableViewBase::sort()
+    // would start with, but without materializing and sorting all matches.
+    // Rows that sort equal keep their table order. The returned view holds
+    // the query and the sort order, so sync_if_needed() after a change
+    // re-runs the query and leaves all of its matches in sort order, not
+    // just the first k. Call find_top_k() again to get the first k.
+    TableView      find_top_k(size_t column_ndx, bool ascending, size_t k, size_t start = 0,
+                              size_t end=size_t(-1));
+    ConstTableView find_top_k(size_t column_ndx, bool ascending, size_t k, size_t start = 0,
+                              size_t end=size_t(-1)) const;
+    TableView      find_top_k(std::vector<size_t> column_ndxs, std::vector<bool> ascending, size_t k,
+                              size_t start = 0, size_t end=size_t(-1));
+    ConstTableView find_top_k(std::vector<size_t> column_ndxs, std::vector<bool> ascending, size_t k,
+                              size_t start = 0, size_t end=size_t(-1)) const;
+
+    // Returns all matches ordered by the column of the index, like find_all()
+    // followed by TableViewBase::sort(), but reading the order from the index
+    // instead of sorting. Defined in index_ordered.hpp.
+    template<class T> TableView find_all_sorted(OrderedIndex<T>& index, bool ascending = true);
+
+    // Returns the matches among the rows whose leading columns in the index
+    // equal prefix, ordered by the remaining columns of the index. The view
+    // holds the query, restricted to the prefix, and is sorted by
+    // TableViewBase::sort() on the remaining columns when it is brought up
+    // to date; that orders strings by collation rather than by bytes, as the
+    // index does. Defined in index_composite.hpp.
+    TableView find_all_sorted(CompositeIndex& index, const std::vector<Mixed>& prefix, bool ascending = true);
+
+    // Returns a cursor that finds the matches one leaf at a time as they are
+    // asked for, instead of all of them up front like find_all(). Defined in
+    // query_cursor.hpp.
+    QueryCursor find_cursor(size_t start = 0, size_t end=size_t(-1)) const;
+
+    // Group the matching rows. Defined in group_by.hpp
+    void group_by(const GroupBy&, Table& result) const;
+
     // Aggregates
     size_t count(size_t start = 0, size_t end=size_t(-1), size_t limit = size_t(-1)) const;
 
@@ -239,12 +324,45 @@ public:
     // Deletion
     size_t  remove(size_t start = 0, size_t end=size_t(-1), size_t limit = size_t(-1));
 
-#if REALM_MULTITHREAD_QUERY
-    // Multi-threading
-    TableView      find_all_multi(size_t start = 0, size_t end=size_t(-1));
-    ConstTableView find_all_multi(size_t start = 0, size_t end=size_t(-1)) const;
-    int            set_threads(unsigned int threadcount);
-#endif
+    // Multi-threading. The row range is split into chunks aligned to B+-tree
+    // leaves, and idle worker threads take the next unsearched chunk. Each
+    // worker runs its own copy of the query, and results are merged in row
+    // order, so they are identical to those of the single-threaded functions
+    // above, except for float and double sums and averages: these add up the
+    // sums of the chunks, which rounds differently from adding the values one
+    // by one, so they may differ in the last bits. Queries restricted by a
+    // view, and ranges too small to split, are run on the calling thread. A
+    // threadcount of 0 means one thread per hardware thread.
+    TableView      find_all_multi(size_t start = 0, size_t end=size_t(-1), unsigned int threadcount = 0);
+    ConstTableView find_all_multi(size_t start = 0, size_t end=size_t(-1), unsigned int threadcount = 0) const;
+    size_t         count_multi(size_t start = 0, size_t end=size_t(-1), unsigned int threadcount = 0) const;
+
+    int64_t sum_int_multi(size_t column_ndx, size_t* resultcount = 0, size_t start = 0, size_t end = size_t(-1),
+                          unsigned int threadcount = 0) const;
+    double  average_int_multi(size_t column_ndx, size_t* resultcount = 0, size_t start = 0,
+                              size_t end = size_t(-1), unsigned int threadcount = 0) const;
+    int64_t maximum_int_multi(size_t column_ndx, size_t* resultcount = 0, size_t start = 0, size_t end = size_t(-1),
+                              size_t* return_ndx = 0, unsigned int threadcount = 0) const;
+    int64_t minimum_int_multi(size_t column_ndx, size_t* resultcount = 0, size_t start = 0, size_t end = size_t(-1),
+                              size_t* return_ndx = 0, unsigned int threadcount = 0) const;
+
+    double sum_float_multi(size_t column_ndx, size_t* resultcount = 0, size_t start = 0, size_t end = size_t(-1),
+                           unsigned int threadcount = 0) const;
+    double average_float_multi(size_t column_ndx, size_t* resultcount = 0, size_t start = 0,
+                               size_t end = size_t(-1), unsigned int threadcount = 0) const;
+    float  maximum_float_multi(size_t column_ndx, size_t* resultcount = 0, size_t start = 0, size_t end = size_t(-1),
+                               size_t* return_ndx = 0, unsigned int threadcount = 0) const;
+    float  minimum_float_multi(size_t column_ndx, size_t* resultcount = 0, size_t start = 0, size_t end = size_t(-1),
+                               size_t* return_ndx = 0, unsigned int threadcount = 0) const;
+
+    double sum_double_multi(size_t column_ndx, size_t* resultcount = 0, size_t start = 0,
+                            size_t end = size_t(-1), unsigned int threadcount = 0) const;
+    double average_double_multi(size_t column_ndx, size_t* resultcount = 0, size_t start = 0,
+                                size_t end = size_t(-1), unsigned int threadcount = 0) const;
+    double maximum_double_multi(size_t column_ndx, size_t* resultcount = 0, size_t start = 0, size_t end = size_t(-1),
+                                size_t* return_ndx = 0, unsigned int threadcount = 0) const;
+    double minimum_double_multi(size_t column_ndx, size_t* resultcount = 0, size_t start = 0, size_t end = size_t(-1),
+                                size_t* return_ndx = 0, unsigned int threadcount = 0) const;
 
     TableRef& get_table() {return m_table;}
 
@@ -335,6 +453,34 @@ private:
     void find_all(TableViewBase& tv, size_t start = 0, size_t end=size_t(-1), size_t limit = size_t(-1)) const;
     void delete_nodes() REALM_NOEXCEPT;
 
+    // Multi-threading helpers. split_multi() resolves 'end' and computes the
+    // chunk layout, returning false if the range should be searched
+    // single-threaded. execute_multi() calls func(query, chunk_start,
+    // chunk_end, chunk_ndx) for every chunk on the worker threads.
+    // aggregate_multi() drives the workers' copies of the node tree with
+    // FindInternal(), and reads the values of the matches with get_value(row).
+    struct MultiChunks {
+        size_t base;
+        size_t chunk_size;
+        size_t chunk_count;
+        unsigned int threads;
+    };
+    bool split_multi(size_t start, size_t& end, unsigned int threadcount, MultiChunks& chunks) const;
+    template<class F> void execute_multi(size_t start, size_t end, const MultiChunks& chunks, F func) const;
+    template<Action action, class R, class G>
+    R aggregate_multi(G get_value, size_t* resultcount, size_t start, size_t end, size_t* return_ndx,
+                      const MultiChunks& chunks) const;
+    void find_all_multi(TableViewBase& tv, size_t start, size_t end, unsigned int threadcount) const;
+
+    void find_top_k(TableViewBase& tv, RowIndexes::Sorter& order, size_t k, size_t start, size_t end) const;
+
+    template<class T>
+    Query& add_ordered_index_condition(OrderedIndex<T>& index, T lower, bool has_lower, bool lower_inclusive,
+                                       T upper, bool has_upper, bool upper_inclusive);
+    Query& add_composite_index_condition(CompositeIndex& index, const std::vector<Mixed>& prefix, Mixed lower,
+                                         bool has_lower, bool lower_inclusive, Mixed upper, bool has_upper,
+                                         bool upper_inclusive);
+
     void set_table(TableRef tr) { m_table = tr; }
     bool supports_export_for_handover() { return m_view == 0; };
     std::string error_code;
@@ -344,6 +490,10 @@ private:
     friend class XQueryAccessorInt;
     friend class XQueryAccessorString;
     friend class TableViewBase;
+    friend class ViewUpdater;
+    friend class GroupBy;
+    friend class QueryCursor;
+    friend class PreparedQuery;
 
     // At most one of these can be non-zero, and if so the non-zero one indicates the restricting view.
     LinkViewRef m_source_link_view; // link views are refcounted and shared.
@@ -88,7 +88,7 @@ struct ContainsIns {
         if (v1.size() == 0 && !v2.is_null())
             return true;
 
-        return search_case_fold(v2, v1_upper, v1_lower, v1.size()) != v2.size();
+        return search(v2, v1_upper, v1_lower, v1.size()) != v2.size();
     }
 
     // Slow version, used if caller hasn't stored an upper and lower case version
@@ -102,7 +102,19 @@ struct ContainsIns {
 
         std::string v1_upper = case_map(v1, true);
         std::string v1_lower = case_map(v1, false);
-        return search_case_fold(v2, v1_upper.c_str(), v1_lower.c_str(), v1.size()) != v2.size();
+        return search(v2, v1_upper.c_str(), v1_lower.c_str(), v1.size()) != v2.size();
+    }
+
+    // Same result as search_case_fold(). The bytes of an all-ASCII needle can only match ASCII bytes of the
+    // haystack, so for such needles the comparison is byte-wise and can use the vectorized search.
+    static std::size_t search(StringData haystack, const char* needle_upper, const char* needle_lower,
+                              std::size_t needle_size)
+    {
+        for (std::size_t i = 0; i < needle_size; ++i) {
+            if (static_cast<unsigned char>(needle_upper[i] | needle_lower[i]) >= 0x80)
+                return search_case_fold(haystack, needle_upper, needle_lower, needle_size);
+        }
+        return _impl::search_bytes(haystack.data(), haystack.size(), needle_upper, needle_lower, needle_size);
     }
 
     static const int condition = -1;
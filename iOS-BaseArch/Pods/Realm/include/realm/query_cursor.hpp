@@ -0,0 +1,241 @@
+/*************************************************************************
+ *
+ * REALM CONFIDENTIAL
+ * __________________
+ *
+ *  [2011] - [2015] Realm Inc
+ *  All Rights Reserved.
+ *
+ * NOTICE:  All information contained herein is, and remains
+ * the property of Realm Incorporated and its suppliers,
+ * if any.  The intellectual and technical concepts contained
+ * herein are proprietary to Realm Incorporated
+ * and its suppliers and may be covered by U.S. and Foreign Patents,
+ * patents in process, and are protected by trade secret or copyright law.
+ * Dissemination of this information or reproduction of this material
+ * is strictly forbidden unless prior written permission is obtained
+ * from Realm Incorporated.
+ *
+ **************************************************************************/
+#ifndef REALM_QUERY_CURSOR_HPP
+#define REALM_QUERY_CURSOR_HPP
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include <realm/table.hpp>
+#include <realm/table_view.hpp>
+#include <realm/query.hpp>
+
+namespace realm {
+
+/// The matches of a query, found on demand.
+///
+/// Query::find_all() searches the whole range before the caller sees the
+/// first match. A cursor instead searches one leaf (REALM_MAX_BPNODE_SIZE
+/// rows) at a time, and only as far as the matches asked for, so showing the
+/// first screen of a large result costs a scan of the first few leaves. The
+/// search resumes where it stopped with the same node tree, so the leaf
+/// caches and statistics of the nodes carry over between batches. The total
+/// number of matches is only counted when size() is called, and the rows
+/// after those fetched are counted without being stored.
+///
+/// The cursor holds its own copy of the query. Like a TableView in
+/// reflective mode, it must be brought up to date with sync_if_needed()
+/// after the table has changed, which starts the search over. Until then,
+/// the matches found so far would belong to one version of the table and
+/// the rest to another, so get_source_ndx(), fetch() and size() throw
+/// LogicError::illegal_combination. Queries that are restricted by a view
+/// are searched in full up front, because their matches do not come in
+/// table order.
+///
+/// Changes to the table can only be detected when replication is enabled
+/// (REALM_ENABLE_REPLICATION). Otherwise the table must not be changed
+/// while the cursor is in use; create a new cursor after a change instead.
+///
+/// The query must be attached to a table.
+class QueryCursor {
+public:
+    explicit QueryCursor(const Query& query, std::size_t start = 0, std::size_t end = std::size_t(-1));
+
+    /// The table row of match \a match_ndx, searching on as far as needed.
+    /// Returns not_found if there are no more than \a match_ndx matches.
+    std::size_t get_source_ndx(std::size_t match_ndx);
+
+    /// Make the first \a num_matches matches available, and return how many
+    /// there are, which is less only when the search is complete.
+    std::size_t fetch(std::size_t num_matches);
+
+    /// The number of matches found so far.
+    std::size_t num_fetched() const REALM_NOEXCEPT;
+
+    /// Whether the whole range has been searched.
+    bool is_complete() const REALM_NOEXCEPT;
+
+    /// The total number of matches. Computed on the first call.
+    std::size_t size();
+
+    const Table& get_parent() const REALM_NOEXCEPT;
+
+#ifdef REALM_ENABLE_REPLICATION
+    bool is_in_sync() const REALM_NOEXCEPT;
+
+    /// Start the search over if the table has changed. Returns the version
+    /// of the table that the cursor is now in sync with.
+    uint_fast64_t sync_if_needed();
+#endif
+
+private:
+    std::unique_ptr<Query> m_query;
+    TableRef m_table;
+    std::size_t m_start;
+    std::size_t m_end;
+    std::size_t m_resolved_end;
+    std::size_t m_next_row;
+    std::size_t m_size;
+    std::vector<std::size_t> m_rows;
+#ifdef REALM_ENABLE_REPLICATION
+    uint_fast64_t m_version;
+#endif
+
+    void reset();
+    void check_in_sync() const;
+    bool fetch_batch();
+};
+
+
+
+
+// Implementation:
+
+inline QueryCursor::QueryCursor(const Query& query, std::size_t start, std::size_t end):
+    m_query(new Query(query, Query::TCopyExpressionTag())), // Throws
+    m_table(query.m_table),
+    m_start(start),
+    m_end(end)
+{
+    if (!m_table || !m_table->is_attached())
+        throw LogicError(LogicError::detached_accessor);
+    reset(); // Throws
+}
+
+inline void QueryCursor::reset()
+{
+    m_rows.clear();
+    m_size = npos;
+#ifdef REALM_ENABLE_REPLICATION
+    m_version = m_table->m_version;
+#endif
+
+    // The matches of a restricting view are not in table order, so they
+    // cannot be resumed by row
+    if (m_query->m_view) {
+        ConstTableView view = m_query->find_all(m_start, m_end); // Throws
+        for (std::size_t i = 0; i < view.size(); ++i)
+            m_rows.push_back(view.get_source_ndx(i)); // Throws
+        m_resolved_end = m_next_row = 0;
+        m_size = m_rows.size();
+        return;
+    }
+
+    m_resolved_end = m_end == std::size_t(-1) ? m_table->size() : m_end;
+    m_next_row = std::min(m_start, m_resolved_end);
+    m_query->Init(*m_table);
+}
+
+inline void QueryCursor::check_in_sync() const
+{
+#ifdef REALM_ENABLE_REPLICATION
+    if (REALM_UNLIKELY(!is_in_sync()))
+        throw LogicError(LogicError::illegal_combination);
+#endif
+}
+
+inline bool QueryCursor::fetch_batch()
+{
+    if (m_next_row >= m_resolved_end)
+        return false;
+
+    // Search up to the end of the leaf that holds the next row
+    const std::size_t leaf_size = REALM_MAX_BPNODE_SIZE;
+    std::size_t batch_end = std::min(m_resolved_end, (m_next_row / leaf_size + 1) * leaf_size);
+    for (std::size_t row_ndx = m_next_row; row_ndx < batch_end; ++row_ndx) {
+        row_ndx = m_query->FindInternal(row_ndx, batch_end);
+        if (row_ndx == not_found)
+            break;
+        m_rows.push_back(row_ndx); // Throws
+    }
+    m_next_row = batch_end;
+    return true;
+}
+
+inline std::size_t QueryCursor::fetch(std::size_t num_matches)
+{
+    check_in_sync(); // Throws
+    while (m_rows.size() < num_matches && fetch_batch()) {} // Throws
+    return std::min(num_matches, m_rows.size());
+}
+
+inline std::size_t QueryCursor::get_source_ndx(std::size_t match_ndx)
+{
+    if (fetch(match_ndx + 1) <= match_ndx) // Throws
+        return not_found;
+    return m_rows[match_ndx];
+}
+
+inline std::size_t QueryCursor::num_fetched() const REALM_NOEXCEPT
+{
+    return m_rows.size();
+}
+
+inline bool QueryCursor::is_complete() const REALM_NOEXCEPT
+{
+    return m_next_row >= m_resolved_end;
+}
+
+inline std::size_t QueryCursor::size()
+{
+    check_in_sync(); // Throws
+    if (m_size == npos) {
+        // The rest is counted by a separate copy, so that the search of this
+        // one can go on where it stopped
+        std::size_t rest = 0;
+        if (m_next_row < m_resolved_end) {
+            Query counter(*m_query, Query::TCopyExpressionTag()); // Throws
+            rest = counter.count(m_next_row, m_resolved_end);
+        }
+        m_size = m_rows.size() + rest;
+    }
+    return m_size;
+}
+
+inline const Table& QueryCursor::get_parent() const REALM_NOEXCEPT
+{
+    return *m_table;
+}
+
+#ifdef REALM_ENABLE_REPLICATION
+
+inline bool QueryCursor::is_in_sync() const REALM_NOEXCEPT
+{
+    return m_version == m_table->m_version;
+}
+
+inline uint_fast64_t QueryCursor::sync_if_needed()
+{
+    if (!is_in_sync())
+        reset(); // Throws
+    return m_version;
+}
+
+#endif
+
+inline QueryCursor Query::find_cursor(std::size_t start, std::size_t end) const
+{
+    return QueryCursor(*this, start, end); // Throws
+}
+
+} // namespace realm
+
+#endif // REALM_QUERY_CURSOR_HPP
@@ -110,6 +110,9 @@ AggregateState      State of the aggregate - contains a state variable that stor
 
 #include <iostream>
 #include <map>
+#include <atomic>
+#include <cstring>
+#include <unordered_set>
 
 #if _MSC_FULL_VER >= 160040219
 #  include <immintrin.h>
@@ -285,6 +288,165 @@ private:
 };
 
 
+// The value list of an IN-list condition. Short lists are compared linearly against a sorted copy, which beats
+// hashing for a handful of values; longer lists are looked up in a hash set. Values outside [min, max] of the list are
+// rejected before either.
+class IntegerValueSet {
+public:
+    IntegerValueSet() {}
+
+    IntegerValueSet(std::vector<int64_t> values) : m_values(std::move(values))
+    {
+        std::sort(m_values.begin(), m_values.end());
+        m_values.erase(std::unique(m_values.begin(), m_values.end()), m_values.end());
+        if (!m_values.empty()) {
+            m_min = m_values.front();
+            m_max = m_values.back();
+        }
+        if (m_values.size() > linear_limit)
+            m_set.insert(m_values.begin(), m_values.end());
+    }
+
+    REALM_FORCEINLINE bool contains(int64_t v) const
+    {
+        if (v < m_min || v > m_max)
+            return false;
+        if (m_values.size() > linear_limit)
+            return m_set.count(v) != 0;
+        bool found = false;
+        for (size_t t = 0; t < m_values.size(); ++t)
+            found |= (m_values[t] == v);
+        return found;
+    }
+
+    // Index of the first element of leaf[begin, end) that is in the set, or not_found
+    size_t find_first(const ArrayInteger& leaf, size_t begin, size_t end) const
+    {
+        int64_t chunk[8];
+        for (; begin + 8 <= end; begin += 8) {
+            leaf.get_chunk(begin, chunk);
+            for (size_t t = 0; t < 8; ++t) {
+                if (contains(chunk[t]))
+                    return begin + t;
+            }
+        }
+        for (; begin < end; ++begin) {
+            if (contains(leaf.get(begin)))
+                return begin;
+        }
+        return not_found;
+    }
+
+    // Nulls are never in the set
+    size_t find_first(const ArrayIntNull& leaf, size_t begin, size_t end) const
+    {
+        for (; begin < end; ++begin) {
+            if (!leaf.is_null(begin) && contains(leaf.get(begin)))
+                return begin;
+        }
+        return not_found;
+    }
+
+    size_t size() const REALM_NOEXCEPT
+    {
+        return m_values.size();
+    }
+
+private:
+    static const size_t linear_limit = 16;
+
+    std::vector<int64_t> m_values;
+    std::unordered_set<int64_t> m_set;
+    int64_t m_min = 1;
+    int64_t m_max = 0; // Empty range until values are added
+};
+
+
+// Match distances (m_dD) learned by earlier executions of a condition. A node that is seeded from here starts out
+// ranked where the previous runs left it, instead of relearning its selectivity from a fixed default by probing on
+// every execution. Entries are keyed by the allocator of the group (so that tables of different files, or of different
+// opens of one file, do not share entries), the table's index in that group, the column, the condition and the
+// magnitude of the constant, so that `== 1` and `== 999` are learned separately. Tables that are not part of a group
+// are not tracked. A node records its estimate once per Init(), after it has scanned a leaf worth of rows or reached
+// the end of the table, so the hot path of the search does not touch the entries. The entries are a fixed array of atomic slots, so no lock is taken; keys that land in the same slot replace
+// each other, which costs no more than the probing that the entry saves.
+class QueryStatistics {
+public:
+    static bool get_match_distance(const Table& table, size_t column, int condition, int64_t value,
+                                   double& dD) REALM_NOEXCEPT
+    {
+        uint_fast64_t key = get_key(table, column, condition, value);
+        if (key == 0)
+            return false;
+        uint_fast64_t slot = get_slots()[key % num_slots].load(std::memory_order_relaxed);
+        if (slot >> 32 != key >> 32)
+            return false;
+        float f;
+        uint32_t bits = uint32_t(slot);
+        std::memcpy(&f, &bits, sizeof f);
+        dD = f;
+        return true;
+    }
+
+    static void set_match_distance(const Table& table, size_t column, int condition, int64_t value,
+                                   double dD) REALM_NOEXCEPT
+    {
+        uint_fast64_t key = get_key(table, column, condition, value);
+        if (key == 0)
+            return;
+        std::atomic<uint64_t>& slot = get_slots()[key % num_slots];
+
+        // Blend with the previous runs so that one unusual execution (e.g. over a short range) does not overturn the
+        // ordering learned so far
+        double previous;
+        if (get_match_distance(table, column, condition, value, previous))
+            dD = (previous + dD) / 2;
+        float f = float(dD);
+        uint32_t bits;
+        std::memcpy(&bits, &f, sizeof bits);
+        slot.store((key >> 32 << 32) | bits, std::memory_order_relaxed);
+    }
+
+private:
+    static const size_t num_slots = 1024;
+
+    // Returns 0 for tables that are not tracked
+    static uint_fast64_t get_key(const Table& table, size_t column, int condition, int64_t value) REALM_NOEXCEPT
+    {
+        size_t table_ndx = table.get_index_in_group();
+        if (table_ndx == npos)
+            return 0;
+
+        // Sign and bit length of the constant
+        uint64_t magnitude = value < 0 ? ~uint64_t(value) : uint64_t(value);
+        uint64_t range = 0;
+        while (magnitude != 0) {
+            magnitude >>= 1;
+            ++range;
+        }
+        range = range * 2 + (value < 0 ? 1 : 0);
+
+        // FNV-1a over the parts of the key
+        uint64_t alloc = uint64_t(reinterpret_cast<uintptr_t>(&table.get_alloc()));
+        uint64_t parts[] = { alloc, uint64_t(table_ndx), uint64_t(column), uint64_t(condition), range };
+        uint64_t h = 14695981039346656037ULL;
+        for (uint64_t part : parts) {
+            for (int i = 0; i < 8; ++i) {
+                h ^= (part >> (8 * i)) & 0xFF;
+                h *= 1099511628211ULL;
+            }
+        }
+        return h | (uint64_t(1) << 63); // Never 0
+    }
+
+    static std::atomic<uint64_t>* get_slots() REALM_NOEXCEPT
+    {
+        static std::atomic<uint64_t> slots[num_slots];
+        return slots;
+    }
+};
+
+
 class ParentNode {
     typedef ParentNode ThisType;
 public:
@@ -657,6 +819,7 @@ public:
     size_t m_local_matches;
     size_t m_local_limit;
     bool m_fastmode_disabled;
+    bool m_statistics_recorded; // Fills the padding before m_TAction, so the layout is unchanged
     Action m_TAction;
 
     QueryStateBase* m_state;
@@ -695,9 +858,12 @@ public:
     {
         IntegerNodeBase::init(table);
         m_dD = 100.0;
+        QueryStatistics::get_match_distance(table, m_condition_column_idx, TConditionFunction::condition,
+                                            int64_t(m_value), m_dD);
         m_condition_column = static_cast<const ColType*>(&get_column_base(table, m_condition_column_idx));
         m_table = &table;
         m_leaf_end = 0;
+        m_statistics_recorded = false;
         if (m_child)
             m_child->init(table);
     }
@@ -806,14 +972,22 @@ public:
             s = end2 + m_leaf_start;
         }
 
+        size_t next;
         if (m_local_matches == m_local_limit) {
             m_dD = (m_last_local_match + 1 - start) / (m_local_matches + 1.0);
-            return m_last_local_match + 1;
+            next = m_last_local_match + 1;
         }
         else {
             m_dD = (end - start) / (m_local_matches + 1.0);
-            return end;
+            next = end;
+        }
+        // Short probes say little about the selectivity, so the estimate is recorded once enough rows were seen
+        if (!m_statistics_recorded && (next - start >= REALM_MAX_BPNODE_SIZE || next >= m_table->size())) {
+            QueryStatistics::set_match_distance(*m_table, m_condition_column_idx, TConditionFunction::condition,
+                                                int64_t(m_value), m_dD);
+            m_statistics_recorded = true;
         }
+        return next;
     }
 
     size_t find_first_local(size_t start, size_t end) override
@@ -881,6 +1055,63 @@ protected:
 
 
 
+// IN-list condition for integer, bool and DateTime columns; matches rows whose value is any of a list of values
+template <class ColType> class IntegerInNode: public ParentNode {
+public:
+    IntegerInNode(const std::vector<int64_t>& values, size_t column_ndx) : m_values(values)
+    {
+        m_condition_column_idx = column_ndx;
+        m_child = nullptr;
+        m_dT = m_values.size() > 16 ? 2.0 : 1.0;
+    }
+    ~IntegerInNode() REALM_NOEXCEPT override {}
+
+    void init(const Table& table) override
+    {
+        // A list of n values matches roughly n times as often as an equality condition
+        m_dD = 100.0 / (m_values.size() + 1.0);
+        m_table = &table;
+        m_condition_column.init(static_cast<const ColType*>(&get_column_base(table, m_condition_column_idx)));
+
+        if (m_child)
+            m_child->init(table);
+    }
+
+    size_t find_first_local(size_t start, size_t end) override
+    {
+        if (m_values.size() == 0)
+            return not_found;
+
+        while (start < end) {
+            m_condition_column.cache_next(start);
+            size_t f = m_values.find_first(*m_condition_column.m_leaf_ptr, start - m_condition_column.m_leaf_start,
+                                           m_condition_column.local_end(end));
+            if (f != not_found)
+                return f + m_condition_column.m_leaf_start;
+            start = m_condition_column.m_leaf_end;
+        }
+        return not_found;
+    }
+
+    ParentNode* clone() override
+    {
+        return new IntegerInNode(*this);
+    }
+
+    IntegerInNode(const IntegerInNode& from)
+        : ParentNode(from)
+    {
+        m_values = from.m_values;
+        m_child = from.m_child;
+        // m_condition_column is not copied
+    }
+
+protected:
+    IntegerValueSet m_values;
+    SequentialGetter<ColType> m_condition_column;
+};
+
+
 // This node is currently used for floats and doubles only
 template <class ColType, class TConditionFunction> class FloatDoubleNode: public ParentNode {
 public:
@@ -1185,6 +1416,53 @@ protected:
 
 
 
+// BeginsWith on a column with a search index. A prefix selects a key range of
+// the index, so only the rows in that range need to be looked at. This is a
+// separate node, created by Query::begins_with_indexed(), because the layout of
+// StringNode<BeginsWith> is fixed by Query::begins_with().
+class StringPrefixIndexNode: public StringNode<BeginsWith> {
+public:
+    StringPrefixIndexNode(StringData v, size_t column): StringNode<BeginsWith>(v, column)
+    {
+    }
+
+    void init(const Table& table) override
+    {
+        StringNode<BeginsWith>::init(table);
+
+        m_dT = 10.0;
+        m_index_rows.clear();
+        m_use_index = m_condition_column->has_search_index();
+        if (m_use_index) {
+            m_condition_column->get_search_index()->find_all_prefix(m_value, m_index_rows);
+            m_dT = 0.0;
+            m_dD = (table.size() + 1.0) / (m_index_rows.size() + 1.0);
+        }
+    }
+
+    size_t find_first_local(size_t start, size_t end) override
+    {
+        if (!m_use_index)
+            return StringNode<BeginsWith>::find_first_local(start, end);
+
+        std::vector<size_t>::const_iterator it = std::lower_bound(m_index_rows.begin(), m_index_rows.end(), start);
+        if (it == m_index_rows.end() || *it >= end)
+            return not_found;
+        return *it;
+    }
+
+    ParentNode* clone() override
+    {
+        return new StringPrefixIndexNode(*this);
+    }
+
+private:
+    bool m_use_index = false;
+    std::vector<size_t> m_index_rows;
+};
+
+
+
 // Specialization for Equal condition on Strings - we specialize because we can utilize indexes (if they exist) for Equal.
 // Future optimization: make specialization for greater, notequal, etc
 template<> class StringNode<Equal>: public StringNodeBase {
@@ -1271,6 +1549,10 @@ public:
                 m_index_size = m_index_getter->m_column->size();
             }
 
+            // The index tells us the exact number of matches, so there is no need to guess the match distance and
+            // have a linear scan of another condition chosen ahead of this (free) index lookup
+            m_dD = (table.size() + 1.0) / (m_index_size + 1.0);
+
         }
         else if (m_column_type != col_type_String) {
             REALM_ASSERT_DEBUG(dynamic_cast<const ColumnStringEnum*>(m_condition_column));
@@ -1398,6 +1680,276 @@ private:
     size_t m_last_start;
 };
 
+
+
+// Equal on a string column that is usually enumerated (see Table::optimize()). The value is resolved to its key index
+// once per init(), and the key indexes of the column are then searched like an integer column, with Array::find() and
+// the fast paths of IntegerNode for count() and other aggregates. When the column has a search index or is not
+// enumerated when the query runs, the condition is evaluated by StringNode<Equal> instead. This is a separate node,
+// created by Query::equal_enumerated(), because the layout of StringNode<Equal> is fixed by Query::equal().
+class EnumStringEqualNode: public IntegerNode<int64_t, Equal> {
+public:
+    EnumStringEqualNode(StringData v, size_t column):
+        IntegerNode<int64_t, Equal>(0, column),
+        m_string_node(new StringNode<Equal>(v, column)), // Throws
+        m_string(v.data(), v.size()), // Throws
+        m_is_null(v.is_null())
+    {
+    }
+
+    EnumStringEqualNode(const EnumStringEqualNode& from):
+        IntegerNode<int64_t, Equal>(from),
+        m_string_node(new StringNode<Equal>(*from.m_string_node)), // Throws
+        m_string(from.m_string), // Throws
+        m_is_null(from.m_is_null)
+    {
+    }
+
+    ~EnumStringEqualNode() REALM_NOEXCEPT override {}
+
+    void init(const Table& table) override
+    {
+        const ColumnBase& column = get_column_base(table, m_condition_column_idx);
+        const ColumnStringEnum* cse = dynamic_cast<const ColumnStringEnum*>(&column);
+        m_use_codes = cse && !m_is_null && !cse->has_search_index();
+        if (m_use_codes) {
+            // Key indexes are never negative, so -1 matches no row
+            size_t key_ndx = cse->GetKeyNdx(StringData(m_string));
+            m_value = key_ndx == not_found ? -1 : int64_t(key_ndx);
+            IntegerNode<int64_t, Equal>::init(table);
+            return;
+        }
+
+        m_string_node->init(table);
+        m_dD = m_string_node->m_dD;
+        m_dT = m_string_node->m_dT;
+        m_table = &table;
+        if (m_child)
+            m_child->init(table);
+    }
+
+    void aggregate_local_prepare(Action TAction, DataType col_id) override
+    {
+        IntegerNode<int64_t, Equal>::aggregate_local_prepare(TAction, col_id);
+        ParentNode::aggregate_local_prepare(TAction, col_id);
+    }
+
+    size_t aggregate_local(QueryStateBase* st, size_t start, size_t end, size_t local_limit,
+                           SequentialGetterBase* source_column) override
+    {
+        if (m_use_codes)
+            return IntegerNode<int64_t, Equal>::aggregate_local(st, start, end, local_limit, source_column);
+        return ParentNode::aggregate_local(st, start, end, local_limit, source_column);
+    }
+
+    size_t find_first_local(size_t start, size_t end) override
+    {
+        if (m_use_codes)
+            return IntegerNode<int64_t, Equal>::find_first_local(start, end);
+        return m_string_node->find_first_local(start, end);
+    }
+
+    ParentNode* clone() override
+    {
+        return new EnumStringEqualNode(*this);
+    }
+
+private:
+    std::unique_ptr<StringNode<Equal>> m_string_node;
+    std::string m_string;
+    bool m_is_null;
+    bool m_use_codes = false;
+};
+
+
+
+// IN-list condition for strings. With a search index, the rows of every listed value are looked up once per execution
+// and merged into one sorted row list. Enumerated columns compare key indexes instead of strings, and other columns
+// probe a hash set of the listed values.
+class StringInNode: public StringNodeBase {
+public:
+    StringInNode(const std::vector<StringData>& values, size_t column): StringNodeBase(StringData(), column)
+    {
+        for (size_t t = 0; t < values.size(); ++t) {
+            if (values[t].is_null())
+                m_has_null = true;
+            else
+                m_strings.push_back(std::string(values[t].data(), values[t].size()));
+        }
+        build_set();
+    }
+    ~StringInNode() REALM_NOEXCEPT override
+    {
+        clear_leaf_state();
+    }
+
+    void init(const Table& table) override
+    {
+        clear_leaf_state();
+        StringNodeBase::init(table);
+
+        m_index_rows.clear();
+        m_keys = IntegerValueSet();
+        size_t value_count = m_strings.size() + (m_has_null ? 1 : 0);
+
+        if (m_condition_column->has_search_index()) {
+            m_dT = 0.0;
+            for (size_t t = 0; t < m_strings.size(); ++t)
+                add_index_matches(StringData(m_strings[t]));
+            if (m_has_null)
+                add_index_matches(StringData());
+            std::sort(m_index_rows.begin(), m_index_rows.end());
+            m_index_rows.erase(std::unique(m_index_rows.begin(), m_index_rows.end()), m_index_rows.end());
+
+            // Exact, like for StringNode<Equal>
+            m_dD = (table.size() + 1.0) / (m_index_rows.size() + 1.0);
+        }
+        else if (m_column_type == col_type_StringEnum) {
+            m_dT = 1.0;
+            m_dD = 10.0 / (value_count + 1.0);
+            const ColumnStringEnum* cse = static_cast<const ColumnStringEnum*>(m_condition_column);
+            std::vector<int64_t> keys;
+            for (size_t t = 0; t < m_strings.size(); ++t) {
+                size_t key_ndx = cse->GetKeyNdx(StringData(m_strings[t]));
+                if (key_ndx != not_found)
+                    keys.push_back(key_ndx);
+            }
+            if (m_has_null) {
+                size_t key_ndx = cse->GetKeyNdx(StringData());
+                if (key_ndx != not_found)
+                    keys.push_back(key_ndx);
+            }
+            m_keys = IntegerValueSet(std::move(keys));
+            m_cse.init(cse);
+        }
+        else {
+            m_dT = 10.0;
+            m_dD = 10.0 / (value_count + 1.0);
+        }
+
+        if (m_child)
+            m_child->init(table);
+    }
+
+    size_t find_first_local(size_t start, size_t end) override
+    {
+        if (m_condition_column->has_search_index()) {
+            std::vector<size_t>::const_iterator it = std::lower_bound(m_index_rows.begin(), m_index_rows.end(), start);
+            if (it == m_index_rows.end() || *it >= end)
+                return not_found;
+            return *it;
+        }
+
+        if (m_column_type == col_type_StringEnum) {
+            if (m_keys.size() == 0)
+                return not_found; // none of the values are in the key set
+
+            while (start < end) {
+                m_cse.cache_next(start);
+                size_t f = m_keys.find_first(*m_cse.m_leaf_ptr, start - m_cse.m_leaf_start, m_cse.local_end(end));
+                if (f != not_found)
+                    return f + m_cse.m_leaf_start;
+                start = m_cse.m_leaf_end;
+            }
+            return not_found;
+        }
+
+        // Normal string column, with long or short leaf
+        const AdaptiveStringColumn* asc = static_cast<const AdaptiveStringColumn*>(m_condition_column);
+        for (size_t s = start; s < end; ++s) {
+            if (s >= m_leaf_end || s < m_leaf_start) {
+                clear_leaf_state();
+                std::size_t ndx_in_leaf;
+                m_leaf = asc->get_leaf(s, ndx_in_leaf, m_leaf_type);
+                m_leaf_start = s - ndx_in_leaf;
+                if (m_leaf_type == AdaptiveStringColumn::leaf_type_Small)
+                    m_leaf_end = m_leaf_start + static_cast<const ArrayString&>(*m_leaf).size();
+                else if (m_leaf_type ==  AdaptiveStringColumn::leaf_type_Medium)
+                    m_leaf_end = m_leaf_start + static_cast<const ArrayStringLong&>(*m_leaf).size();
+                else
+                    m_leaf_end = m_leaf_start + static_cast<const ArrayBigBlobs&>(*m_leaf).size();
+            }
+
+            StringData t;
+            if (m_leaf_type == AdaptiveStringColumn::leaf_type_Small)
+                t = static_cast<const ArrayString&>(*m_leaf).get(s - m_leaf_start);
+            else if (m_leaf_type ==  AdaptiveStringColumn::leaf_type_Medium)
+                t = static_cast<const ArrayStringLong&>(*m_leaf).get(s - m_leaf_start);
+            else
+                t = static_cast<const ArrayBigBlobs&>(*m_leaf).get_string(s - m_leaf_start);
+
+            if (t.is_null() ? m_has_null : m_set.count(t) != 0)
+                return s;
+        }
+        return not_found;
+    }
+
+    ParentNode* clone() override
+    {
+        return new StringInNode(*this);
+    }
+
+    StringInNode(const StringInNode& from) : StringNodeBase(from), m_strings(from.m_strings),
+                                             m_has_null(from.m_has_null)
+    {
+        build_set();
+    }
+
+private:
+    // FNV-1a
+    struct Hash {
+        size_t operator()(StringData s) const REALM_NOEXCEPT
+        {
+            uint_fast64_t h = 14695981039346656037ULL;
+            for (size_t t = 0; t < s.size(); ++t) {
+                h ^= static_cast<unsigned char>(s.data()[t]);
+                h *= 1099511628211ULL;
+            }
+            return size_t(h);
+        }
+    };
+
+    void build_set()
+    {
+        m_set.clear();
+        for (size_t t = 0; t < m_strings.size(); ++t)
+            m_set.insert(StringData(m_strings[t]));
+    }
+
+    void add_index_matches(StringData value)
+    {
+        FindRes fr;
+        size_t index_ref;
+        if (m_column_type == col_type_StringEnum)
+            fr = static_cast<const ColumnStringEnum*>(m_condition_column)->find_all_indexref(value, index_ref);
+        else
+            fr = static_cast<const AdaptiveStringColumn*>(m_condition_column)->find_all_indexref(value, index_ref);
+
+        if (fr == FindRes_single) {
+            m_index_rows.push_back(index_ref);
+        }
+        else if (fr == FindRes_column) {
+            // The row list is owned by the index, so it is only attached to, never destroyed
+            Column matches(Column::unattached_root_tag(), m_condition_column->get_alloc());
+            matches.get_root_array()->init_from_ref(index_ref);
+            size_t n = matches.size();
+            for (size_t t = 0; t < n; ++t)
+                m_index_rows.push_back(to_size_t(matches.get(t)));
+        }
+    }
+
+    std::vector<std::string> m_strings; // Owns the characters that m_set refers to
+    bool m_has_null = false;
+    std::unordered_set<StringData, Hash> m_set;
+
+    // Used for enum-string
+    IntegerValueSet m_keys;
+    SequentialGetter<ColumnStringEnum> m_cse;
+
+    // Used for index lookup
+    std::vector<size_t> m_index_rows;
+};
+
 // OR node contains at least two node pointers: Two or more conditions to OR
 // together in m_cond, and the next AND condition (if any) in m_child.
 //
@@ -1447,6 +1999,56 @@ public:
         m_table = &table;
     }
 
+    // When this is the leading condition, the matches of all the conditions are materialized into a bitmap for a
+    // window of rows at a time, so each condition scans the window once no matter how many conditions there are,
+    // and the matches are then taken from the bitmap. This replaces the default aggregate_local(), which calls
+    // find_first_local() once per match at a cost of one lookup per condition. The bitmap only lives for the
+    // duration of the call, so it is kept on the stack rather than in the node, and the window is sized from the
+    // match distance learned so far, so that a call that needs few matches does not scan much past them.
+    size_t aggregate_local(QueryStateBase* st, size_t start, size_t end, size_t local_limit,
+                           SequentialGetterBase* source_column) override
+    {
+        uint64_t bitmap[bitmap_words];
+        size_t local_matches = 0;
+
+        for (size_t s = start; s < end; ) {
+            double expected = m_dD * (local_limit - local_matches) * 1.5;
+            size_t window = expected >= double(bitmap_words * 64) ? bitmap_words * 64 :
+                std::max(bitmap_min_rows, size_t(expected));
+            size_t window_end = std::min(end, s + window);
+            materialize(bitmap, s, window_end);
+
+            for (size_t w = 0; w * 64 < window_end - s; ++w) {
+                for (uint64_t bits = bitmap[w]; bits != 0; bits &= bits - 1) {
+                    size_t r = s + w * 64 + first_set_bit(bits);
+                    ++local_matches;
+
+                    // Test the remaining conditions of the query, as in ParentNode::aggregate_local()
+                    size_t m = r;
+                    for (size_t c = 1; c < m_conds; ++c) {
+                        m = m_children[c]->find_first_local(r, r + 1);
+                        if (m != r)
+                            break;
+                    }
+                    if (m == r) {
+                        bool cont = (this->*m_column_action_specializer)(st, source_column, r);
+                        if (!cont)
+                            return not_found;
+                    }
+
+                    if (local_matches == local_limit) {
+                        m_dD = double(r + 1 - start) / (local_matches + 1.1);
+                        return r + 1;
+                    }
+                }
+            }
+            s = window_end;
+        }
+
+        m_dD = double(end - start) / (local_matches + 1.1);
+        return end;
+    }
+
     size_t find_first_local(size_t start, size_t end) override
     {
         if (start >= end)
@@ -1523,6 +2125,39 @@ private:
     // is a matching index if m_was_match is true
     std::vector<size_t> m_last;
     std::vector<bool> m_was_match;
+
+    static const size_t bitmap_min_rows = 64;
+    static const size_t bitmap_words = 64; // Up to 4096 rows per window
+
+    // Set bit i of bitmap if row start + i matches any of the conditions. Setting the bits of each condition into
+    // the same bitmap is the OR of them.
+    void materialize(uint64_t* bitmap, size_t start, size_t end)
+    {
+        std::fill(bitmap, bitmap + (end - start + 63) / 64, 0);
+        for (size_t c = 0; c < m_cond.size(); ++c) {
+            for (size_t s = start; s < end; ) {
+                size_t f = m_cond[c]->find_first(s, end);
+                if (f == not_found)
+                    break;
+                bitmap[(f - start) / 64] |= uint64_t(1) << ((f - start) % 64);
+                s = f + 1;
+            }
+        }
+    }
+
+    static size_t first_set_bit(uint64_t v) REALM_NOEXCEPT
+    {
+#if defined(__GNUC__)
+        return __builtin_ctzll(v);
+#else
+        size_t i = 0;
+        while ((v & 1) == 0) {
+            v >>= 1;
+            ++i;
+        }
+        return i;
+#endif
+    }
 };
 
 
@@ -1835,6 +2470,155 @@ public:
 };
 
 
+
+// Matches links to any of several target rows. This is a separate node rather
+// than a mode of LinksToNode, whose layout is fixed by Query::links_to().
+class LinksToAnyNode : public ParentNode {
+public:
+    LinksToAnyNode(size_t origin_column_index, const std::vector<size_t>& target_rows) :
+        m_origin_column(origin_column_index),
+        m_target_rows(to_link_values(target_rows))
+    {
+        m_child = nullptr;
+        m_dD = 10.0;
+        m_dT = 50.0;
+    }
+
+    void init(const Table& table) override
+    {
+        m_table = &table;
+        if (table.get_column_type(m_origin_column) == type_Link)
+            m_links.init(static_cast<const Column*>(&get_column_base(table, m_origin_column)));
+        if (m_child)
+            m_child->init(table);
+    }
+
+    size_t find_first_local(size_t start, size_t end) override
+    {
+        if (m_target_rows.size() == 0)
+            return not_found;
+
+        DataType type = m_table->get_column_type(m_origin_column);
+
+        if (type == type_Link) {
+            while (start < end) {
+                m_links.cache_next(start);
+                size_t ret = m_target_rows.find_first(*m_links.m_leaf_ptr, start - m_links.m_leaf_start,
+                                                      m_links.local_end(end));
+                if (ret != not_found)
+                    return ret + m_links.m_leaf_start;
+                start = m_links.m_leaf_end;
+            }
+        }
+        else if (type == type_LinkList) {
+            const ColumnLinkList& cll =
+                static_cast<const ColumnLinkList&>(get_column_base(*m_table, m_origin_column));
+            for (size_t i = start; i < end; i++) {
+                ConstLinkViewRef lv = cll.get(i);
+                size_t n = lv->size();
+                for (size_t t = 0; t < n; ++t) {
+                    if (m_target_rows.contains(lv->m_row_indexes.get(t) + 1))
+                        return i;
+                }
+            }
+        }
+        else {
+            REALM_ASSERT(false);
+        }
+
+        return not_found;
+    }
+
+    ParentNode* clone() override
+    {
+        return new LinksToAnyNode(*this);
+    }
+
+    LinksToAnyNode(const LinksToAnyNode& from)
+        : ParentNode(from)
+    {
+        m_origin_column = from.m_origin_column;
+        m_target_rows = from.m_target_rows;
+        m_child = from.m_child;
+        // m_links is not copied
+    }
+
+    size_t m_origin_column;
+    IntegerValueSet m_target_rows; // Stored the way ColumnLink stores them, as target row + 1
+
+private:
+    static IntegerValueSet to_link_values(const std::vector<size_t>& target_rows)
+    {
+        std::vector<int64_t> values;
+        values.reserve(target_rows.size());
+        for (size_t t = 0; t < target_rows.size(); ++t)
+            values.push_back(int64_t(target_rows[t]) + 1);
+        return IntegerValueSet(std::move(values));
+    }
+
+    SequentialGetter<Column> m_links;
+};
+
+
+
+// Implementation:
+
+inline Query& Query::links_to(size_t column_ndx, const std::vector<size_t>& target_rows)
+{
+    ParentNode* p;
+    if (target_rows.size() == 1)
+        p = new LinksToNode(column_ndx, target_rows[0]);
+    else
+        p = new LinksToAnyNode(column_ndx, target_rows);
+    UpdatePointers(p, &p->m_child);
+    return *this;
+}
+
+inline Query& Query::in(size_t column_ndx, const std::vector<int64_t>& values)
+{
+    DataType type = m_table->get_column_type(column_ndx);
+    if (type != type_Int && type != type_Bool && type != type_DateTime)
+        throw LogicError(LogicError::type_mismatch);
+
+    ParentNode* p;
+    if (m_table->is_nullable(column_ndx))
+        p = new IntegerInNode<ColumnIntNull>(values, column_ndx);
+    else
+        p = new IntegerInNode<Column>(values, column_ndx);
+    UpdatePointers(p, &p->m_child);
+    return *this;
+}
+
+inline Query& Query::in(size_t column_ndx, const std::vector<StringData>& values)
+{
+    if (m_table->get_column_type(column_ndx) != type_String)
+        throw LogicError(LogicError::type_mismatch);
+
+    ParentNode* const p = new StringInNode(values, column_ndx);
+    UpdatePointers(p, &p->m_child);
+    return *this;
+}
+
+inline Query& Query::equal_enumerated(size_t column_ndx, StringData value)
+{
+    if (m_table->get_column_type(column_ndx) != type_String)
+        throw LogicError(LogicError::type_mismatch);
+
+    ParentNode* const p = new EnumStringEqualNode(value, column_ndx);
+    UpdatePointers(p, &p->m_child);
+    return *this;
+}
+
+inline Query& Query::begins_with_indexed(size_t column_ndx, StringData value)
+{
+    if (m_table->get_column_type(column_ndx) != type_String)
+        throw LogicError(LogicError::type_mismatch);
+
+    ParentNode* const p = new StringPrefixIndexNode(value, column_ndx);
+    UpdatePointers(p, &p->m_child);
+    return *this;
+}
+
 } // namespace realm
 
 #endif // REALM_QUERY_ENGINE_HPP
@@ -64,7 +64,7 @@ Operator: public Subexpr2
 
 Value<T>: public Subexpr2
     void evaluate(size_t i, ValueBase* destination)
-    T m_v[8];
+    T m_cache[ValueBase::default_size];
 
 Columns<T>: public Subexpr2
     void evaluate(size_t i, ValueBase* destination)
@@ -87,10 +87,14 @@ size_t Compare<Greater>::find_first()-------------+
                                                Value<float>::evaluate()    Columns<float>::evaluate()
 
 Operator, Value and Columns have an evaluate(size_t i, ValueBase* destination) method which returns a Value<T>
-containing 8 values representing table rows i...i + 7.
+containing destination->m_values values representing table rows i...i + destination->m_values - 1.
 
-So Value<T> contains 8 concecutive values and all operations are based on these chunks. This is
-to save overhead by virtual calls needed for evaluating a query that has been dynamically constructed at runtime.
+So Value<T> contains up to ValueBase::batch_size (256) concecutive values and all operations are based on these
+chunks. This is to save overhead by virtual calls needed for evaluating a query that has been dynamically constructed
+at runtime. Compare::find_first() sizes the chunks to the range it searches, so probing a single row stays cheap, and
+Columns and Operator write straight into the destination when it has their own type, so that no export_*()
+conversion is needed. A constant is a Value<T> of one element, which evaluate() repeats for as many rows as the
+destination was sized for.
 
 
 Memory allocation:
@@ -252,7 +256,8 @@ template<class T1, class T2, bool b> struct Common<T1, T2, true , false, b> {
 
 struct ValueBase
 {
-    static const size_t default_size = 8;
+    static const size_t default_size = 8;   // Values held without a heap allocation
+    static const size_t batch_size = 256;   // Rows evaluated at a time by Compare::find_first()
     virtual void export_bool(ValueBase& destination) const = 0;
     virtual void export_int(ValueBase& destination) const = 0;
     virtual void export_float(ValueBase& destination) const = 0;
@@ -597,7 +602,7 @@ public:
     Value(T v)
     {
         m_v = nullptr;
-        init(false, ValueBase::default_size, v);
+        init(false, 1, v);
     }
     Value(bool link, size_t values)
     {
@@ -620,6 +625,16 @@ public:
     }
 
     void init(bool link, size_t values, T v) {
+        init(link, values);
+        if (m_values > 0)
+            std::fill(m_v, m_v + ValueBase::m_values, v);
+    }
+
+    // Same as above, but leaves the payload uninitialized for callers that overwrite all of it
+    void init(bool link, size_t values) {
+        ValueBase::from_link = link;
+        if (m_v && values == m_values)
+            return; // Same size, so the payload can be reused
         if (m_v) {
             // If we store more than default_size elements then we used 'new', else we used m_cache
             if (m_values > ValueBase::default_size)
@@ -634,28 +649,46 @@ public:
                 m_v = new T[m_values];
             else
                 m_v = m_cache;
-            std::fill(m_v, m_v + ValueBase::m_values, v);
         }
     }
 
     void evaluate(size_t, ValueBase& destination)
     {
+        // A constant is stored once, and repeated for as many rows as the destination was sized for
+        if (!ValueBase::from_link && ValueBase::m_values == 1 && destination.m_values != 1) {
+            if (Value<T>* d = dynamic_cast<Value<T>*>(&destination)) {
+                d->init(false, destination.m_values, m_v[0]);
+            }
+            else {
+                Value<T> v(false, destination.m_values, m_v[0]);
+                destination.import(v);
+            }
+            return;
+        }
         destination.import(*this);
     }
 
+    // The payload pointers are read into locals so that the compiler can tell that the stores to the result do not
+    // change them, which lets it vectorize the loops
     template <class TOperator> REALM_FORCEINLINE void fun(const Value* left, const Value* right)
     {
         TOperator o;
         size_t vals = minimum(left->m_values, right->m_values);
+        T* dst = m_v;
+        const T* l = left->m_v;
+        const T* r = right->m_v;
         for (size_t t = 0; t < vals; t++)
-            m_v[t] = o(left->m_v[t], right->m_v[t]);
+            dst[t] = o(l[t], r[t]);
     }
 
     template <class TOperator> REALM_FORCEINLINE void fun(const Value* value)
     {
         TOperator o;
-        for (size_t t = 0; t < value->m_values; t++)
-            m_v[t] = o(value->m_v[t]);
+        size_t vals = value->m_values;
+        T* dst = m_v;
+        const T* v = value->m_v;
+        for (size_t t = 0; t < vals; t++)
+            dst[t] = o(v[t]);
     }
 
 
@@ -668,11 +701,11 @@ public:
         typedef typename EitherIsString <D, T>::type dst_t;
         typedef typename EitherIsString <T, D>::type src_t;
         Value<dst_t>& d = static_cast<Value<dst_t>&>(destination);
-        d.init(ValueBase::from_link, ValueBase::m_values, 0);
-        for (size_t t = 0; t < ValueBase::m_values; t++) {
-            src_t* source = reinterpret_cast<src_t*>(m_v);
-            d.m_v[t] = static_cast<dst_t>(source[t]);
-        }
+        d.init(ValueBase::from_link, ValueBase::m_values);
+        const src_t* source = reinterpret_cast<const src_t*>(m_v);
+        dst_t* dst = d.m_v;
+        for (size_t t = 0; t < ValueBase::m_values; t++)
+            dst[t] = static_cast<dst_t>(source[t]);
     }
 
     REALM_FORCEINLINE void export_bool(ValueBase& destination) const
@@ -730,8 +763,23 @@ public:
         if (!left->from_link && !right->from_link) {
             // Compare values one-by-one (one value is one row; no links)
             size_t min = minimum(left->ValueBase::m_values, right->ValueBase::m_values);
-            for (size_t m = 0; m < min; m++) {
-                if (c(left->m_v[m], right->m_v[m]))
+            const T* l = left->m_v;
+            const T* r = right->m_v;
+            size_t m = 0;
+            if (std::is_arithmetic<T>::value) {
+                // Skip blocks without matches using a branch-free loop that the compiler can vectorize. The
+                // block holding the first match is then searched one row at a time below
+                const size_t block = 16;
+                for (; m + block <= min; m += block) {
+                    bool any = false;
+                    for (size_t t = 0; t < block; t++)
+                        any |= c(l[m + t], r[m + t]);
+                    if (any)
+                        break;
+                }
+            }
+            for (; m < min; m++) {
+                if (c(l[m], r[m]))
                     return m;
             }
         }
@@ -742,7 +790,7 @@ public:
         else if (!left->from_link && right->from_link) {
             // Right values come from link. Left must come from single row. Semantics: Match if at least 1 
             // linked-to-value fulfills the condition
-            REALM_ASSERT_DEBUG(left->m_values == 0 || left->m_values == ValueBase::default_size);
+            REALM_ASSERT_DEBUG(left->m_values > 0 || right->m_values == 0);
             for (size_t r = 0; r < right->ValueBase::m_values; r++) {
                 if (c(left->m_v[0], right->m_v[r]))
                     return 0;
@@ -750,7 +798,7 @@ public:
         }
         else if (left->from_link && !right->from_link) {
             // Same as above, right left values coming from links
-            REALM_ASSERT_DEBUG(right->m_values == 0 || right->m_values == ValueBase::default_size);
+            REALM_ASSERT_DEBUG(right->m_values > 0 || left->m_values == 0);
             for (size_t l = 0; l < left->ValueBase::m_values; l++) {
                 if (c(left->m_v[l], right->m_v[0]))
                     return 0;
@@ -762,7 +810,7 @@ public:
 
     virtual Subexpr& clone()
     {
-        Value<T>& n = *new Value<T>();
+        Value<T>& n = *new Value<T>(ValueBase::from_link, ValueBase::m_values);
 
         // Copy all members, except the m_v pointer which the above Value constructor allocated
         T* tmp = n.m_v;
@@ -1113,7 +1161,9 @@ public:
         }
         else {
             // Not a link column
-            for (size_t t = 0; t < destination.m_values && index + t < m_table->size(); t++) {
+            size_t rows = minimum(destination.m_values, m_table->size() - index);
+            d.init(false, rows);
+            for (size_t t = 0; t < rows; t++) {
                 d.m_v[t] = m_table->get_string(m_column, index + t);
             }
         }
@@ -1411,33 +1461,40 @@ public:
             destination.import(v);
         }
         else {
-            // Not a Link column
-            sg->cache_next(index);
-            size_t colsize = sg->m_column->size();
-
-            if (std::is_same<T, int64_t>::value && index + ValueBase::default_size < sg->m_leaf_end) {
-                Value<T> v;
-                REALM_ASSERT_3(ValueBase::default_size, ==, 8); // If you want to modify 'default_size' then update Array::get_chunk()
-                // int64_t leaves have a get_chunk optimization that returns 8 int64_t values at once
-                sg->m_leaf_ptr->get_chunk(index - sg->m_leaf_start, static_cast<Value<int64_t>*>(static_cast<ValueBase*>(&v))->m_v);
-                destination.import(v);
+            // Not a Link column. Load as many rows as the caller sized the destination for, or up to the end of the
+            // column. If the destination has our type, load straight into it instead of converting from a temporary
+            size_t rows = minimum(destination.m_values, sg->m_column->size() - index);
+            if (Value<T>* d = dynamic_cast<Value<T>*>(&destination)) {
+                d->init(false, rows);
+                get_values(index, rows, d->m_v);
             }
             else {
-                // To make Valgrind happy we must initialize all default_size in v even if Column ends earlier. Todo, benchmark
-                // if an unconditional zero out is faster
-                size_t rows = colsize - index;
-                if (rows > ValueBase::default_size)
-                    rows = ValueBase::default_size;
                 Value<T> v(false, rows);
-
-                for (size_t t = 0; t < rows; t++)
-                    v.m_v[t] = sg->get_next(index + t);
-
+                get_values(index, rows, v.m_v);
                 destination.import(v);
             }
         }
     }
 
+    // Read rows index...index + rows - 1 into 'values', one leaf at a time
+    void get_values(size_t index, size_t rows, T* values)
+    {
+        for (size_t t = 0; t < rows; ) {
+            sg->cache_next(index + t);
+            size_t ndx_in_leaf = index + t - sg->m_leaf_start;
+            size_t n = minimum(rows - t, sg->m_leaf_end - (index + t));
+            size_t i = 0;
+            if (std::is_same<T, int64_t>::value) {
+                // int64_t leaves have a get_chunk optimization that returns 8 int64_t values at once
+                for (; i + 8 <= n; i += 8)
+                    sg->m_leaf_ptr->get_chunk(ndx_in_leaf + i, reinterpret_cast<int64_t*>(values + t + i));
+            }
+            for (; i < n; i++)
+                values[t + i] = sg->m_leaf_ptr->get(ndx_in_leaf + i);
+            t += n;
+        }
+    }
+
     const Table* m_table_linked_from;
 
     // m_table is redundant with ColumnAccessorBase<>::m_table, but is in order to decrease class dependency/entanglement
@@ -1478,14 +1535,20 @@ public:
         return l;
     }
 
-    // destination = operator(left)
+    // destination = operator(left), computed in place if the destination has our type
     void evaluate(size_t index, ValueBase& destination)
     {
-        Value<T> result;
-        Value<T> left;
+        Value<T> left(false, destination.m_values);
         m_left.evaluate(index, left);
-        result.template fun<oper>(&left);
-        destination.import(result);
+        if (Value<T>* d = dynamic_cast<Value<T>*>(&destination)) {
+            d->init(left.from_link, left.m_values);
+            d->template fun<oper>(&left);
+        }
+        else {
+            Value<T> result(left.from_link, left.m_values);
+            result.template fun<oper>(&left);
+            destination.import(result);
+        }
     }
 
 private:
@@ -1533,16 +1596,33 @@ public:
         return l ? l : r;
     }
 
-    // destination = operator(left, right)
+    // destination = operator(left, right), computed in place if the destination has our type
     void evaluate(size_t index, ValueBase& destination)
     {
-        Value<T> result;
-        Value<T> left;
-        Value<T> right;
+        size_t rows = destination.m_values;
+        Value<T> left(false, rows);
+        Value<T> right(false, rows);
         m_left.evaluate(index, left);
         m_right.evaluate(index, right);
-        result.template fun<oper>(&left, &right);
-        destination.import(result);
+
+        // Rows past the shorter operand (the end of the column) are left zeroed, except in the plain row-by-row case
+        // where the result is simply made that much shorter
+        bool rowwise = !left.from_link && !right.from_link;
+        if (rowwise)
+            rows = minimum(left.m_values, right.m_values);
+
+        if (Value<T>* d = dynamic_cast<Value<T>*>(&destination)) {
+            if (rowwise)
+                d->init(false, rows);
+            else
+                d->init(false, rows, T());
+            d->template fun<oper>(&left, &right);
+        }
+        else {
+            Value<T> result(false, rows);
+            result.template fun<oper>(&left, &right);
+            destination.import(result);
+        }
     }
 
 private:
@@ -1604,10 +1684,18 @@ public:
     size_t find_first(size_t start, size_t end) const
     {
         size_t match;
-        Value<T> right;
-        Value<T> left;
+
+        // Evaluate up to batch_size rows at a time, but no more than the range holds, so that testing a single
+        // row (as the query engine does when this is not the leading condition) stays cheap. Once a subexpression
+        // turns out to come from a link, every row has its own set of linked values, so go one row at a time
+        size_t batch = ValueBase::batch_size;
+        Value<T> right(false, minimum(batch, end - start));
+        Value<T> left(false, minimum(batch, end - start));
 
         for (; start < end;) {
+            size_t rows = minimum(batch, end - start);
+            left.init(false, rows);
+            right.init(false, rows);
             m_left.evaluate(start, left);
             m_right.evaluate(start, right);
             match = Value<T>::template compare<TCond>(&left, &right);
@@ -1615,7 +1703,13 @@ public:
             if (match != not_found && match + start < end)
                 return start + match;
 
-            size_t rows = (left.from_link || right.from_link) ? 1 : minimum(right.m_values, left.m_values);
+            if (left.from_link || right.from_link) {
+                batch = 1;
+                rows = 1;
+            }
+            else {
+                rows = minimum(right.m_values, left.m_values);
+            }
             start += rows;
         }
 
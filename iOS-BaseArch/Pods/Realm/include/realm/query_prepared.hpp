@@ -0,0 +1,486 @@
+/*************************************************************************
+ *
+ * REALM CONFIDENTIAL
+ * __________________
+ *
+ *  [2011] - [2015] Realm Inc
+ *  All Rights Reserved.
+ *
+ * NOTICE:  All information contained herein is, and remains
+ * the property of Realm Incorporated and its suppliers,
+ * if any.  The intellectual and technical concepts contained
+ * herein are proprietary to Realm Incorporated
+ * and its suppliers and may be covered by U.S. and Foreign Patents,
+ * patents in process, and are protected by trade secret or copyright law.
+ * Dissemination of this information or reproduction of this material
+ * is strictly forbidden unless prior written permission is obtained
+ * from Realm Incorporated.
+ *
+ **************************************************************************/
+#ifndef REALM_QUERY_PREPARED_HPP
+#define REALM_QUERY_PREPARED_HPP
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <realm/table.hpp>
+#include <realm/table_view.hpp>
+#include <realm/query.hpp>
+#include <realm/exceptions.hpp>
+
+namespace realm {
+
+/// A query shape that is built once, with parameters in place of the
+/// constants of its conditions, and then run repeatedly with new values.
+///
+/// Each condition of the shape compares a column against a parameter, and
+/// parameters are numbered by the caller, so one parameter can be used by
+/// several conditions. bind() only stores the value; the Query is built
+/// from the shape when it is next run, and only if a value changed since
+/// it was last built. Binding the value that a parameter already has is
+/// therefore free. The built query is also initialized only when it is
+/// new, or when the table has changed since the last run, so running it
+/// again with the same values skips the setup that Query::find() and
+/// friends repeat every time.
+///
+/// Values are converted to the type of the column where that does not lose
+/// information, such as an integer for a float or double column. Other
+/// values throw LogicError::type_mismatch when the query is run, and so do
+/// comparisons that the column type does not support (for example
+/// greater() on a string column). A parameter that is used but not bound
+/// throws LogicError::illegal_combination, as does binding a parameter
+/// that the shape does not use.
+class PreparedQuery {
+public:
+    explicit PreparedQuery(Table&);
+
+    // Conditions
+    PreparedQuery& equal(size_t column_ndx, size_t param_ndx, bool case_sensitive = true);
+    PreparedQuery& not_equal(size_t column_ndx, size_t param_ndx, bool case_sensitive = true);
+    PreparedQuery& greater(size_t column_ndx, size_t param_ndx);
+    PreparedQuery& greater_equal(size_t column_ndx, size_t param_ndx);
+    PreparedQuery& less(size_t column_ndx, size_t param_ndx);
+    PreparedQuery& less_equal(size_t column_ndx, size_t param_ndx);
+    PreparedQuery& begins_with(size_t column_ndx, size_t param_ndx, bool case_sensitive = true);
+    PreparedQuery& ends_with(size_t column_ndx, size_t param_ndx, bool case_sensitive = true);
+    PreparedQuery& contains(size_t column_ndx, size_t param_ndx, bool case_sensitive = true);
+
+    // Negation and grouping, as in Query
+    PreparedQuery& Not();
+    PreparedQuery& group();
+    PreparedQuery& end_group();
+    PreparedQuery& Or();
+
+    // Parameters
+    size_t get_parameter_count() const REALM_NOEXCEPT;
+    PreparedQuery& bind(size_t param_ndx, int64_t value);
+    PreparedQuery& bind(size_t param_ndx, int value);
+    PreparedQuery& bind(size_t param_ndx, bool value);
+    PreparedQuery& bind(size_t param_ndx, float value);
+    PreparedQuery& bind(size_t param_ndx, double value);
+    PreparedQuery& bind(size_t param_ndx, StringData value);
+    PreparedQuery& bind(size_t param_ndx, const char* c_str);
+    PreparedQuery& bind(size_t param_ndx, BinaryData value);
+    PreparedQuery& bind_datetime(size_t param_ndx, DateTime value);
+
+    // Searching
+    size_t    find(size_t begin_at_table_row = 0);
+    TableView find_all(size_t start = 0, size_t end = size_t(-1), size_t limit = size_t(-1));
+    size_t    count(size_t start = 0, size_t end = size_t(-1), size_t limit = size_t(-1));
+
+    /// The query built from the shape and the current values, for the
+    /// operations that are not offered here. Those initialize it as usual.
+    Query& get_query();
+
+private:
+    enum Op {
+        op_Equal, op_NotEqual, op_Greater, op_GreaterEqual, op_Less, op_LessEqual,
+        op_BeginsWith, op_EndsWith, op_Contains, op_Not, op_Group, op_EndGroup, op_Or
+    };
+
+    struct Step {
+        Op op;
+        size_t column_ndx;
+        size_t param_ndx;
+        bool case_sensitive;
+    };
+
+    // Integers, bools and datetimes are all stored as type_Int
+    struct Param {
+        bool bound = false;
+        DataType type = type_Int;
+        int64_t int_value = 0;
+        double double_value = 0;
+        std::string data; // type_String and type_Binary
+    };
+
+    TableRef m_table;
+    std::vector<Step> m_steps;
+    std::vector<Param> m_params;
+    std::unique_ptr<Query> m_query; // Null when it must be built again
+    bool m_initialized = false;
+#ifdef REALM_ENABLE_REPLICATION
+    uint_fast64_t m_version = 0;
+#endif
+
+    PreparedQuery& add_step(Op, size_t column_ndx, size_t param_ndx, bool case_sensitive);
+    void set_param(size_t param_ndx, DataType, int64_t int_value, double double_value,
+                   const char* data, size_t size);
+    void add_condition(Query&, const Step&) const;
+    template<class T> static void add_comparison(Query&, Op, size_t column_ndx, T value);
+    const Query& prepare();
+};
+
+
+
+
+// Implementation:
+
+inline PreparedQuery::PreparedQuery(Table& table):
+    m_table(table.get_table_ref())
+{
+}
+
+inline PreparedQuery& PreparedQuery::add_step(Op op, size_t column_ndx, size_t param_ndx, bool case_sensitive)
+{
+    Step step;
+    step.op = op;
+    step.column_ndx = column_ndx;
+    step.param_ndx = param_ndx;
+    step.case_sensitive = case_sensitive;
+    m_steps.push_back(step); // Throws
+    if (param_ndx != npos && param_ndx >= m_params.size())
+        m_params.resize(param_ndx + 1); // Throws
+    m_query.reset();
+    return *this;
+}
+
+inline PreparedQuery& PreparedQuery::equal(size_t column_ndx, size_t param_ndx, bool case_sensitive)
+{
+    return add_step(op_Equal, column_ndx, param_ndx, case_sensitive); // Throws
+}
+
+inline PreparedQuery& PreparedQuery::not_equal(size_t column_ndx, size_t param_ndx, bool case_sensitive)
+{
+    return add_step(op_NotEqual, column_ndx, param_ndx, case_sensitive); // Throws
+}
+
+inline PreparedQuery& PreparedQuery::greater(size_t column_ndx, size_t param_ndx)
+{
+    return add_step(op_Greater, column_ndx, param_ndx, true); // Throws
+}
+
+inline PreparedQuery& PreparedQuery::greater_equal(size_t column_ndx, size_t param_ndx)
+{
+    return add_step(op_GreaterEqual, column_ndx, param_ndx, true); // Throws
+}
+
+inline PreparedQuery& PreparedQuery::less(size_t column_ndx, size_t param_ndx)
+{
+    return add_step(op_Less, column_ndx, param_ndx, true); // Throws
+}
+
+inline PreparedQuery& PreparedQuery::less_equal(size_t column_ndx, size_t param_ndx)
+{
+    return add_step(op_LessEqual, column_ndx, param_ndx, true); // Throws
+}
+
+inline PreparedQuery& PreparedQuery::begins_with(size_t column_ndx, size_t param_ndx, bool case_sensitive)
+{
+    return add_step(op_BeginsWith, column_ndx, param_ndx, case_sensitive); // Throws
+}
+
+inline PreparedQuery& PreparedQuery::ends_with(size_t column_ndx, size_t param_ndx, bool case_sensitive)
+{
+    return add_step(op_EndsWith, column_ndx, param_ndx, case_sensitive); // Throws
+}
+
+inline PreparedQuery& PreparedQuery::contains(size_t column_ndx, size_t param_ndx, bool case_sensitive)
+{
+    return add_step(op_Contains, column_ndx, param_ndx, case_sensitive); // Throws
+}
+
+inline PreparedQuery& PreparedQuery::Not()
+{
+    return add_step(op_Not, npos, npos, true); // Throws
+}
+
+inline PreparedQuery& PreparedQuery::group()
+{
+    return add_step(op_Group, npos, npos, true); // Throws
+}
+
+inline PreparedQuery& PreparedQuery::end_group()
+{
+    return add_step(op_EndGroup, npos, npos, true); // Throws
+}
+
+inline PreparedQuery& PreparedQuery::Or()
+{
+    return add_step(op_Or, npos, npos, true); // Throws
+}
+
+inline size_t PreparedQuery::get_parameter_count() const REALM_NOEXCEPT
+{
+    return m_params.size();
+}
+
+inline void PreparedQuery::set_param(size_t param_ndx, DataType type, int64_t int_value,
+                                     double double_value, const char* data, size_t size)
+{
+    if (param_ndx >= m_params.size())
+        throw LogicError(LogicError::illegal_combination);
+    Param& param = m_params[param_ndx];
+    // Doubles are compared bitwise, so that -0.0 replaces 0.0 and a NaN
+    // does not force a rebuild every time it is bound
+    if (param.bound && param.type == type && param.int_value == int_value &&
+        std::memcmp(&param.double_value, &double_value, sizeof double_value) == 0 &&
+        param.data.size() == size && std::equal(data, data + size, param.data.data()))
+        return;
+    param.data.assign(data, size); // Throws
+    param.bound = true;
+    param.type = type;
+    param.int_value = int_value;
+    param.double_value = double_value;
+    m_query.reset();
+}
+
+inline PreparedQuery& PreparedQuery::bind(size_t param_ndx, int64_t value)
+{
+    set_param(param_ndx, type_Int, value, 0, nullptr, 0); // Throws
+    return *this;
+}
+
+inline PreparedQuery& PreparedQuery::bind(size_t param_ndx, int value)
+{
+    return bind(param_ndx, int64_t(value)); // Throws
+}
+
+inline PreparedQuery& PreparedQuery::bind(size_t param_ndx, bool value)
+{
+    return bind(param_ndx, int64_t(value)); // Throws
+}
+
+inline PreparedQuery& PreparedQuery::bind(size_t param_ndx, float value)
+{
+    set_param(param_ndx, type_Float, 0, value, nullptr, 0); // Throws
+    return *this;
+}
+
+inline PreparedQuery& PreparedQuery::bind(size_t param_ndx, double value)
+{
+    set_param(param_ndx, type_Double, 0, value, nullptr, 0); // Throws
+    return *this;
+}
+
+inline PreparedQuery& PreparedQuery::bind(size_t param_ndx, StringData value)
+{
+    set_param(param_ndx, type_String, 0, 0, value.data(), value.size()); // Throws
+    return *this;
+}
+
+inline PreparedQuery& PreparedQuery::bind(size_t param_ndx, const char* c_str)
+{
+    return bind(param_ndx, StringData(c_str)); // Throws
+}
+
+inline PreparedQuery& PreparedQuery::bind(size_t param_ndx, BinaryData value)
+{
+    set_param(param_ndx, type_Binary, 0, 0, value.data(), value.size()); // Throws
+    return *this;
+}
+
+inline PreparedQuery& PreparedQuery::bind_datetime(size_t param_ndx, DateTime value)
+{
+    return bind(param_ndx, int64_t(value.get_datetime())); // Throws
+}
+
+template<class T>
+inline void PreparedQuery::add_comparison(Query& query, Op op, size_t column_ndx, T value)
+{
+    switch (op) {
+        case op_Equal:        query.equal(column_ndx, value);         return; // Throws
+        case op_NotEqual:     query.not_equal(column_ndx, value);     return; // Throws
+        case op_Greater:      query.greater(column_ndx, value);       return; // Throws
+        case op_GreaterEqual: query.greater_equal(column_ndx, value); return; // Throws
+        case op_Less:         query.less(column_ndx, value);          return; // Throws
+        case op_LessEqual:    query.less_equal(column_ndx, value);    return; // Throws
+        default:
+            throw LogicError(LogicError::type_mismatch);
+    }
+}
+
+inline void PreparedQuery::add_condition(Query& query, const Step& step) const
+{
+    switch (step.op) {
+        case op_Not:      query.Not();       return; // Throws
+        case op_Group:    query.group();     return; // Throws
+        case op_EndGroup: query.end_group(); return; // Throws
+        case op_Or:       query.Or();        return; // Throws
+        default:
+            break;
+    }
+
+    const Param& param = m_params[step.param_ndx];
+    if (!param.bound)
+        throw LogicError(LogicError::illegal_combination);
+    size_t col = step.column_ndx;
+    Op op = step.op;
+
+    switch (m_table->get_column_type(col)) {
+        case type_Int:
+        case type_DateTime:
+            if (param.type != type_Int)
+                throw LogicError(LogicError::type_mismatch);
+            add_comparison(query, op, col, param.int_value); // Throws
+            return;
+        case type_Bool:
+            if (param.type != type_Int || (op != op_Equal && op != op_NotEqual))
+                throw LogicError(LogicError::type_mismatch);
+            query.equal(col, (param.int_value != 0) == (op == op_Equal)); // Throws
+            return;
+        case type_Float:
+        case type_Double: {
+            double value;
+            if (param.type == type_Int) {
+                value = double(param.int_value);
+            }
+            else if (param.type == type_Float || param.type == type_Double) {
+                value = param.double_value;
+            }
+            else {
+                throw LogicError(LogicError::type_mismatch);
+            }
+            if (m_table->get_column_type(col) == type_Float) {
+                add_comparison(query, op, col, float(value)); // Throws
+            }
+            else {
+                add_comparison(query, op, col, value); // Throws
+            }
+            return;
+        }
+        case type_String: {
+            if (param.type != type_String)
+                throw LogicError(LogicError::type_mismatch);
+            StringData value(param.data);
+            bool cs = step.case_sensitive;
+            switch (op) {
+                case op_Equal:
+                    if (cs)
+                        query.equal_enumerated(col, value); // Throws
+                    else
+                        query.equal(col, value, false); // Throws
+                    return;
+                case op_NotEqual:   query.not_equal(col, value, cs);   return; // Throws
+                case op_BeginsWith:
+                    if (cs)
+                        query.begins_with_indexed(col, value); // Throws
+                    else
+                        query.begins_with(col, value, false); // Throws
+                    return;
+                case op_EndsWith:   query.ends_with(col, value, cs);   return; // Throws
+                case op_Contains:   query.contains(col, value, cs);    return; // Throws
+                default:
+                    throw LogicError(LogicError::type_mismatch);
+            }
+        }
+        case type_Binary: {
+            if (param.type != type_Binary)
+                throw LogicError(LogicError::type_mismatch);
+            BinaryData value(param.data.data(), param.data.size());
+            switch (op) {
+                case op_Equal:      query.equal(col, value);       return; // Throws
+                case op_NotEqual:   query.not_equal(col, value);   return; // Throws
+                case op_BeginsWith: query.begins_with(col, value); return; // Throws
+                case op_EndsWith:   query.ends_with(col, value);   return; // Throws
+                case op_Contains:   query.contains(col, value);    return; // Throws
+                default:
+                    throw LogicError(LogicError::type_mismatch);
+            }
+        }
+        default:
+            throw LogicError(LogicError::type_mismatch);
+    }
+}
+
+inline const Query& PreparedQuery::prepare()
+{
+    if (!m_query) {
+        std::unique_ptr<Query> query(new Query(m_table->where())); // Throws
+        for (const Step& step : m_steps)
+            add_condition(*query, step); // Throws
+        m_query = std::move(query);
+        m_initialized = false;
+    }
+
+#ifdef REALM_ENABLE_REPLICATION
+    if (m_initialized && m_version == m_table->m_version)
+        return *m_query;
+    m_version = m_table->m_version;
+#endif
+    m_query->Init(*m_table);
+    m_initialized = true;
+    return *m_query;
+}
+
+inline size_t PreparedQuery::find(size_t begin_at_table_row)
+{
+    const Query& query = prepare(); // Throws
+    size_t end = m_table->size();
+    if (begin_at_table_row >= end)
+        return not_found;
+    if (query.first.empty() || !query.first[0])
+        return begin_at_table_row;
+    return query.FindInternal(begin_at_table_row, end);
+}
+
+inline TableView PreparedQuery::find_all(size_t start, size_t end, size_t limit)
+{
+    const Query& query = prepare(); // Throws
+    TableView tv(*m_table, *m_query, start, end, limit); // Throws
+    if (end == size_t(-1))
+        end = m_table->size();
+    if (limit == 0 || start >= end || m_table->is_degenerate())
+        return tv;
+
+    if (query.first.empty() || !query.first[0]) {
+        for (size_t i = start; i < end && tv.size() < limit; ++i)
+            tv.m_row_indexes.add(i); // Throws
+        return tv;
+    }
+
+    QueryState<int64_t> st;
+    st.init(act_FindAll, &tv.m_row_indexes, limit);
+    query.aggregate_internal(act_FindAll, type_Int, query.first[0], &st, start, end, nullptr); // Throws
+    return tv;
+}
+
+inline size_t PreparedQuery::count(size_t start, size_t end, size_t limit)
+{
+    const Query& query = prepare(); // Throws
+    if (end == size_t(-1))
+        end = m_table->size();
+    if (limit == 0 || start >= end || m_table->is_degenerate())
+        return 0;
+
+    if (query.first.empty() || !query.first[0])
+        return std::min(end - start, limit);
+
+    QueryState<int64_t> st;
+    st.init(act_Count, nullptr, limit);
+    query.aggregate_internal(act_Count, type_Int, query.first[0], &st, start, end, nullptr); // Throws
+    return size_t(st.m_state);
+}
+
+inline Query& PreparedQuery::get_query()
+{
+    prepare(); // Throws
+    return *m_query;
+}
+
+} // namespace realm
+
+#endif // REALM_QUERY_PREPARED_HPP
@@ -403,6 +403,54 @@ inline void TrivialReplication::internal_transact_log_reserve(std::size_t n, cha
     *new_end = data + m_transact_log_buffer.size();
 }
 
+inline void Table::add_search_index_bulk(std::size_t column_ndx)
+{
+    if (REALM_UNLIKELY(!is_attached()))
+        throw LogicError(LogicError::detached_accessor);
+    if (REALM_UNLIKELY(has_shared_type()))
+        throw LogicError(LogicError::wrong_kind_of_table);
+    if (REALM_UNLIKELY(column_ndx >= get_column_count()))
+        throw LogicError(LogicError::column_index_out_of_range);
+    if (has_search_index(column_ndx))
+        return;
+    switch (get_real_column_type(column_ndx)) {
+        case col_type_Int:
+        case col_type_Bool:
+        case col_type_DateTime:
+        case col_type_String:
+        case col_type_StringEnum:
+            break;
+        default:
+            throw LogicError(LogicError::illegal_combination);
+    }
+
+    // The steps of add_search_index(), except that the index is filled
+    // before the column gets an accessor for it
+    ColumnBase& col = get_column_base(column_ndx);
+    std::size_t index_pos = m_spec.get_column_info(column_ndx).m_column_ref_ndx + 1;
+    StringIndex index(&col, get_alloc()); // Throws
+    try {
+        index.bulk_rebuild(); // Throws
+        m_columns.insert(index_pos, index.get_ref()); // Throws
+    }
+    catch (...) {
+        index.destroy();
+        throw;
+    }
+    bool allow_duplicate_values = true;
+    col.set_search_index_ref(index.get_ref(), &m_columns, index_pos, allow_duplicate_values); // Throws
+    int attr = m_spec.get_column_attr(column_ndx) | col_attr_Indexed;
+    m_spec.set_column_attr(column_ndx, ColumnAttr(attr)); // Throws
+
+    // The columns after this one have moved in m_columns
+    refresh_column_accessors(column_ndx + 1); // Throws
+
+#ifdef REALM_ENABLE_REPLICATION
+    if (Replication* repl = get_repl())
+        repl->add_search_index(this, column_ndx); // Throws
+#endif
+}
+
 } // namespace realm
 
 #endif // REALM_REPLICATION_HPP
@@ -28,6 +28,10 @@
 #include <realm/util/features.h>
 #include <realm/utilities.hpp>
 
+#ifdef REALM_COMPILER_SSE
+#  include <emmintrin.h> // SSE2
+#endif
+
 namespace realm {
 
 /// A reference to a chunk of character data.
@@ -147,6 +151,24 @@ private:
 
 
 
+namespace _impl {
+
+/// Returns the position of the first occurrence of a needle of \a
+/// needle_size bytes in \a haystack, or \a haystack_size if there is none.
+/// Byte `i` of an occurrence must be equal to either `needle_1[i]` or
+/// `needle_2[i]`, so the same function serves both case sensitive searches
+/// (pass the needle twice) and the byte-wise case insensitive comparison
+/// that search_case_fold() does for ASCII.
+///
+/// Candidate positions are found by testing the first and the last byte of
+/// the needle at 16 positions at a time, and only candidates are compared
+/// in full.
+std::size_t search_bytes(const char* haystack, std::size_t haystack_size, const char* needle_1,
+                         const char* needle_2, std::size_t needle_size) REALM_NOEXCEPT;
+
+} // namespace _impl
+
+
 // Implementation:
 
 inline StringData::StringData() REALM_NOEXCEPT:
@@ -257,7 +279,7 @@ inline bool StringData::contains(StringData d) const REALM_NOEXCEPT
         return false;
 
     return d.m_size == 0 ||
-        std::search(m_data, m_data + m_size, d.m_data, d.m_data + d.m_size) != m_data + m_size;
+        _impl::search_bytes(m_data, m_size, d.m_data, d.m_data, d.m_size) != m_size;
 }
 
 inline StringData StringData::prefix(std::size_t n) const REALM_NOEXCEPT
@@ -305,6 +327,67 @@ struct null {
     operator StringData() { return StringData(0, 0); }
 };
 
+namespace _impl {
+
+inline bool equal_bytes_at(const char* haystack, const char* needle_1, const char* needle_2,
+                           std::size_t needle_size) REALM_NOEXCEPT
+{
+    for (std::size_t i = 0; i < needle_size; ++i) {
+        if (haystack[i] != needle_1[i] && haystack[i] != needle_2[i])
+            return false;
+    }
+    return true;
+}
+
+inline std::size_t search_bytes(const char* haystack, std::size_t haystack_size, const char* needle_1,
+                                const char* needle_2, std::size_t needle_size) REALM_NOEXCEPT
+{
+    if (needle_size == 0)
+        return 0;
+    if (needle_size > haystack_size)
+        return haystack_size;
+
+    const std::size_t last = needle_size - 1;
+    const std::size_t end = haystack_size - last; // Occurrences can start at [0, end)
+    std::size_t i = 0;
+
+#ifdef REALM_COMPILER_SSE
+    // SSE2 is part of x86-64, so no runtime detection is needed
+    const __m128i first_1 = _mm_set1_epi8(needle_1[0]);
+    const __m128i first_2 = _mm_set1_epi8(needle_2[0]);
+    const __m128i last_1 = _mm_set1_epi8(needle_1[last]);
+    const __m128i last_2 = _mm_set1_epi8(needle_2[last]);
+
+    for (; i + 16 <= end; i += 16) {
+        __m128i f = _mm_loadu_si128(reinterpret_cast<const __m128i*>(haystack + i));
+        __m128i l = _mm_loadu_si128(reinterpret_cast<const __m128i*>(haystack + i + last));
+        __m128i first = _mm_or_si128(_mm_cmpeq_epi8(f, first_1), _mm_cmpeq_epi8(f, first_2));
+        __m128i candidates = _mm_and_si128(first, _mm_or_si128(_mm_cmpeq_epi8(l, last_1), _mm_cmpeq_epi8(l, last_2)));
+        unsigned int mask = unsigned(_mm_movemask_epi8(candidates));
+        while (mask != 0) {
+#ifdef _MSC_VER
+            unsigned long bit;
+            _BitScanForward(&bit, mask);
+#else
+            unsigned int bit = unsigned(__builtin_ctz(mask));
+#endif
+            // The first and last bytes are known to match
+            if (needle_size <= 2 || equal_bytes_at(haystack + i + bit + 1, needle_1 + 1, needle_2 + 1, last - 1))
+                return i + bit;
+            mask &= mask - 1;
+        }
+    }
+#endif
+
+    for (; i < end; ++i) {
+        if (equal_bytes_at(haystack + i, needle_1, needle_2, needle_size))
+            return i;
+    }
+    return haystack_size;
+}
+
+} // namespace _impl
+
 } // namespace realm
 
 #endif // REALM_STRING_HPP
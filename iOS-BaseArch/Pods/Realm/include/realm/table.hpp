@@ -51,6 +51,7 @@ class ColumnLinkBase;
 class ColumnLink;
 class ColumnLinkList;
 class ColumnBackLink;
+class GroupBy;
 template<class> class Columns;
 
 struct Link {};
@@ -242,6 +243,21 @@ public:
     /// remove_primary_key() removes a previously added primary key. It is an
     /// error if this table has no primary key.
     ///
+    /// add_search_index_bulk() is like add_search_index(), but fills the new
+    /// index in one pass, see StringIndex::bulk_rebuild(), before attaching
+    /// it to the column. add_search_index() is compiled into the library and
+    /// fills a new index row by row, for integer and string columns alike,
+    /// so this is faster for a column that already has many rows, and packs
+    /// the nodes full where inserting row by row leaves them partly full
+    /// after splits. It throws LogicError::illegal_combination if the column
+    /// type cannot be indexed. Defined in replication.hpp, because it records
+    /// the change in the transaction log like add_search_index().
+    ///
+    /// rebuild_search_index() rebuilds the search index of the specified
+    /// column in the same way, such as after a large import into an indexed
+    /// column. It is an error if the specified column has no search index.
+    /// Like other changes, both must be made in a write transaction.
+    ///
     /// This table must be a root table; that is, it must have an independent
     /// descriptor. Freestanding tables, group-level tables, and subtables in a
     /// column of type 'mixed' are all examples of root tables. See add_column()
@@ -252,10 +268,12 @@ public:
     bool has_search_index(std::size_t column_ndx) const REALM_NOEXCEPT;
 //    void remove_search_index(size_t col_ndx);
     void add_search_index(std::size_t column_ndx);
+    void add_search_index_bulk(std::size_t column_ndx);
     void remove_search_index(std::size_t column_ndx);
     bool has_primary_key() const REALM_NOEXCEPT;
     bool try_add_primary_key(std::size_t column_ndx);
     void remove_primary_key();
+    void rebuild_search_index(std::size_t column_ndx);
 
     //@}
 
@@ -607,6 +625,9 @@ public:
     // Simple pivot aggregate method. Experimental! Please do not document method publicly.
     void aggregate(size_t group_by_column, size_t aggr_column, AggrType op, Table& result, const Column* viewrefs = nullptr) const;
 
+    // Group by any number of columns with any number of aggregates. Defined in group_by.hpp
+    void group_by(const GroupBy&, Table& result) const;
+
 
 private:
     template <class T> std::size_t find_first(std::size_t column_ndx, T value) const; // called by above methods
@@ -1316,6 +1337,13 @@ private:
     friend class LinkMap;
     friend class LinkView;
     friend class Group;
+    friend class ColumnarExport;
+    friend class IndexSnapshot;
+    friend class AutoEnumerator;
+    friend class ViewUpdater;
+    friend class QueryCursor;
+    friend class PreparedQuery;
+    friend class CompressedBlobs;
 };
 
 
@@ -1478,6 +1506,18 @@ inline DataType Table::get_column_type(std::size_t ndx) const REALM_NOEXCEPT
     return m_spec.get_public_column_type(ndx);
 }
 
+inline void Table::rebuild_search_index(std::size_t column_ndx)
+{
+    if (REALM_UNLIKELY(!is_attached()))
+        throw LogicError(LogicError::detached_accessor);
+    if (REALM_UNLIKELY(column_ndx >= get_column_count()))
+        throw LogicError(LogicError::column_index_out_of_range);
+    StringIndex* index = get_column_base(column_ndx).get_search_index();
+    if (REALM_UNLIKELY(!index))
+        throw LogicError(LogicError::no_search_index);
+    index->bulk_rebuild(); // Throws
+}
+
 template<class Col, ColumnType col_type> inline Col& Table::get_column(std::size_t ndx)
 {
     ColumnBase& col = get_column_base(ndx);
@@ -20,7 +20,13 @@
 #ifndef REALM_TABLE_VIEW_HPP
 #define REALM_TABLE_VIEW_HPP
 
+#include <algorithm>
+#include <cstring>
 #include <iostream>
+#include <atomic>
+#include <exception>
+#include <thread>
+#include <limits>
 
 #include <realm/views.hpp>
 #include <realm/table.hpp>
@@ -292,6 +298,9 @@ public:
     // Set this undetached TableView to be a distinct view, and sync immediately.
     void sync_distinct_view(size_t column_ndx);
 
+    // Group the rows of this view. Defined in group_by.hpp
+    void group_by(const GroupBy&, Table& result) const;
+
     // This TableView can be "born" from 4 different sources : LinkView, Table::get_distinct_view(),
     // Table::find_all() or Query. Return the version of the source it was created from.
     uint64_t outside_version() const;
@@ -305,6 +314,19 @@ public:
     // Sort m_row_indexes according to multiple columns
     void sort(std::vector<size_t> columns, std::vector<bool> ascending);
 
+    // Sort like sort(), but extract one key per row and column into a
+    // contiguous buffer first, and radix sort the (key, row) pairs, instead of
+    // fetching both values through the B+-tree for every comparison. Integer,
+    // bool, DateTime, float and double values are their own keys, and strings
+    // are replaced by the rank of their value among the distinct values of the
+    // view. On an enumerated string column, only the keys of the column are
+    // ranked, and each row takes the rank of its key index. Rows that compare
+    // equal keep their order in the view. Views with other column types, or
+    // with detached rows, are passed to sort(). Later re-sorts, such as when
+    // the view is synced, use sort() as usual.
+    void sort_by_keys(size_t column, bool ascending = true);
+    void sort_by_keys(std::vector<size_t> columns, std::vector<bool> ascending);
+
     // Actual sorting facility is provided by the base class:
     using RowIndexes::sort;
 
@@ -394,9 +416,21 @@ protected:
 private:
     void detach() const REALM_NOEXCEPT; // may have to remove const
     std::size_t find_first_integer(std::size_t column_ndx, int64_t value) const;
+
+    // Helpers of sort_by_keys(). Keys are unsigned and ordered like the values
+    // in ascending order.
+    static bool extract_sort_keys(const ColumnBase&, const std::vector<size_t>& rows,
+                                  std::vector<uint64_t>& keys);
+    static uint64_t get_sort_key(double) REALM_NOEXCEPT;
+    static void rank_strings(std::vector<std::pair<StringData, size_t>>& values, std::vector<uint64_t>& ranks);
+    static void radix_sort(std::vector<std::pair<uint64_t, size_t>>& items);
+
     friend class Table;
     friend class Query;
     friend class SharedGroup;
+    friend class ViewUpdater;
+    friend class GroupBy;
+    friend class PreparedQuery;
     template<class Tab, class View, class Impl> friend class BasicTableViewBase;
 
     // Called by table to adjust any row references:
@@ -546,6 +580,7 @@ private:
     friend class TableViewBase;
     friend class ListviewNode;
     friend class LinkView;
+    friend class PreparedQuery;
     template<typename, typename, typename> friend class BasicTableViewBase;
 };
 
@@ -1028,6 +1063,157 @@ inline bool TableViewBase::is_null_link(std::size_t column_ndx, std::size_t row_
 }
 
 
+inline void TableViewBase::sort_by_keys(size_t column, bool ascending)
+{
+    sort_by_keys(std::vector<size_t>(1, column), std::vector<bool>(1, ascending)); // Throws
+}
+
+inline void TableViewBase::sort_by_keys(std::vector<size_t> columns, std::vector<bool> ascending)
+{
+    REALM_ASSERT(columns.size() == ascending.size());
+    size_t n = m_row_indexes.size();
+    if (n < 2 || m_num_detached_refs != 0) {
+        sort(std::move(columns), std::move(ascending)); // Throws
+        return;
+    }
+
+    std::vector<size_t> rows;
+    rows.reserve(n); // Throws
+    for (size_t k = 0; k < n; ++k)
+        rows.push_back(to_size_t(m_row_indexes.get(k)));
+
+    // Sort by the last column first, so that the stable passes over the
+    // earlier columns leave ties ordered by the later ones
+    std::vector<std::pair<uint64_t, size_t>> items(n); // Throws
+    for (size_t k = 0; k < n; ++k)
+        items[k].second = k;
+    std::vector<uint64_t> keys(n); // Throws
+    for (size_t t = columns.size(); t-- > 0; ) {
+        if (!extract_sort_keys(get_column_base(columns[t]), rows, keys)) { // Throws
+            sort(std::move(columns), std::move(ascending)); // Throws
+            return;
+        }
+        uint64_t flip = ascending[t] ? 0 : ~uint64_t(0);
+        for (size_t k = 0; k < n; ++k)
+            items[k].first = keys[items[k].second] ^ flip;
+        radix_sort(items); // Throws
+    }
+
+    m_row_indexes.clear(); // Throws
+    for (size_t k = 0; k < n; ++k)
+        m_row_indexes.add(rows[items[k].second]); // Throws
+    m_sorting_predicate = Sorter(columns, ascending);
+    m_auto_sort = true;
+}
+
+inline bool TableViewBase::extract_sort_keys(const ColumnBase& column, const std::vector<size_t>& rows,
+                                             std::vector<uint64_t>& keys)
+{
+    // The same values as RowIndexes::Sorter compares
+    const uint64_t sign = uint64_t(1) << 63;
+    size_t n = rows.size();
+    if (auto col = dynamic_cast<const ColumnStringEnum*>(&column)) {
+        const AdaptiveStringColumn& key_strings = col->get_keys();
+        size_t num_keys = key_strings.size();
+        std::vector<std::pair<StringData, size_t>> values;
+        values.reserve(num_keys); // Throws
+        for (size_t key_ndx = 0; key_ndx < num_keys; ++key_ndx)
+            values.push_back(std::make_pair(key_strings.get(key_ndx), key_ndx));
+        std::vector<uint64_t> ranks(num_keys); // Throws
+        rank_strings(values, ranks); // Throws
+        for (size_t k = 0; k < n; ++k)
+            keys[k] = ranks[to_size_t(col->Column::get(rows[k]))];
+    }
+    else if (auto col = dynamic_cast<const ColumnTemplate<int64_t>*>(&column)) {
+        for (size_t k = 0; k < n; ++k)
+            keys[k] = uint64_t(col->get_val(rows[k])) ^ sign;
+    }
+    else if (auto col = dynamic_cast<const ColumnTemplate<float>*>(&column)) {
+        for (size_t k = 0; k < n; ++k)
+            keys[k] = get_sort_key(col->get_val(rows[k]));
+    }
+    else if (auto col = dynamic_cast<const ColumnTemplate<double>*>(&column)) {
+        for (size_t k = 0; k < n; ++k)
+            keys[k] = get_sort_key(col->get_val(rows[k]));
+    }
+    else if (auto col = dynamic_cast<const ColumnTemplate<StringData>*>(&column)) {
+        std::vector<std::pair<StringData, size_t>> values;
+        values.reserve(n); // Throws
+        for (size_t k = 0; k < n; ++k)
+            values.push_back(std::make_pair(col->get_val(rows[k]), k));
+        rank_strings(values, keys); // Throws
+    }
+    else {
+        return false;
+    }
+    return true;
+}
+
+// utf8_compare() depends on the string compare method, so strings cannot be
+// mapped to keys on their own. Each distinct value is ranked instead, and null
+// ranks before all other strings. The rank of values[i].first is stored at
+// ranks[values[i].second].
+inline void TableViewBase::rank_strings(std::vector<std::pair<StringData, size_t>>& values,
+                                        std::vector<uint64_t>& ranks)
+{
+    std::sort(values.begin(), values.end(),
+              [](const std::pair<StringData, size_t>& a, const std::pair<StringData, size_t>& b) {
+                  if (a.first.is_null() || b.first.is_null())
+                      return a.first.is_null() && !b.first.is_null();
+                  return a.first != b.first && utf8_compare(a.first, b.first);
+              });
+    uint64_t rank = 0;
+    for (size_t k = 0; k < values.size(); ++k) {
+        if (k != 0 && (values[k].first.is_null() != values[k - 1].first.is_null() ||
+                       values[k].first != values[k - 1].first))
+            ++rank;
+        ranks[values[k].second] = rank;
+    }
+}
+
+// Flip the sign bit of positive values and all bits of negative ones, so that
+// the unsigned order of the bits is the order of the values
+inline uint64_t TableViewBase::get_sort_key(double value) REALM_NOEXCEPT
+{
+    if (value == 0)
+        value = 0; // -0.0 compares equal to 0.0
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof bits);
+    const uint64_t sign = uint64_t(1) << 63;
+    return bits & sign ? ~bits : bits | sign;
+}
+
+// Stable LSD radix sort on the key, one byte per pass. Passes over bytes that
+// are the same in all keys are skipped, so small integers, ranks and DateTimes
+// only take a few passes.
+inline void TableViewBase::radix_sort(std::vector<std::pair<uint64_t, size_t>>& items)
+{
+    size_t n = items.size();
+    std::vector<size_t> counts(8 * 256); // Throws
+    for (size_t k = 0; k < n; ++k) {
+        uint64_t key = items[k].first;
+        for (size_t b = 0; b < 8; ++b)
+            ++counts[b * 256 + ((key >> (8 * b)) & 0xFF)];
+    }
+
+    std::vector<std::pair<uint64_t, size_t>> buffer(n); // Throws
+    for (size_t b = 0; b < 8; ++b) {
+        size_t* count = &counts[b * 256];
+        if (count[(items[0].first >> (8 * b)) & 0xFF] == n)
+            continue;
+        size_t offset = 0;
+        for (size_t v = 0; v < 256; ++v) {
+            size_t c = count[v];
+            count[v] = offset;
+            offset += c;
+        }
+        for (size_t k = 0; k < n; ++k)
+            buffer[count[(items[k].first >> (8 * b)) & 0xFF]++] = items[k];
+        items.swap(buffer);
+    }
+}
+
+
 // Searching
 
 
@@ -1503,6 +1689,466 @@ inline void TableView::nullify_link(std::size_t column_ndx, std::size_t row_ndx)
     m_table->nullify_link(column_ndx, real_ndx);
 }
 
+
+
+// Multi-threaded Query execution. Defined here rather than in query.hpp
+// because it needs the complete Table and TableView types.
+
+inline bool Query::split_multi(size_t start, size_t& end, unsigned int threadcount, MultiChunks& chunks) const
+{
+    if (end == size_t(-1))
+        end = m_view ? m_view->size() : m_table->size();
+
+    // Restricting views are not safe to share between threads
+    if (m_view || start >= end)
+        return false;
+
+    unsigned int threads = threadcount;
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+
+    // Aim for several chunks per thread so that fast workers can take over
+    // work from slow ones, but never split a leaf between two chunks
+    const size_t leaf_size = REALM_MAX_BPNODE_SIZE;
+    const size_t chunks_per_thread = 8;
+    const size_t leaves = (end - start + leaf_size - 1) / leaf_size;
+    const size_t leaves_per_chunk = std::max<size_t>(1, leaves / (threads * chunks_per_thread));
+
+    chunks.chunk_size = leaves_per_chunk * leaf_size;
+    chunks.base = start - start % chunks.chunk_size;
+    chunks.chunk_count = (end - chunks.base + chunks.chunk_size - 1) / chunks.chunk_size;
+    chunks.threads = unsigned(std::min<size_t>(threads, chunks.chunk_count));
+
+    return chunks.threads > 1;
+}
+
+template<class F>
+void Query::execute_multi(size_t start, size_t end, const MultiChunks& chunks, F func) const
+{
+    // Each worker needs its own deep copy of the node tree, because nodes
+    // cache leaves and statistics while searching. The copies are made and
+    // initialized here, on the calling thread, since Init() touches the
+    // shared table accessors. The workers must only search them with
+    // FindInternal(), never through the public functions, which would
+    // initialize them again.
+    std::vector<std::unique_ptr<Query>> queries;
+    for (unsigned int t = 0; t < chunks.threads; ++t) {
+        queries.emplace_back(new Query(*this, TCopyExpressionTag())); // Throws
+        queries.back()->Init(*m_table);
+    }
+
+    // The first exception thrown by a worker stops the others at their next
+    // chunk, and is rethrown once all threads have finished
+    std::atomic<size_t> next_chunk(0);
+    std::exception_ptr error;
+    util::Mutex error_mutex;
+    auto worker = [&](const Query& query) {
+        try {
+            for (;;) {
+                size_t c = next_chunk++;
+                if (c >= chunks.chunk_count)
+                    return;
+                size_t chunk_start = std::max(start, chunks.base + c * chunks.chunk_size);
+                size_t chunk_end = std::min(end, chunks.base + (c + 1) * chunks.chunk_size);
+                func(query, chunk_start, chunk_end, c); // Throws
+            }
+        }
+        catch (...) {
+            util::LockGuard lock(error_mutex);
+            if (!error)
+                error = std::current_exception();
+            next_chunk = chunks.chunk_count;
+        }
+    };
+
+    // Joins the threads that were started, also when starting one of them
+    // throws
+    struct Joiner {
+        util::Thread* threads;
+        unsigned int num_started;
+        ~Joiner() REALM_NOEXCEPT
+        {
+            for (unsigned int t = 0; t < num_started; ++t)
+                threads[t].join();
+        }
+    };
+
+    // The calling thread works too
+    std::unique_ptr<util::Thread[]> threads(new util::Thread[chunks.threads - 1]);
+    {
+        Joiner joiner = { threads.get(), 0 };
+        try {
+            for (unsigned int t = 1; t < chunks.threads; ++t) {
+                const Query& query = *queries[t];
+                threads[t - 1].start([&worker, &query] { worker(query); }); // Throws
+                ++joiner.num_started;
+            }
+        }
+        catch (...) {
+            next_chunk = chunks.chunk_count;
+            throw;
+        }
+        worker(*queries[0]);
+    }
+    if (error)
+        std::rethrow_exception(error);
+}
+
+template<Action action, class R, class G>
+R Query::aggregate_multi(G get_value, size_t* resultcount, size_t start, size_t end, size_t* return_ndx,
+                         const MultiChunks& chunks) const
+{
+    // The result of a range without matches, as in QueryState::init()
+    R none = R();
+    if (action == act_Max) {
+        none = std::numeric_limits<R>::has_infinity ? -std::numeric_limits<R>::infinity() :
+            std::numeric_limits<R>::min();
+    }
+    else if (action == act_Min) {
+        none = std::numeric_limits<R>::has_infinity ? std::numeric_limits<R>::infinity() :
+            std::numeric_limits<R>::max();
+    }
+
+    struct Partial {
+        R value;
+        size_t count;
+        size_t ndx;
+    };
+    std::vector<Partial> partials(chunks.chunk_count);
+    execute_multi(start, end, chunks, [&](const Query& query, size_t chunk_start, size_t chunk_end, size_t c) {
+        Partial& p = partials[c];
+        p.value = action == act_Sum ? R() : none;
+        p.count = 0;
+        p.ndx = not_found;
+        for (size_t r = chunk_start; r < chunk_end; ++r) {
+            r = query.FindInternal(r, chunk_end);
+            if (r == not_found)
+                break;
+            if (action == act_Sum) {
+                p.value += get_value(r);
+            }
+            else if (action != act_Count) {
+                R value = get_value(r);
+                if (p.count == 0 || (action == act_Max ? value > p.value : value < p.value)) {
+                    p.value = value;
+                    p.ndx = r;
+                }
+            }
+            ++p.count;
+        }
+    });
+
+    // Merge in row order, so that ties go to the first row like in the
+    // single-threaded search
+    R result = action == act_Sum ? R() : none;
+    size_t ndx = not_found;
+    size_t count = 0;
+    for (const Partial& p : partials) {
+        if (p.count == 0)
+            continue;
+        if (action == act_Sum) {
+            result += p.value;
+        }
+        else if (count == 0 || (action == act_Max ? p.value > result : p.value < result)) {
+            result = p.value;
+            ndx = p.ndx;
+        }
+        count += p.count;
+    }
+
+    if (resultcount)
+        *resultcount = count;
+    if (return_ndx)
+        *return_ndx = ndx;
+    return result;
+}
+
+inline void Query::find_all_multi(TableViewBase& tv, size_t start, size_t end, unsigned int threadcount) const
+{
+    MultiChunks chunks;
+    if (!split_multi(start, end, threadcount, chunks)) {
+        find_all(tv, start, end);
+        return;
+    }
+
+    std::vector<std::vector<size_t>> matches(chunks.chunk_count);
+    execute_multi(start, end, chunks, [&](const Query& query, size_t chunk_start, size_t chunk_end, size_t c) {
+        for (size_t r = chunk_start; r < chunk_end; ++r) {
+            r = query.FindInternal(r, chunk_end);
+            if (r == not_found)
+                break;
+            matches[c].push_back(r);
+        }
+    });
+
+    for (const std::vector<size_t>& m : matches) {
+        for (size_t r : m)
+            tv.m_row_indexes.add(r);
+    }
+}
+
+// The view holds the query, like the one returned by find_all(), so that it
+// can be brought up to date after the table changes. That re-runs the query
+// single-threaded.
+
+inline TableView Query::find_all_multi(size_t start, size_t end, unsigned int threadcount)
+{
+    TableView tv(*m_table, *this, start, end, size_t(-1));
+    find_all_multi(tv, start, end, threadcount);
+    return tv;
+}
+
+inline ConstTableView Query::find_all_multi(size_t start, size_t end, unsigned int threadcount) const
+{
+    TableView tv(*m_table, const_cast<Query&>(*this), start, end, size_t(-1));
+    find_all_multi(tv, start, end, threadcount);
+    return ConstTableView(std::move(tv));
+}
+
+inline size_t Query::count_multi(size_t start, size_t end, unsigned int threadcount) const
+{
+    MultiChunks chunks;
+    if (!split_multi(start, end, threadcount, chunks))
+        return count(start, end);
+    size_t count = 0;
+    aggregate_multi<act_Count, size_t>([](size_t) { return size_t(0); }, &count, start, end, nullptr, chunks);
+    return count;
+}
+
+inline int64_t Query::sum_int_multi(size_t column_ndx, size_t* resultcount, size_t start, size_t end,
+                                    unsigned int threadcount) const
+{
+    MultiChunks chunks;
+    if (!split_multi(start, end, threadcount, chunks))
+        return sum_int(column_ndx, resultcount, start, end);
+    const Table& table = *m_table;
+    return aggregate_multi<act_Sum, int64_t>([&table, column_ndx](size_t row_ndx) {
+        return table.get_int(column_ndx, row_ndx);
+    }, resultcount, start, end, nullptr, chunks);
+}
+
+inline double Query::average_int_multi(size_t column_ndx, size_t* resultcount, size_t start, size_t end,
+                                       unsigned int threadcount) const
+{
+    size_t count;
+    int64_t sum = sum_int_multi(column_ndx, &count, start, end, threadcount);
+    if (resultcount)
+        *resultcount = count;
+    return count == 0 ? 0 : double(sum) / count;
+}
+
+inline int64_t Query::maximum_int_multi(size_t column_ndx, size_t* resultcount, size_t start, size_t end,
+                                        size_t* return_ndx, unsigned int threadcount) const
+{
+    MultiChunks chunks;
+    if (!split_multi(start, end, threadcount, chunks))
+        return maximum_int(column_ndx, resultcount, start, end, size_t(-1), return_ndx);
+    const Table& table = *m_table;
+    return aggregate_multi<act_Max, int64_t>([&table, column_ndx](size_t row_ndx) {
+        return table.get_int(column_ndx, row_ndx);
+    }, resultcount, start, end, return_ndx, chunks);
+}
+
+inline int64_t Query::minimum_int_multi(size_t column_ndx, size_t* resultcount, size_t start, size_t end,
+                                        size_t* return_ndx, unsigned int threadcount) const
+{
+    MultiChunks chunks;
+    if (!split_multi(start, end, threadcount, chunks))
+        return minimum_int(column_ndx, resultcount, start, end, size_t(-1), return_ndx);
+    const Table& table = *m_table;
+    return aggregate_multi<act_Min, int64_t>([&table, column_ndx](size_t row_ndx) {
+        return table.get_int(column_ndx, row_ndx);
+    }, resultcount, start, end, return_ndx, chunks);
+}
+
+inline double Query::sum_float_multi(size_t column_ndx, size_t* resultcount, size_t start, size_t end,
+                                     unsigned int threadcount) const
+{
+    MultiChunks chunks;
+    if (!split_multi(start, end, threadcount, chunks))
+        return sum_float(column_ndx, resultcount, start, end);
+    const Table& table = *m_table;
+    return aggregate_multi<act_Sum, double>([&table, column_ndx](size_t row_ndx) {
+        return table.get_float(column_ndx, row_ndx);
+    }, resultcount, start, end, nullptr, chunks);
+}
+
+inline double Query::average_float_multi(size_t column_ndx, size_t* resultcount, size_t start, size_t end,
+                                         unsigned int threadcount) const
+{
+    size_t count;
+    double sum = sum_float_multi(column_ndx, &count, start, end, threadcount);
+    if (resultcount)
+        *resultcount = count;
+    return count == 0 ? 0 : sum / count;
+}
+
+inline float Query::maximum_float_multi(size_t column_ndx, size_t* resultcount, size_t start, size_t end,
+                                        size_t* return_ndx, unsigned int threadcount) const
+{
+    MultiChunks chunks;
+    if (!split_multi(start, end, threadcount, chunks))
+        return maximum_float(column_ndx, resultcount, start, end, size_t(-1), return_ndx);
+    const Table& table = *m_table;
+    return aggregate_multi<act_Max, float>([&table, column_ndx](size_t row_ndx) {
+        return table.get_float(column_ndx, row_ndx);
+    }, resultcount, start, end, return_ndx, chunks);
+}
+
+inline float Query::minimum_float_multi(size_t column_ndx, size_t* resultcount, size_t start, size_t end,
+                                        size_t* return_ndx, unsigned int threadcount) const
+{
+    MultiChunks chunks;
+    if (!split_multi(start, end, threadcount, chunks))
+        return minimum_float(column_ndx, resultcount, start, end, size_t(-1), return_ndx);
+    const Table& table = *m_table;
+    return aggregate_multi<act_Min, float>([&table, column_ndx](size_t row_ndx) {
+        return table.get_float(column_ndx, row_ndx);
+    }, resultcount, start, end, return_ndx, chunks);
+}
+
+inline double Query::sum_double_multi(size_t column_ndx, size_t* resultcount, size_t start, size_t end,
+                                      unsigned int threadcount) const
+{
+    MultiChunks chunks;
+    if (!split_multi(start, end, threadcount, chunks))
+        return sum_double(column_ndx, resultcount, start, end);
+    const Table& table = *m_table;
+    return aggregate_multi<act_Sum, double>([&table, column_ndx](size_t row_ndx) {
+        return table.get_double(column_ndx, row_ndx);
+    }, resultcount, start, end, nullptr, chunks);
+}
+
+inline double Query::average_double_multi(size_t column_ndx, size_t* resultcount, size_t start, size_t end,
+                                          unsigned int threadcount) const
+{
+    size_t count;
+    double sum = sum_double_multi(column_ndx, &count, start, end, threadcount);
+    if (resultcount)
+        *resultcount = count;
+    return count == 0 ? 0 : sum / count;
+}
+
+inline double Query::maximum_double_multi(size_t column_ndx, size_t* resultcount, size_t start, size_t end,
+                                          size_t* return_ndx, unsigned int threadcount) const
+{
+    MultiChunks chunks;
+    if (!split_multi(start, end, threadcount, chunks))
+        return maximum_double(column_ndx, resultcount, start, end, size_t(-1), return_ndx);
+    const Table& table = *m_table;
+    return aggregate_multi<act_Max, double>([&table, column_ndx](size_t row_ndx) {
+        return table.get_double(column_ndx, row_ndx);
+    }, resultcount, start, end, return_ndx, chunks);
+}
+
+inline double Query::minimum_double_multi(size_t column_ndx, size_t* resultcount, size_t start, size_t end,
+                                          size_t* return_ndx, unsigned int threadcount) const
+{
+    MultiChunks chunks;
+    if (!split_multi(start, end, threadcount, chunks))
+        return minimum_double(column_ndx, resultcount, start, end, size_t(-1), return_ndx);
+    const Table& table = *m_table;
+    return aggregate_multi<act_Min, double>([&table, column_ndx](size_t row_ndx) {
+        return table.get_double(column_ndx, row_ndx);
+    }, resultcount, start, end, return_ndx, chunks);
+}
+
+
+
+// Top-K. Defined here for the same reason as the multi-threaded execution.
+
+inline void Query::find_top_k(TableViewBase& tv, RowIndexes::Sorter& order, size_t k, size_t start,
+                              size_t end) const
+{
+    if (k == 0)
+        return;
+
+    // The rows of a restricting view are not in table order, so all matches are sorted instead
+    if (m_view) {
+        find_all(tv, start, end);
+        tv.sort(order);
+        if (tv.size() > k) {
+            std::vector<size_t> rows;
+            rows.reserve(k);
+            for (size_t t = 0; t < k; ++t)
+                rows.push_back(size_t(tv.m_row_indexes.get(t)));
+            tv.m_row_indexes.clear();
+            for (size_t r : rows)
+                tv.m_row_indexes.add(r);
+        }
+        return;
+    }
+
+    if (end == size_t(-1))
+        end = m_table->size();
+
+    Init(*m_table);
+    order.init(&tv);
+
+    // Order of the sorted view, with ties in table order
+    auto before = [&order](size_t a, size_t b) {
+        return order(a, b) || (!order(b, a) && a < b);
+    };
+
+    // Heap of the best k rows so far, with the last of them in front. Matches arrive in table order, so a match
+    // that sorts equal to the front row never replaces it.
+    std::vector<size_t> heap;
+    for (size_t r = start; r < end; ++r) {
+        r = FindInternal(r, end);
+        if (r == not_found)
+            break;
+        if (heap.size() < k) {
+            heap.push_back(r);
+            std::push_heap(heap.begin(), heap.end(), before);
+        }
+        else if (before(r, heap.front())) {
+            std::pop_heap(heap.begin(), heap.end(), before);
+            heap.back() = r;
+            std::push_heap(heap.begin(), heap.end(), before);
+        }
+    }
+
+    std::sort_heap(heap.begin(), heap.end(), before);
+    for (size_t r : heap)
+        tv.m_row_indexes.add(r);
+}
+
+inline TableView Query::find_top_k(size_t column_ndx, bool ascending, size_t k, size_t start, size_t end)
+{
+    return find_top_k(std::vector<size_t>(1, column_ndx), std::vector<bool>(1, ascending), k, start, end);
+}
+
+inline ConstTableView Query::find_top_k(size_t column_ndx, bool ascending, size_t k, size_t start,
+                                        size_t end) const
+{
+    return find_top_k(std::vector<size_t>(1, column_ndx), std::vector<bool>(1, ascending), k, start, end);
+}
+
+// The view holds the query and the sort order, so that bringing it up to date
+// after the table changes re-runs the query and sorts all of its matches.
+
+inline TableView Query::find_top_k(std::vector<size_t> column_ndxs, std::vector<bool> ascending, size_t k,
+                                   size_t start, size_t end)
+{
+    TableView tv(*m_table, *this, start, end, size_t(-1));
+    RowIndexes::Sorter order(column_ndxs, ascending);
+    find_top_k(tv, order, k, start, end);
+    tv.m_sorting_predicate = RowIndexes::Sorter(column_ndxs, ascending);
+    tv.m_auto_sort = true;
+    return tv;
+}
+
+inline ConstTableView Query::find_top_k(std::vector<size_t> column_ndxs, std::vector<bool> ascending, size_t k,
+                                        size_t start, size_t end) const
+{
+    TableView tv(*m_table, const_cast<Query&>(*this), start, end, size_t(-1));
+    RowIndexes::Sorter order(column_ndxs, ascending);
+    find_top_k(tv, order, k, start, end);
+    tv.m_sorting_predicate = RowIndexes::Sorter(column_ndxs, ascending);
+    tv.m_auto_sort = true;
+    return ConstTableView(std::move(tv));
+}
+
 } // namespace realm
 
 #endif // REALM_TABLE_VIEW_HPP
@@ -0,0 +1,304 @@
+/*************************************************************************
+ *
+ * REALM CONFIDENTIAL
+ * __________________
+ *
+ *  [2011] - [2015] Realm Inc
+ *  All Rights Reserved.
+ *
+ * NOTICE:  All information contained herein is, and remains
+ * the property of Realm Incorporated and its suppliers,
+ * if any.  The intellectual and technical concepts contained
+ * herein are proprietary to Realm Incorporated
+ * and its suppliers and may be covered by U.S. and Foreign Patents,
+ * patents in process, and are protected by trade secret or copyright law.
+ * Dissemination of this information or reproduction of this material
+ * is strictly forbidden unless prior written permission is obtained
+ * from Realm Incorporated.
+ *
+ **************************************************************************/
+#ifndef REALM_UTIL_COMPRESSION_HPP
+#define REALM_UTIL_COMPRESSION_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <stdint.h>
+#include <vector>
+
+#include <realm/util/features.h>
+
+namespace realm {
+namespace util {
+namespace compression {
+
+/// A fast byte oriented LZ77 codec in the style of LZ4.
+///
+/// A compressed block is a sequence of sequences. Each sequence is a token
+/// byte, whose high nibble is the number of literals and whose low nibble is
+/// the match length minus 4 (the value 15 means that more length bytes
+/// follow, each adding up to 255), the literals, a 16-bit little endian match
+/// offset, and the extra match length bytes. The last sequence has literals
+/// only, and ends the block.
+///
+/// A dictionary is a sequence of bytes that is logically placed in front of
+/// the input, so that matches can refer back into it. This makes small values
+/// that share a lot of structure, like JSON documents with the same keys,
+/// compressible on their own. The same dictionary must be passed to
+/// decompress().
+
+/// The maximum compressed size of \a size bytes of input.
+std::size_t compress_bound(std::size_t size) REALM_NOEXCEPT;
+
+/// Compress \a in_size bytes from \a in into \a out, which has room for \a
+/// out_capacity bytes. Returns the compressed size, or zero if it would exceed
+/// \a out_capacity. Only the last 64 KiB of the dictionary is used.
+std::size_t compress(const char* in, std::size_t in_size, char* out, std::size_t out_capacity,
+                     const char* dict = nullptr, std::size_t dict_size = 0);
+
+/// Decompress \a in_size bytes from \a in into \a out, which must be exactly
+/// \a out_size bytes, the size of the uncompressed data. Returns false if the
+/// input is not a valid compressed block of that size.
+bool decompress(const char* in, std::size_t in_size, char* out, std::size_t out_size,
+                const char* dict = nullptr, std::size_t dict_size = 0) REALM_NOEXCEPT;
+
+
+
+
+// Implementation:
+
+namespace _impl {
+
+const int hash_log = 12;
+const std::size_t min_match = 4;
+const std::size_t max_offset = 0xFFFF;
+const std::size_t last_literals = 5;
+
+inline uint32_t read_32(const char* p) REALM_NOEXCEPT
+{
+    uint32_t v;
+    std::memcpy(&v, p, 4);
+    return v;
+}
+
+inline uint32_t hash_32(uint32_t v) REALM_NOEXCEPT
+{
+    return (v * 2654435761U) >> (32 - hash_log);
+}
+
+class Writer {
+public:
+    Writer(char* out, std::size_t capacity) REALM_NOEXCEPT:
+        m_out(out), m_end(out + capacity), m_pos(out) {}
+
+    bool put(char c) REALM_NOEXCEPT
+    {
+        if (m_pos == m_end)
+            return false;
+        *m_pos++ = c;
+        return true;
+    }
+
+    bool put(const char* data, std::size_t size) REALM_NOEXCEPT
+    {
+        if (std::size_t(m_end - m_pos) < size)
+            return false;
+        std::memcpy(m_pos, data, size);
+        m_pos += size;
+        return true;
+    }
+
+    bool put_length(std::size_t length) REALM_NOEXCEPT
+    {
+        for (;;) {
+            if (length < 255)
+                return put(char(length));
+            if (!put(char(255)))
+                return false;
+            length -= 255;
+        }
+    }
+
+    std::size_t size() const REALM_NOEXCEPT
+    {
+        return m_pos - m_out;
+    }
+
+private:
+    char* const m_out;
+    char* const m_end;
+    char* m_pos;
+};
+
+// A match length of zero means a literals only sequence
+inline bool put_sequence(Writer& out, const char* literals, std::size_t num_literals,
+                         std::size_t offset, std::size_t match_length) REALM_NOEXCEPT
+{
+    std::size_t extra_match = match_length == 0 ? 0 : match_length - min_match;
+    int lit_nibble = num_literals < 15 ? int(num_literals) : 15;
+    int match_nibble = extra_match < 15 ? int(extra_match) : 15;
+    if (!out.put(char(lit_nibble << 4 | match_nibble)))
+        return false;
+    if (lit_nibble == 15 && !out.put_length(num_literals - 15))
+        return false;
+    if (!out.put(literals, num_literals))
+        return false;
+    if (match_length == 0)
+        return true;
+    if (!out.put(char(offset & 0xFF)) || !out.put(char(offset >> 8)))
+        return false;
+    if (match_nibble == 15 && !out.put_length(extra_match - 15))
+        return false;
+    return true;
+}
+
+inline bool get_length(const unsigned char*& in, const unsigned char* in_end,
+                       std::size_t& length) REALM_NOEXCEPT
+{
+    for (;;) {
+        if (in == in_end)
+            return false;
+        unsigned char c = *in++;
+        length += c;
+        if (c != 255)
+            return true;
+    }
+}
+
+} // namespace _impl
+
+inline std::size_t compress_bound(std::size_t size) REALM_NOEXCEPT
+{
+    return size + size / 255 + 16;
+}
+
+inline std::size_t compress(const char* in, std::size_t in_size, char* out,
+                            std::size_t out_capacity, const char* dict, std::size_t dict_size)
+{
+    using namespace _impl;
+
+    if (dict_size > max_offset) {
+        dict += dict_size - max_offset;
+        dict_size = max_offset;
+    }
+
+    // Matches are searched in a window that is the dictionary followed by
+    // the input, so that they can cross from one into the other.
+    std::vector<char> window_buffer;
+    const char* window = in;
+    if (dict_size != 0) {
+        window_buffer.resize(dict_size + in_size); // Throws
+        std::memcpy(window_buffer.data(), dict, dict_size);
+        std::memcpy(window_buffer.data() + dict_size, in, in_size);
+        window = window_buffer.data();
+    }
+    std::size_t begin = dict_size;
+    std::size_t end = dict_size + in_size;
+
+    // Positions plus one, so that zero means empty
+    std::vector<uint32_t> table(std::size_t(1) << hash_log, 0); // Throws
+    for (std::size_t i = 0; i + min_match <= dict_size; ++i)
+        table[hash_32(read_32(window + i))] = uint32_t(i + 1);
+
+    Writer writer(out, out_capacity);
+    std::size_t anchor = begin;
+    std::size_t pos = begin;
+    if (in_size > last_literals + min_match) {
+        std::size_t match_limit = end - last_literals;
+        while (pos + min_match <= match_limit) {
+            uint32_t seq = read_32(window + pos);
+            uint32_t& slot = table[hash_32(seq)];
+            std::size_t candidate = slot;
+            slot = uint32_t(pos + 1);
+            if (candidate == 0 || pos - (candidate - 1) > max_offset ||
+                    read_32(window + candidate - 1) != seq) {
+                ++pos;
+                continue;
+            }
+            --candidate;
+
+            std::size_t length = min_match;
+            while (pos + length < match_limit && window[candidate + length] == window[pos + length])
+                ++length;
+            if (!put_sequence(writer, window + anchor, pos - anchor, pos - candidate, length))
+                return 0;
+
+            // Index a position inside the match, so that repeated runs are
+            // found again without indexing every byte
+            std::size_t inside = pos + length - 2;
+            table[hash_32(read_32(window + inside))] = uint32_t(inside + 1);
+
+            pos += length;
+            anchor = pos;
+        }
+    }
+    if (!put_sequence(writer, window + anchor, end - anchor, 0, 0))
+        return 0;
+    return writer.size();
+}
+
+inline bool decompress(const char* in, std::size_t in_size, char* out, std::size_t out_size,
+                       const char* dict, std::size_t dict_size) REALM_NOEXCEPT
+{
+    using namespace _impl;
+
+    if (dict_size > max_offset) {
+        dict += dict_size - max_offset;
+        dict_size = max_offset;
+    }
+
+    const unsigned char* ip = reinterpret_cast<const unsigned char*>(in);
+    const unsigned char* ip_end = ip + in_size;
+    std::size_t op = 0;
+    for (;;) {
+        if (ip == ip_end)
+            return false;
+        unsigned char token = *ip++;
+
+        std::size_t num_literals = token >> 4;
+        if (num_literals == 15 && !get_length(ip, ip_end, num_literals))
+            return false;
+        if (std::size_t(ip_end - ip) < num_literals || out_size - op < num_literals)
+            return false;
+        std::memcpy(out + op, ip, num_literals);
+        ip += num_literals;
+        op += num_literals;
+
+        if (ip == ip_end)
+            return op == out_size;
+
+        if (ip_end - ip < 2)
+            return false;
+        std::size_t offset = std::size_t(ip[0]) | std::size_t(ip[1]) << 8;
+        ip += 2;
+        std::size_t length = token & 0x0F;
+        if (length == 15 && !get_length(ip, ip_end, length))
+            return false;
+        length += min_match;
+        if (offset == 0 || offset > op + dict_size || out_size - op < length)
+            return false;
+
+        // The part of the match that lies in the dictionary
+        if (offset > op) {
+            std::size_t from = dict_size - (offset - op);
+            std::size_t n = std::min(length, dict_size - from);
+            std::memcpy(out + op, dict + from, n);
+            op += n;
+            length -= n;
+        }
+        // Byte by byte, because the match may overlap its own output
+        if (length != 0) {
+            const char* from = out + op - offset;
+            char* to = out + op;
+            for (std::size_t i = 0; i < length; ++i)
+                to[i] = from[i];
+            op += length;
+        }
+    }
+}
+
+} // namespace compression
+} // namespace util
+} // namespace realm
+
+#endif // REALM_UTIL_COMPRESSION_HPP
@@ -74,6 +74,19 @@
 #define REALM_HAVE_AT_LEAST_GCC(maj, min) \
     (__GNUC__ > (maj) || __GNUC__ == (maj) && __GNUC_MINOR__ >= (min))
 
+/* Compiler is Clang and version is greater than or equal to the specified
+ * version. Apple ships Clang with its own version numbers, so they are given
+ * separately. */
+#if defined __clang__ && defined __apple_build_version__
+#  define REALM_HAVE_AT_LEAST_CLANG(maj, min, apple_maj, apple_min) \
+    (__clang_major__ > (apple_maj) || __clang_major__ == (apple_maj) && __clang_minor__ >= (apple_min))
+#elif defined __clang__
+#  define REALM_HAVE_AT_LEAST_CLANG(maj, min, apple_maj, apple_min) \
+    (__clang_major__ > (maj) || __clang_major__ == (maj) && __clang_minor__ >= (min))
+#else
+#  define REALM_HAVE_AT_LEAST_CLANG(maj, min, apple_maj, apple_min) 0
+#endif
+
 #if __clang__
 #  define REALM_HAVE_CLANG_FEATURE(feature) __has_feature(feature)
 #else
@@ -58,6 +58,16 @@
 #  define REALM_COMPILER_AVX
 #endif
 
+// AVX2 and AVX-512 kernels are compiled with per-function target attributes, so the rest of the library can still be
+// built for plain x86-64 and the kernels are only entered after runtime detection (see sseavx()). The AVX-512 BW
+// target and its __builtin_cpu_supports() name need GCC 7, or Clang 5 (Apple Clang 9.1).
+#if defined(REALM_COMPILER_AVX) && (REALM_HAVE_AT_LEAST_CLANG(5, 0, 9, 1) || \
+                                    (!defined(__clang__) && REALM_HAVE_AT_LEAST_GCC(7, 0)))
+#  define REALM_COMPILER_AVX2
+#  define REALM_TARGET_AVX2 __attribute__((target("avx2")))
+#  define REALM_TARGET_AVX512 __attribute__((target("avx512f,avx512bw")))
+#endif
+
 namespace realm {
 
 typedef bool(*StringCompareCallback)(const char* string1, const char* string2);
@@ -65,6 +75,27 @@ typedef bool(*StringCompareCallback)(const char* string1, const char* string2);
 extern signed char sse_support;
 extern signed char avx_support;
 
+// cpuid_init() does not detect AVX2 and AVX-512, so they are probed here on first use.
+//  -1: Neither supported
+//   0: AVX2
+//   1: AVX2 and AVX-512 (F + BW)
+inline signed char avx_extended_support()
+{
+#ifdef REALM_COMPILER_AVX2
+    static const signed char support = []() -> signed char {
+        __builtin_cpu_init();
+        if (!__builtin_cpu_supports("avx2"))
+            return -1;
+        if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw"))
+            return 1;
+        return 0;
+    }();
+    return support;
+#else
+    return -1;
+#endif
+}
+
 template<int version> REALM_FORCEINLINE bool sseavx()
 {
 /*
@@ -77,7 +108,9 @@ template<int version> REALM_FORCEINLINE bool sseavx()
 
     avx_support = -1: No AVX support
     avx_support = 0: AVX1 supported
-    sse_support = 1: AVX2 supported (not yet implemented for detection in our cpuid_init(), todo)
+
+    AVX2 (version = 2) and AVX-512 (version = 512) are reported by avx_extended_support() instead, because our
+    cpuid_init() only detects AVX1.
 
     This lets us test very rapidly at runtime because we just need 1 compare instruction (with 0) to test both for
     SSE 3 and 4.2 by caller (compiler optimizes if calls are concecutive), and can decide branch with ja/jl/je because
@@ -86,7 +119,7 @@ template<int version> REALM_FORCEINLINE bool sseavx()
     We runtime-initialize sse_support in a constructor of a static variable which is not guaranteed to be called
     prior to cpu_sse(). So we compile-time initialize sse_support to -2 as fallback.
 */
-    REALM_STATIC_ASSERT(version == 1 || version == 2 || version == 30 || version == 42, "Only version == 1 (AVX), 2 (AVX2), 30 (SSE 3) and 42 (SSE 4.2) are supported for detection");
+    REALM_STATIC_ASSERT(version == 1 || version == 2 || version == 30 || version == 42 || version == 512, "Only version == 1 (AVX), 2 (AVX2), 30 (SSE 3), 42 (SSE 4.2) and 512 (AVX-512) are supported for detection");
 #ifdef REALM_COMPILER_SSE
     if (version == 30)
         return (sse_support >= 0);
@@ -95,7 +128,9 @@ template<int version> REALM_FORCEINLINE bool sseavx()
     else if (version == 1) // avx
         return (avx_support >= 0);
     else if (version == 2) // avx2
-        return (avx_support > 0);
+        return (avx_extended_support() >= 0);
+    else if (version == 512) // avx-512 f + bw
+        return (avx_extended_support() > 0);
 
 #else
     return false;
@@ -0,0 +1,971 @@
+/*************************************************************************
+ *
+ * REALM CONFIDENTIAL
+ * __________________
+ *
+ *  [2011] - [2015] Realm Inc
+ *  All Rights Reserved.
+ *
+ * NOTICE:  All information contained herein is, and remains
+ * the property of Realm Incorporated and its suppliers,
+ * if any.  The intellectual and technical concepts contained
+ * herein are proprietary to Realm Incorporated
+ * and its suppliers and may be covered by U.S. and Foreign Patents,
+ * patents in process, and are protected by trade secret or copyright law.
+ * Dissemination of this information or reproduction of this material
+ * is strictly forbidden unless prior written permission is obtained
+ * from Realm Incorporated.
+ *
+ **************************************************************************/
+#ifndef REALM_VIEW_UPDATER_HPP
+#define REALM_VIEW_UPDATER_HPP
+
+#include <algorithm>
+#include <vector>
+
+#include <realm/impl/transact_log.hpp>
+#include <realm/table.hpp>
+#include <realm/table_view.hpp>
+#include <realm/link_view.hpp>
+#include <realm/group_shared.hpp>
+#include <realm/lang_bind_helper.hpp>
+
+#ifdef REALM_ENABLE_REPLICATION
+
+namespace realm {
+
+/// The changes to the rows of a view across one advance of the transaction,
+/// as positions in the view.
+struct ViewChangeSet {
+    /// Positions before the advance of the rows that left the view.
+    std::vector<std::size_t> deletions;
+    /// Positions after the advance of the rows that entered the view.
+    std::vector<std::size_t> insertions;
+    /// Positions after the advance of the rows that stayed in the view and
+    /// were set.
+    std::vector<std::size_t> modifications;
+    /// Rows that stayed in the view, but changed places relative to the other
+    /// rows that stayed, as pairs of the position before and after.
+    std::vector<std::pair<std::size_t, std::size_t>> moves;
+    /// The changes are not known, and the whole view must be reloaded.
+    bool reload = false;
+
+    bool empty() const REALM_NOEXCEPT
+    {
+        return !reload && deletions.empty() && insertions.empty() && modifications.empty() &&
+            moves.empty();
+    }
+};
+
+/// Keeps live TableViews up to date across transactions by applying the
+/// changes in the transaction logs to them, instead of rerunning their
+/// queries.
+///
+/// Register views with add_view(), and advance the read transaction through
+/// LangBindHelper::advance_read(SharedGroup&, History&, ViewUpdater&) or
+/// LangBindHelper::promote_to_write(SharedGroup&, History&, ViewUpdater&).
+/// While the logs are parsed, the updater records for each group level table
+/// how rows were inserted, erased and moved, and which rows were set. After
+/// the group has advanced, each registered view that was in sync before
+/// renumbers its rows, drops the erased ones, and tests only the inserted and
+/// set rows against its query. Matching rows are placed in table order, or by
+/// binary search in the order of a sorted view. The view is then in sync, so
+/// sync_if_needed() has nothing to do.
+///
+/// Views are left for sync_if_needed() to rerun when the changes cannot be
+/// applied to them. This is the case for views from a LinkView, distinct
+/// views, views from a query that is restricted by another view or has a
+/// start, end or limit, after changes to the schema or to subtables, after
+/// changes to other tables when the table of the view has link columns, and
+/// when more than \a max_changed_rows rows of the table have changed.
+///
+/// Each advance also gives every registered view a ViewChangeSet, through
+/// get_changes(). It is computed from the same log instructions, so the
+/// caller does not have to diff the rows of the view. A view that had to be
+/// left for sync_if_needed() gets a change set that asks for a reload.
+///
+/// LinkViews can be registered too. They are always kept in sync by the
+/// core, so only their change sets are computed, from the link list
+/// instructions and the changes to the rows of the target table.
+///
+/// A registered view must be removed before it is destroyed.
+class ViewUpdater: public _impl::NullInstructionObserver {
+public:
+    explicit ViewUpdater(std::size_t max_changed_rows = 1000);
+
+    void add_view(TableViewBase&);
+    void add_view(LinkView&);
+    void remove_view(TableViewBase&);
+    void remove_view(LinkView&);
+
+    /// The changes to the specified registered view in the last call of
+    /// update_views().
+    const ViewChangeSet& get_changes(const TableViewBase&) const REALM_NOEXCEPT;
+    const ViewChangeSet& get_changes(const LinkView&) const REALM_NOEXCEPT;
+
+    /// Apply the changes parsed since the previous call to the registered
+    /// views, and forget them. Returns the number of views that were updated
+    /// without rerunning their query. Must be called after the group has
+    /// advanced, which the LangBindHelper overloads do.
+    std::size_t update_views();
+
+    // Instruction handler interface of TransactLogParser
+    bool select_table(std::size_t group_level_ndx, std::size_t levels, const std::size_t* path);
+    bool select_descriptor(std::size_t levels, const std::size_t* path);
+    bool select_link_list(std::size_t col_ndx, std::size_t row_ndx);
+    bool insert_group_level_table(std::size_t, std::size_t, StringData);
+    bool erase_group_level_table(std::size_t, std::size_t);
+
+    bool insert_empty_rows(std::size_t row_ndx, std::size_t num_rows_to_insert, std::size_t prior_num_rows,
+                           bool unordered);
+    bool erase_rows(std::size_t row_ndx, std::size_t num_rows_to_erase, std::size_t prior_num_rows,
+                    bool unordered);
+    bool clear_table();
+    bool set_int(std::size_t, std::size_t row_ndx, int_fast64_t) { return set_row(row_ndx); }
+    bool set_bool(std::size_t, std::size_t row_ndx, bool) { return set_row(row_ndx); }
+    bool set_float(std::size_t, std::size_t row_ndx, float) { return set_row(row_ndx); }
+    bool set_double(std::size_t, std::size_t row_ndx, double) { return set_row(row_ndx); }
+    bool set_string(std::size_t, std::size_t row_ndx, StringData) { return set_row(row_ndx); }
+    bool set_binary(std::size_t, std::size_t row_ndx, BinaryData) { return set_row(row_ndx); }
+    bool set_date_time(std::size_t, std::size_t row_ndx, DateTime) { return set_row(row_ndx); }
+    bool set_table(std::size_t, std::size_t row_ndx) { return set_row(row_ndx); }
+    bool set_mixed(std::size_t, std::size_t row_ndx, const Mixed&) { return set_row(row_ndx); }
+    bool set_link(std::size_t, std::size_t row_ndx, std::size_t) { return set_row(row_ndx); }
+    bool set_null(std::size_t, std::size_t row_ndx) { return set_row(row_ndx); }
+    bool nullify_link(std::size_t, std::size_t row_ndx) { return set_row(row_ndx); }
+
+    bool insert_link_column(std::size_t, DataType, StringData, std::size_t, std::size_t) { return set_schema(); }
+    bool insert_column(std::size_t, DataType, StringData, bool) { return set_schema(); }
+    bool erase_link_column(std::size_t, std::size_t, std::size_t) { return set_schema(); }
+    bool erase_column(std::size_t) { return set_schema(); }
+
+    bool link_list_set(std::size_t link_ndx, std::size_t);
+    bool link_list_insert(std::size_t link_ndx, std::size_t);
+    bool link_list_move(std::size_t old_link_ndx, std::size_t new_link_ndx);
+    bool link_list_swap(std::size_t link1_ndx, std::size_t link2_ndx);
+    bool link_list_erase(std::size_t link_ndx);
+    bool link_list_nullify(std::size_t link_ndx);
+    bool link_list_clear(std::size_t);
+
+    void parse_complete();
+
+private:
+    // A change to the row numbering of a table
+    struct RowOp {
+        enum Kind { insert, erase, move_last_over };
+        Kind kind;
+        std::size_t row_ndx;
+        std::size_t num_rows;
+        std::size_t prior_num_rows;
+    };
+
+    struct TableChanges {
+        bool changed = false;
+        // The changes cannot be applied, views must rerun their query
+        bool full = false;
+        // All rows that existed before were erased
+        bool cleared = false;
+        // The number of rows before the first insert or erase, or npos if
+        // the number of rows did not change
+        std::size_t prior_num_rows = npos;
+        std::vector<RowOp> ops;
+        // Inserted and set rows, numbered as after all of the ops
+        std::vector<std::size_t> rows;
+    };
+
+    // A link of a tracked link list, identified by its position before the
+    // advance, or npos if it was inserted
+    struct Slot {
+        std::size_t old_ndx;
+        bool modified;
+    };
+
+    struct View {
+        TableViewBase* view = nullptr;
+        LinkView* link_view = nullptr;
+        bool was_in_sync = false;
+        ViewChangeSet changes;
+
+        // Link lists only: the origin of the list as the log is parsed, and
+        // its links once the first link list instruction is seen
+        bool tracked = false;
+        bool erased = false;
+        std::size_t origin_table_ndx = npos;
+        std::size_t origin_col_ndx = npos;
+        std::size_t origin_row_ndx = npos;
+        std::size_t old_size = 0;
+        bool has_slots = false;
+        std::vector<Slot> slots;
+    };
+
+    std::size_t m_max_changed_rows;
+    std::vector<View> m_views;
+    std::vector<TableChanges> m_tables;
+    TableChanges* m_selected = nullptr;
+    // Group level index of the selected table, npos if a subtable is selected
+    std::size_t m_selected_ndx = npos;
+    std::size_t m_link_list_row = 0;
+    // Registered link views of the selected link list
+    std::vector<std::size_t> m_selected_lists;
+    bool m_all_full = false;
+    bool m_parsing = false;
+    bool m_parsed = false;
+
+    TableChanges& get_table_changes(std::size_t group_level_ndx);
+    void begin_parse();
+    bool set_row(std::size_t row_ndx);
+    bool set_schema();
+    bool set_link_list();
+    void renumber_rows(TableChanges&, const RowOp&);
+    void renumber_lists(const RowOp&);
+    void compact_rows(TableChanges&);
+    std::vector<Slot>* get_slots(View&);
+
+    // The number that `row` gets from ops[first_op] on, or npos if it is
+    // erased
+    static std::size_t map_row(std::size_t row, const std::vector<RowOp>& ops, std::size_t first_op = 0);
+    static bool has_link_columns(const Table&);
+    bool other_tables_changed(std::size_t table_ndx) const;
+    bool any_table_changed() const;
+    bool update_view(View&);
+    void update_link_view(View&);
+    static void find_moves(const std::vector<std::pair<std::size_t, std::size_t>>& kept,
+                           std::vector<std::pair<std::size_t, std::size_t>>& moves);
+    static void write_rows(Column& row_indexes, const std::vector<std::size_t>& old_rows,
+                           const std::vector<std::size_t>& new_rows);
+};
+
+
+
+
+// Implementation:
+
+inline ViewUpdater::ViewUpdater(std::size_t max_changed_rows):
+    m_max_changed_rows(max_changed_rows)
+{
+}
+
+inline void ViewUpdater::add_view(TableViewBase& tv)
+{
+    View v;
+    v.view = &tv;
+    m_views.push_back(std::move(v)); // Throws
+}
+
+inline void ViewUpdater::add_view(LinkView& link_view)
+{
+    View v;
+    v.link_view = &link_view;
+    m_views.push_back(std::move(v)); // Throws
+}
+
+inline void ViewUpdater::remove_view(TableViewBase& tv)
+{
+    auto it = std::remove_if(m_views.begin(), m_views.end(), [&tv](const View& v) {
+        return v.view == &tv;
+    });
+    m_views.erase(it, m_views.end());
+}
+
+inline void ViewUpdater::remove_view(LinkView& link_view)
+{
+    auto it = std::remove_if(m_views.begin(), m_views.end(), [&link_view](const View& v) {
+        return v.link_view == &link_view;
+    });
+    m_views.erase(it, m_views.end());
+}
+
+inline const ViewChangeSet& ViewUpdater::get_changes(const TableViewBase& tv) const REALM_NOEXCEPT
+{
+    auto it = std::find_if(m_views.begin(), m_views.end(), [&tv](const View& v) {
+        return v.view == &tv;
+    });
+    REALM_ASSERT(it != m_views.end());
+    return it->changes;
+}
+
+inline const ViewChangeSet& ViewUpdater::get_changes(const LinkView& link_view) const REALM_NOEXCEPT
+{
+    auto it = std::find_if(m_views.begin(), m_views.end(), [&link_view](const View& v) {
+        return v.link_view == &link_view;
+    });
+    REALM_ASSERT(it != m_views.end());
+    return it->changes;
+}
+
+inline ViewUpdater::TableChanges& ViewUpdater::get_table_changes(std::size_t group_level_ndx)
+{
+    if (group_level_ndx >= m_tables.size())
+        m_tables.resize(group_level_ndx + 1); // Throws
+    return m_tables[group_level_ndx];
+}
+
+inline void ViewUpdater::begin_parse()
+{
+    if (m_parsing)
+        return;
+    m_parsing = true;
+    m_parsed = true;
+
+    // The group has not advanced yet, so this is where the link lists are
+    // before the first instruction
+    for (View& v : m_views) {
+        if (!v.link_view)
+            continue;
+        v.tracked = false;
+        v.erased = false;
+        v.has_slots = false;
+        v.slots.clear();
+        LinkView& lv = *v.link_view;
+        if (!lv.is_attached() || !lv.get_origin_table().is_group_level())
+            continue;
+        const Table& origin = lv.get_origin_table();
+        std::size_t num_columns = origin.get_column_count();
+        for (std::size_t col_ndx = 0; col_ndx < num_columns; ++col_ndx) {
+            if (&origin.get_column_base(col_ndx) == &lv.m_origin_column) {
+                v.origin_col_ndx = col_ndx;
+                v.tracked = true;
+                break;
+            }
+        }
+        v.origin_table_ndx = origin.get_index_in_group();
+        v.origin_row_ndx = lv.get_origin_row_index();
+        v.old_size = lv.size();
+    }
+}
+
+inline bool ViewUpdater::select_table(std::size_t group_level_ndx, std::size_t levels, const std::size_t*)
+{
+    begin_parse(); // Throws
+    m_selected_ndx = levels == 0 ? group_level_ndx : npos;
+    m_selected_lists.clear();
+    m_selected = &get_table_changes(group_level_ndx); // Throws
+    // Changes to subtables are not tracked, they may affect any row
+    if (levels > 0) {
+        m_selected->changed = true;
+        m_selected->full = true;
+    }
+    return true;
+}
+
+inline bool ViewUpdater::select_descriptor(std::size_t, const std::size_t*)
+{
+    return set_schema();
+}
+
+inline bool ViewUpdater::select_link_list(std::size_t col_ndx, std::size_t row_ndx)
+{
+    m_link_list_row = row_ndx;
+    m_selected_lists.clear();
+    for (std::size_t i = 0; i < m_views.size(); ++i) {
+        const View& v = m_views[i];
+        if (v.tracked && !v.erased && v.origin_table_ndx == m_selected_ndx && v.origin_col_ndx == col_ndx &&
+                v.origin_row_ndx == row_ndx)
+            m_selected_lists.push_back(i); // Throws
+    }
+    return true;
+}
+
+inline bool ViewUpdater::insert_group_level_table(std::size_t, std::size_t, StringData)
+{
+    begin_parse(); // Throws
+    // Table indexes shift
+    m_all_full = true;
+    return true;
+}
+
+inline bool ViewUpdater::erase_group_level_table(std::size_t, std::size_t)
+{
+    begin_parse(); // Throws
+    m_all_full = true;
+    return true;
+}
+
+inline bool ViewUpdater::insert_empty_rows(std::size_t row_ndx, std::size_t num_rows_to_insert,
+                                           std::size_t prior_num_rows, bool)
+{
+    if (!m_selected)
+        return true;
+    TableChanges& changes = *m_selected;
+    changes.changed = true;
+    if (changes.prior_num_rows == npos)
+        changes.prior_num_rows = prior_num_rows;
+    RowOp op = { RowOp::insert, row_ndx, num_rows_to_insert, prior_num_rows };
+    renumber_lists(op);
+    if (changes.full)
+        return true;
+
+    // Rows appended at the end do not renumber any existing row
+    if (row_ndx != prior_num_rows) {
+        changes.ops.push_back(op); // Throws
+        renumber_rows(changes, op);
+    }
+    for (std::size_t i = 0; i < num_rows_to_insert; ++i)
+        changes.rows.push_back(row_ndx + i); // Throws
+    compact_rows(changes);
+    return true;
+}
+
+inline bool ViewUpdater::erase_rows(std::size_t row_ndx, std::size_t num_rows_to_erase,
+                                    std::size_t prior_num_rows, bool unordered)
+{
+    if (!m_selected)
+        return true;
+    TableChanges& changes = *m_selected;
+    changes.changed = true;
+    if (changes.prior_num_rows == npos)
+        changes.prior_num_rows = prior_num_rows;
+    RowOp op = { unordered ? RowOp::move_last_over : RowOp::erase, row_ndx, num_rows_to_erase,
+                 prior_num_rows };
+    renumber_lists(op);
+    if (changes.full)
+        return true;
+
+    changes.ops.push_back(op); // Throws
+    renumber_rows(changes, op);
+    return true;
+}
+
+inline bool ViewUpdater::clear_table()
+{
+    if (!m_selected)
+        return true;
+    for (View& v : m_views) {
+        if (v.tracked && v.origin_table_ndx == m_selected_ndx)
+            v.erased = true;
+    }
+    TableChanges& changes = *m_selected;
+    changes.changed = true;
+    changes.cleared = true;
+    changes.ops.clear();
+    changes.rows.clear();
+    return true;
+}
+
+inline bool ViewUpdater::set_row(std::size_t row_ndx)
+{
+    if (!m_selected)
+        return true;
+    TableChanges& changes = *m_selected;
+    changes.changed = true;
+    if (changes.full)
+        return true;
+    changes.rows.push_back(row_ndx); // Throws
+    compact_rows(changes);
+    return true;
+}
+
+inline bool ViewUpdater::set_schema()
+{
+    if (m_selected) {
+        m_selected->changed = true;
+        m_selected->full = true;
+    }
+    return true;
+}
+
+inline bool ViewUpdater::set_link_list()
+{
+    return set_row(m_link_list_row);
+}
+
+inline std::vector<ViewUpdater::Slot>* ViewUpdater::get_slots(View& v)
+{
+    if (!v.has_slots) {
+        v.slots.resize(v.old_size); // Throws
+        for (std::size_t i = 0; i < v.old_size; ++i)
+            v.slots[i] = Slot{i, false};
+        v.has_slots = true;
+    }
+    return &v.slots;
+}
+
+inline bool ViewUpdater::link_list_set(std::size_t link_ndx, std::size_t)
+{
+    for (std::size_t i : m_selected_lists)
+        (*get_slots(m_views[i]))[link_ndx].modified = true; // Throws
+    return set_link_list();
+}
+
+inline bool ViewUpdater::link_list_insert(std::size_t link_ndx, std::size_t)
+{
+    for (std::size_t i : m_selected_lists) {
+        std::vector<Slot>& slots = *get_slots(m_views[i]); // Throws
+        slots.insert(slots.begin() + link_ndx, Slot{npos, false}); // Throws
+    }
+    return set_link_list();
+}
+
+inline bool ViewUpdater::link_list_move(std::size_t old_link_ndx, std::size_t new_link_ndx)
+{
+    for (std::size_t i : m_selected_lists) {
+        std::vector<Slot>& slots = *get_slots(m_views[i]); // Throws
+        Slot slot = slots[old_link_ndx];
+        slots.erase(slots.begin() + old_link_ndx);
+        slots.insert(slots.begin() + new_link_ndx, slot); // Throws
+    }
+    return set_link_list();
+}
+
+inline bool ViewUpdater::link_list_swap(std::size_t link1_ndx, std::size_t link2_ndx)
+{
+    for (std::size_t i : m_selected_lists) {
+        std::vector<Slot>& slots = *get_slots(m_views[i]); // Throws
+        std::swap(slots[link1_ndx], slots[link2_ndx]);
+    }
+    return set_link_list();
+}
+
+inline bool ViewUpdater::link_list_erase(std::size_t link_ndx)
+{
+    for (std::size_t i : m_selected_lists) {
+        std::vector<Slot>& slots = *get_slots(m_views[i]); // Throws
+        slots.erase(slots.begin() + link_ndx);
+    }
+    return set_link_list();
+}
+
+inline bool ViewUpdater::link_list_nullify(std::size_t link_ndx)
+{
+    return link_list_erase(link_ndx);
+}
+
+inline bool ViewUpdater::link_list_clear(std::size_t)
+{
+    for (std::size_t i : m_selected_lists)
+        get_slots(m_views[i])->clear(); // Throws
+    return set_link_list();
+}
+
+inline void ViewUpdater::renumber_rows(TableChanges& changes, const RowOp& op)
+{
+    std::vector<RowOp> ops(1, op);
+    std::size_t n = 0;
+    for (std::size_t row : changes.rows) {
+        row = map_row(row, ops);
+        if (row != npos)
+            changes.rows[n++] = row;
+    }
+    changes.rows.resize(n);
+}
+
+inline void ViewUpdater::renumber_lists(const RowOp& op)
+{
+    // A link list follows its origin row, and goes away with it
+    std::vector<RowOp> ops(1, op);
+    for (View& v : m_views) {
+        if (!v.tracked || v.erased || v.origin_table_ndx != m_selected_ndx)
+            continue;
+        v.origin_row_ndx = map_row(v.origin_row_ndx, ops);
+        if (v.origin_row_ndx == npos)
+            v.erased = true;
+    }
+}
+
+inline void ViewUpdater::compact_rows(TableChanges& changes)
+{
+    // Rows that are set repeatedly are only tested once
+    if (changes.rows.size() <= 2 * m_max_changed_rows)
+        return;
+    std::sort(changes.rows.begin(), changes.rows.end());
+    changes.rows.erase(std::unique(changes.rows.begin(), changes.rows.end()), changes.rows.end());
+    if (changes.rows.size() > m_max_changed_rows) {
+        changes.full = true;
+        changes.ops.clear();
+        changes.rows.clear();
+    }
+}
+
+inline void ViewUpdater::parse_complete()
+{
+    begin_parse(); // Throws
+    // The group has not advanced yet, so this is the state the logs apply to
+    for (View& v : m_views) {
+        if (v.view)
+            v.was_in_sync = v.view->is_attached() && v.view->is_in_sync();
+    }
+    m_selected = nullptr;
+    m_selected_lists.clear();
+    m_parsing = false;
+}
+
+inline std::size_t ViewUpdater::map_row(std::size_t row, const std::vector<RowOp>& ops, std::size_t first_op)
+{
+    for (std::size_t k = first_op; k < ops.size(); ++k) {
+        const RowOp& op = ops[k];
+        switch (op.kind) {
+            case RowOp::insert:
+                if (row >= op.row_ndx)
+                    row += op.num_rows;
+                break;
+            case RowOp::erase:
+                if (row >= op.row_ndx + op.num_rows)
+                    row -= op.num_rows;
+                else if (row >= op.row_ndx)
+                    return npos;
+                break;
+            case RowOp::move_last_over:
+                if (row == op.row_ndx)
+                    return npos;
+                if (row == op.prior_num_rows - 1)
+                    row = op.row_ndx;
+                break;
+        }
+    }
+    return row;
+}
+
+inline bool ViewUpdater::has_link_columns(const Table& table)
+{
+    std::size_t num_columns = table.get_column_count();
+    for (std::size_t col_ndx = 0; col_ndx < num_columns; ++col_ndx) {
+        DataType type = table.get_column_type(col_ndx);
+        if (type == type_Link || type == type_LinkList)
+            return true;
+    }
+    return false;
+}
+
+inline bool ViewUpdater::other_tables_changed(std::size_t table_ndx) const
+{
+    for (std::size_t i = 0; i < m_tables.size(); ++i) {
+        if (i != table_ndx && m_tables[i].changed)
+            return true;
+    }
+    return false;
+}
+
+inline bool ViewUpdater::any_table_changed() const
+{
+    return m_all_full || other_tables_changed(npos);
+}
+
+inline std::size_t ViewUpdater::update_views()
+{
+    std::size_t num_updated = 0;
+    for (View& v : m_views) {
+        v.changes = ViewChangeSet();
+        if (!m_parsed)
+            continue;
+        if (v.view) {
+            if (update_view(v)) // Throws
+                ++num_updated;
+        }
+        else {
+            update_link_view(v); // Throws
+        }
+    }
+    for (View& v : m_views) {
+        v.was_in_sync = false;
+        v.has_slots = false;
+        v.slots.clear();
+    }
+    m_tables.clear();
+    m_selected = nullptr;
+    m_selected_lists.clear();
+    m_all_full = false;
+    m_parsing = false;
+    m_parsed = false;
+    return num_updated;
+}
+
+inline bool ViewUpdater::update_view(View& v)
+{
+    TableViewBase& tv = *v.view;
+    ViewChangeSet& change_set = v.changes;
+
+    // Views that the changes cannot be applied to are reloaded after any change
+    const Query& query = tv.m_query;
+    bool has_query = bool(query.m_table);
+    if (!tv.is_attached() || tv.m_linkview_source || tv.m_distinct_column_source != npos ||
+            tv.m_start != 0 || tv.m_end != std::size_t(-1) || tv.m_limit != std::size_t(-1) ||
+            (has_query && query.m_view) || !tv.m_table->is_group_level()) {
+        change_set.reload = any_table_changed();
+        return false;
+    }
+
+    Table& table = *tv.m_table;
+    std::size_t table_ndx = table.get_index_in_group();
+    bool links_changed = has_link_columns(table) && other_tables_changed(table_ndx);
+    bool table_changed = table_ndx < m_tables.size() && m_tables[table_ndx].changed;
+    if (!m_all_full && !links_changed && !table_changed) {
+        if (v.was_in_sync)
+            tv.m_last_seen_version = tv.outside_version();
+        return v.was_in_sync;
+    }
+    if (m_all_full || links_changed || !v.was_in_sync || m_tables[table_ndx].full) {
+        change_set.reload = true;
+        return false;
+    }
+    const TableChanges& changes = m_tables[table_ndx];
+
+    // A view without a query is only known to follow the table if it held
+    // every row of it. Other views without a query, such as those of
+    // Table::find_all_int() or get_range_view(), cannot tell which of the
+    // new rows belong to them.
+    if (!has_query) {
+        std::size_t prior_num_rows = changes.prior_num_rows == npos ? table.size() : changes.prior_num_rows;
+        if (changes.cleared || tv.m_row_indexes.size() != prior_num_rows) {
+            change_set.reload = true;
+            return false;
+        }
+    }
+
+    std::vector<std::size_t> changed_rows = changes.rows;
+    std::sort(changed_rows.begin(), changed_rows.end());
+    changed_rows.erase(std::unique(changed_rows.begin(), changed_rows.end()), changed_rows.end());
+
+    // Rows that move_last_over() renumbered are placed again as well, since
+    // ties are ordered by row, but they are not reported as modified
+    std::vector<std::size_t> placed_rows = changed_rows;
+    for (std::size_t k = 0; k < changes.ops.size(); ++k) {
+        const RowOp& op = changes.ops[k];
+        if (op.kind == RowOp::move_last_over && op.row_ndx != op.prior_num_rows - 1) {
+            std::size_t row = map_row(op.row_ndx, changes.ops, k + 1);
+            if (row != npos)
+                placed_rows.push_back(row); // Throws
+        }
+    }
+    if (placed_rows.size() != changed_rows.size()) {
+        std::sort(placed_rows.begin(), placed_rows.end());
+        placed_rows.erase(std::unique(placed_rows.begin(), placed_rows.end()), placed_rows.end());
+    }
+
+    // Renumber the rows of the view, and take out the erased and placed ones
+    std::size_t num_rows = tv.m_row_indexes.size();
+    std::vector<std::size_t> old_rows;
+    old_rows.reserve(num_rows);
+    for (std::size_t i = 0; i < num_rows; ++i)
+        old_rows.push_back(to_size_t(tv.m_row_indexes.get(i)));
+    std::vector<std::size_t> mapped_rows(num_rows, npos);
+    std::vector<std::size_t> new_rows;
+    if (!changes.cleared) {
+        new_rows.reserve(num_rows);
+        for (std::size_t i = 0; i < num_rows; ++i) {
+            if (old_rows[i] == detached_ref) {
+                change_set.reload = true;
+                return false;
+            }
+            std::size_t row = map_row(old_rows[i], changes.ops);
+            mapped_rows[i] = row;
+            if (row != npos && !std::binary_search(placed_rows.begin(), placed_rows.end(), row))
+                new_rows.push_back(row);
+        }
+    }
+
+    // The query is initialized once, and then probed row by row
+    std::vector<std::size_t> matches;
+    if (has_query) {
+        Query probe(query, Query::TCopyExpressionTag()); // Throws
+        probe.Init(table); // Throws
+        for (std::size_t row : placed_rows) {
+            if (probe.FindInternal(row, row + 1) == row)
+                matches.push_back(row); // Throws
+        }
+    }
+    else {
+        matches = placed_rows; // Throws
+    }
+
+    if (tv.m_auto_sort) {
+        // sync_if_needed() finds the rows in table order and sorts them
+        // stably, so ties are in row order. The rows that were not placed
+        // again are already in that order.
+        RowIndexes::Sorter& sorter = tv.m_sorting_predicate;
+        sorter.init(&tv);
+        auto before = [&sorter](std::size_t a, std::size_t b) {
+            return sorter(a, b) || (!sorter(b, a) && a < b);
+        };
+        std::stable_sort(matches.begin(), matches.end(), before);
+        std::vector<std::size_t> merged;
+        merged.reserve(new_rows.size() + matches.size());
+        auto begin = new_rows.begin();
+        for (std::size_t row : matches) {
+            auto end = std::upper_bound(begin, new_rows.end(), row, before);
+            merged.insert(merged.end(), begin, end);
+            merged.push_back(row);
+            begin = end;
+        }
+        merged.insert(merged.end(), begin, new_rows.end());
+        new_rows.swap(merged);
+    }
+    else {
+        // Moved rows break the table order
+        if (!std::is_sorted(new_rows.begin(), new_rows.end()))
+            std::sort(new_rows.begin(), new_rows.end());
+        std::vector<std::size_t> merged(new_rows.size() + matches.size());
+        std::merge(new_rows.begin(), new_rows.end(), matches.begin(), matches.end(), merged.begin());
+        new_rows.swap(merged);
+    }
+
+    write_rows(tv.m_row_indexes, old_rows, new_rows); // Throws
+    tv.m_last_seen_version = tv.outside_version();
+
+    // Pair up the positions of the rows that stayed in the view
+    std::vector<std::pair<std::size_t, std::size_t>> new_positions;
+    new_positions.reserve(new_rows.size());
+    for (std::size_t j = 0; j < new_rows.size(); ++j)
+        new_positions.push_back(std::make_pair(new_rows[j], j));
+    std::sort(new_positions.begin(), new_positions.end());
+    std::vector<bool> stayed(new_rows.size());
+    std::vector<std::pair<std::size_t, std::size_t>> kept;
+    for (std::size_t i = 0; i < num_rows; ++i) {
+        std::size_t row = mapped_rows[i];
+        auto it = std::lower_bound(new_positions.begin(), new_positions.end(), std::make_pair(row, std::size_t(0)));
+        if (row == npos || it == new_positions.end() || it->first != row) {
+            change_set.deletions.push_back(i);
+            continue;
+        }
+        std::size_t j = it->second;
+        kept.push_back(std::make_pair(i, j));
+        stayed[j] = true;
+        if (std::binary_search(changed_rows.begin(), changed_rows.end(), row))
+            change_set.modifications.push_back(j);
+    }
+    for (std::size_t j = 0; j < new_rows.size(); ++j) {
+        if (!stayed[j])
+            change_set.insertions.push_back(j);
+    }
+    std::sort(change_set.modifications.begin(), change_set.modifications.end());
+    find_moves(kept, change_set.moves);
+    return true;
+}
+
+inline void ViewUpdater::update_link_view(View& v)
+{
+    LinkView& lv = *v.link_view;
+    ViewChangeSet& change_set = v.changes;
+    if (!v.tracked || m_all_full) {
+        change_set.reload = any_table_changed();
+        return;
+    }
+    if (v.erased) {
+        for (std::size_t i = 0; i < v.old_size; ++i)
+            change_set.deletions.push_back(i);
+        return;
+    }
+    const TableChanges* origin_changes = v.origin_table_ndx < m_tables.size() ?
+        &m_tables[v.origin_table_ndx] : nullptr;
+    if (origin_changes && origin_changes->full) {
+        change_set.reload = true;
+        return;
+    }
+
+    // Rows of the target table that were set change the links to them
+    const TableChanges* target_changes = nullptr;
+    const Table& target = lv.get_target_table();
+    std::size_t target_ndx = target.get_index_in_group();
+    if (target_ndx < m_tables.size() && m_tables[target_ndx].changed) {
+        target_changes = &m_tables[target_ndx];
+        if (target_changes->full) {
+            change_set.reload = true;
+            return;
+        }
+    }
+    std::vector<std::size_t> changed_targets;
+    if (target_changes) {
+        changed_targets = target_changes->rows;
+        std::sort(changed_targets.begin(), changed_targets.end());
+    }
+
+    get_slots(v); // Throws
+    std::size_t new_size = lv.is_attached() ? lv.size() : 0;
+    REALM_ASSERT(v.slots.size() == new_size);
+    std::vector<bool> stayed(v.old_size);
+    std::vector<std::pair<std::size_t, std::size_t>> kept;
+    for (std::size_t j = 0; j < new_size; ++j) {
+        const Slot& slot = v.slots[j];
+        if (slot.old_ndx == npos) {
+            change_set.insertions.push_back(j);
+            continue;
+        }
+        kept.push_back(std::make_pair(slot.old_ndx, j));
+        stayed[slot.old_ndx] = true;
+        std::size_t target_row = to_size_t(lv.m_row_indexes.get(j));
+        if (slot.modified || std::binary_search(changed_targets.begin(), changed_targets.end(), target_row))
+            change_set.modifications.push_back(j);
+    }
+    for (std::size_t i = 0; i < v.old_size; ++i) {
+        if (!stayed[i])
+            change_set.deletions.push_back(i);
+    }
+    std::sort(kept.begin(), kept.end());
+    find_moves(kept, change_set.moves);
+}
+
+inline void ViewUpdater::find_moves(const std::vector<std::pair<std::size_t, std::size_t>>& kept,
+                                    std::vector<std::pair<std::size_t, std::size_t>>& moves)
+{
+    // The rows in the longest run of increasing new positions, taken in the
+    // order of the old positions, kept their places. All others moved.
+    std::size_t n = kept.size();
+    std::vector<std::size_t> tails; // Index in kept of the last row of each run length
+    std::vector<std::size_t> prev(n, npos);
+    for (std::size_t k = 0; k < n; ++k) {
+        auto it = std::lower_bound(tails.begin(), tails.end(), kept[k].second,
+                                   [&kept](std::size_t t, std::size_t pos) {
+            return kept[t].second < pos;
+        });
+        if (it != tails.begin())
+            prev[k] = *(it - 1);
+        if (it == tails.end())
+            tails.push_back(k);
+        else
+            *it = k;
+    }
+    std::vector<bool> in_place(n);
+    for (std::size_t k = tails.empty() ? npos : tails.back(); k != npos; k = prev[k])
+        in_place[k] = true;
+    for (std::size_t k = 0; k < n; ++k) {
+        if (!in_place[k])
+            moves.push_back(kept[k]);
+    }
+}
+
+inline void ViewUpdater::write_rows(Column& row_indexes, const std::vector<std::size_t>& old_rows,
+                                    const std::vector<std::size_t>& new_rows)
+{
+    // Only the range between the common prefix and suffix is rewritten
+    std::size_t old_size = old_rows.size();
+    std::size_t new_size = new_rows.size();
+    std::size_t prefix = 0;
+    while (prefix < old_size && prefix < new_size && old_rows[prefix] == new_rows[prefix])
+        ++prefix;
+    std::size_t suffix = 0;
+    while (suffix < old_size - prefix && suffix < new_size - prefix &&
+           old_rows[old_size - 1 - suffix] == new_rows[new_size - 1 - suffix])
+        ++suffix;
+
+    std::size_t old_end = old_size - suffix;
+    std::size_t new_end = new_size - suffix;
+    std::size_t i = prefix;
+    for (; i < old_end && i < new_end; ++i) {
+        if (old_rows[i] != new_rows[i])
+            row_indexes.set(i, new_rows[i]); // Throws
+    }
+    for (; i < new_end; ++i)
+        row_indexes.insert(i, new_rows[i]); // Throws
+    for (std::size_t j = i; j < old_end; ++j)
+        row_indexes.erase(i); // Throws
+}
+
+inline void LangBindHelper::advance_read(SharedGroup& sg, History& history, ViewUpdater& updater,
+                                         SharedGroup::VersionID version)
+{
+    using sgf = _impl::SharedGroupFriend;
+    sgf::advance_read(sg, history, &updater, version); // Throws
+    updater.update_views(); // Throws
+}
+
+inline void LangBindHelper::promote_to_write(SharedGroup& sg, History& history, ViewUpdater& updater)
+{
+    using sgf = _impl::SharedGroupFriend;
+    sgf::promote_to_write(sg, history, &updater); // Throws
+    updater.update_views(); // Throws
+}
+
+} // namespace realm
+
+#endif // REALM_ENABLE_REPLICATION
+
+#endif // REALM_VIEW_UPDATER_HPP